@@ -0,0 +1,122 @@
+#ifndef SPCC_AST_VISIT_HH
+#define SPCC_AST_VISIT_HH
+
+#include "parser.hh"
+#include "parse_expr.hh"
+#include "parse_decl.hh"
+#include "parse_stmt.hh"
+#include "declarator.hh"
+
+#include <utility>
+
+namespace parse {
+    // Calls f with the node as its own class, picked by a switch on its
+    // kind. A new kind of node is added here as well as to node_kind.
+    template<typename F>
+    decltype(auto) visit(const ast& tree, node_id id, F&& f) {
+        const node& n = tree[id];
+        switch (n.kind()) {
+            case node_kind::token:
+                return f(static_cast<const token_node&>(n));
+            case node_kind::unary:
+                return f(static_cast<const unary_node&>(n));
+            case node_kind::paren:
+                return f(static_cast<const paren_node&>(n));
+            case node_kind::binary:
+                return f(static_cast<const binary_node&>(n));
+            case node_kind::ternary:
+                return f(static_cast<const ternary_node&>(n));
+            case node_kind::call:
+                return f(static_cast<const call_node&>(n));
+            case node_kind::cast:
+                return f(static_cast<const cast_node&>(n));
+            case node_kind::subscript:
+                return f(static_cast<const subscript_node&>(n));
+            case node_kind::compound_literal:
+                return f(static_cast<const compound_literal_node&>(n));
+            case node_kind::type_query:
+                return f(static_cast<const type_query_node&>(n));
+            case node_kind::generic:
+                return f(static_cast<const generic_node&>(n));
+            case node_kind::generic_association:
+                return f(static_cast<const generic_association_node&>(n));
+            case node_kind::abstract_placeholder:
+                return f(static_cast<const abstract_placeholder_node&>(n));
+            case node_kind::declarator_array:
+                return f(static_cast<const declarator_array_node&>(n));
+            case node_kind::error:
+                return f(static_cast<const error_node&>(n));
+            case node_kind::specifiers:
+                return f(static_cast<const specifiers_node&>(n));
+            case node_kind::declaration:
+                return f(static_cast<const declaration_node&>(n));
+            case node_kind::init_declarator:
+                return f(static_cast<const init_declarator_node&>(n));
+            case node_kind::bit_field:
+                return f(static_cast<const bit_field_node&>(n));
+            case node_kind::parameter:
+                return f(static_cast<const parameter_node&>(n));
+            case node_kind::type_name:
+                return f(static_cast<const type_name_node&>(n));
+            case node_kind::record:
+                return f(static_cast<const record_node&>(n));
+            case node_kind::enumeration:
+                return f(static_cast<const enumeration_node&>(n));
+            case node_kind::enumerator:
+                return f(static_cast<const enumerator_node&>(n));
+            case node_kind::initializer_list:
+                return f(static_cast<const initializer_list_node&>(n));
+            case node_kind::designation:
+                return f(static_cast<const designation_node&>(n));
+            case node_kind::designator:
+                return f(static_cast<const designator_node&>(n));
+            case node_kind::static_assertion:
+                return f(static_cast<const static_assertion_node&>(n));
+            case node_kind::function_definition:
+                return f(static_cast<const function_definition_node&>(n));
+            case node_kind::translation_unit:
+                return f(static_cast<const translation_unit_node&>(n));
+            case node_kind::compound_statement:
+                return f(static_cast<const compound_statement_node&>(n));
+            case node_kind::expression_statement:
+                return f(static_cast<const expression_statement_node&>(n));
+            case node_kind::if_statement:
+                return f(static_cast<const if_statement_node&>(n));
+            case node_kind::switch_statement:
+                return f(static_cast<const switch_statement_node&>(n));
+            case node_kind::while_statement:
+                return f(static_cast<const while_statement_node&>(n));
+            case node_kind::do_statement:
+                return f(static_cast<const do_statement_node&>(n));
+            case node_kind::for_statement:
+                return f(static_cast<const for_statement_node&>(n));
+            case node_kind::jump_statement:
+                return f(static_cast<const jump_statement_node&>(n));
+            case node_kind::return_statement:
+                return f(static_cast<const return_statement_node&>(n));
+            case node_kind::labeled_statement:
+                return f(static_cast<const labeled_statement_node&>(n));
+        }
+        std::unreachable();
+    }
+
+    // Calls f with the id of each child of the node, in source order,
+    // without building a list of them.
+    template<typename F>
+    void for_each_child(const ast& tree, node_id id, F&& f) {
+        visit(tree, id, [&](const auto& n) { n.for_each_child(tree, f); });
+    }
+
+    // Calls pre on every node of the tree under id, parents before their
+    // children, and post on each once its children are done.
+    template<typename Pre, typename Post>
+    void walk(const ast& tree, node_id id, Pre&& pre, Post&& post) {
+        pre(id);
+        for_each_child(tree, id, [&](node_id child) {
+            walk(tree, child, pre, post);
+        });
+        post(id);
+    }
+}
+
+#endif
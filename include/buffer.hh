@@ -3,6 +3,7 @@
 
 #include <utility>
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <optional>
 #include <string_view>
@@ -19,6 +20,9 @@ public:
     virtual ~buffer() { }
 };
 
+// index into the expansion table; 0 means "not produced by an expansion"
+using expansion_id = std::uint32_t;
+
 class location {
 public:
     location(const buffer& buf, std::size_t offset) :
@@ -29,12 +33,33 @@ public:
     location find_spelling_loc() const;
     location next_loc(std::size_t n = 1) { return { buffer(), offset() + n }; }
 
-    void add_expansion_entry(location loc, std::size_t depth = 0);
-
-    std::shared_ptr<location> expanded_from;
+    expansion_id expansion() const { return expansion_; }
+    void set_expansion(expansion_id id) { expansion_ = id; }
+    std::optional<location> expanded_from() const;
+    // the #include of the innermost included buffer this location is in
+    std::optional<location> included_at() const;
 private:
     const class buffer* buf_;
     std::size_t offset_;
+    expansion_id expansion_ = 0;
+};
+
+// one entry per macro expansion event rather than per expanded token;
+// the parent expansion is the one the invocation site itself came from
+struct expansion_entry {
+    location site;
+    location definition;
+};
+
+class expansion_table {
+public:
+    expansion_id record(location site, location definition);
+    const expansion_entry& operator[](expansion_id id) const;
+    expansion_id parent(expansion_id id) const;
+    std::size_t size() const { return entries_.size(); }
+    void clear() { entries_.clear(); }
+private:
+    std::vector<expansion_entry> entries_;
 };
 
 using loc_range = std::pair<location, location>;
@@ -55,13 +80,37 @@ public:
         return included_at_;
     }
 
-    void mark_included_at(location loc) { included_at_ = loc; }
+    void mark_included_at(std::optional<location> loc) { included_at_ = loc; }
 private:
     std::string name_;
     std::string data_;
     std::optional<location> included_at_;
 };
 
+// Presents a shared buffer, such as a cached header, unchanged as included
+// from a particular #include directive
+class included_buffer : public buffer {
+public:
+    included_buffer(std::shared_ptr<const buffer> base, location included_at) :
+    base_(std::move(base)), included_at_(included_at) { }
+
+    std::string_view name() const override { return base_->name(); }
+    std::string_view data() const override { return base_->data(); }
+    const buffer* parent() const override { return base_.get(); }
+    std::string_view original_data() const override {
+        return base_->original_data();
+    }
+    std::size_t offset_in_original(std::size_t offset) const override {
+        return offset;
+    }
+    std::optional<class location> included_at() const override {
+        return included_at_;
+    }
+private:
+    std::shared_ptr<const buffer> base_;
+    location included_at_;
+};
+
 class derived_buffer : public buffer {
 public:
     derived_buffer(std::unique_ptr<const buffer> parent) :
@@ -0,0 +1,60 @@
+#ifndef SPCC_CONTEXT_HH
+#define SPCC_CONTEXT_HH
+
+#include "options.hh"
+#include "buffer.hh"
+#include "type.hh"
+
+#include <atomic>
+#include <cstddef>
+
+// State owned by one translation unit. A context is installed for the
+// calling thread while it exists, and code that needs the unit's options
+// or must record something about the unit finds it via current_context().
+// Units on different threads therefore share nothing mutable.
+class compilation_context {
+public:
+    explicit compilation_context(options::config config);
+    // a context for a thread doing part of the work of another thread's
+    // unit: it has the unit's options, macro expansions and types, and
+    // counts its own diagnostics on from the unit's for the unit to take
+    // back; helpers given the same claimed_errors count their errors
+    // against the error limit together
+    struct helper_tag { };
+    compilation_context(helper_tag, compilation_context& unit,
+                        std::atomic<std::size_t>* claimed_errors = nullptr);
+    ~compilation_context();
+    compilation_context(const compilation_context&) = delete;
+    compilation_context& operator=(const compilation_context&) = delete;
+
+    options::config options;
+    int exit_code = 0;
+    expansion_table expansions;
+    // the unit's expansions, which a helper only reads
+    const expansion_table& expansion_sites() const {
+        return unit_expansions ? *unit_expansions : expansions;
+    }
+    // the unit's types, which its helpers build on too, so that a type
+    // is the same object whichever thread made it
+    sem::type_manager& types() {
+        return unit_types ? *unit_types : own_types;
+    }
+
+    // diagnostic bookkeeping; requested counts every diagnose() call,
+    // including those that end up suppressed
+    std::size_t diagnostics_requested = 0;
+    std::size_t error_count = 0;
+    bool last_suppressed = false;
+    // the errors of the unit and all its helpers that the error limit
+    // has let through, if this context shares the limit with others
+    std::atomic<std::size_t>* const claimed_errors = nullptr;
+private:
+    const expansion_table* unit_expansions = nullptr;
+    sem::type_manager own_types;
+    sem::type_manager* unit_types = nullptr;
+    compilation_context* previous;
+};
+
+compilation_context& current_context();
+
+#endif
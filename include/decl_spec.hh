@@ -22,13 +22,6 @@ namespace parse {
         sc_register,
     };
 
-    enum type_qualifier {
-        tq_const,
-        tq_restrict,
-        tq_volatile,
-        tq_Atomic,
-    };
-
     enum function_specifier {
         fs_inline,
         fs_Noreturn,
@@ -36,7 +29,8 @@ namespace parse {
 
     struct alignment_specifier {
         const type* ty = nullptr;
-        std::unique_ptr<node> expr = nullptr;
+        node_id expr = no_node;
+        node_id type_name = no_node;
     };
 
     enum simple_type_specifier {
@@ -57,13 +51,28 @@ namespace parse {
         std::optional<location> loc_start;
         parser* p = nullptr;
         std::vector<storage_class> storage_classes;
-        std::vector<type_qualifier> type_qualifiers;
+        // a set of sem::qualifier; repeating one is allowed [6.7.3]/5
+        unsigned type_qualifiers = 0;
         std::vector<function_specifier> function_specifiers;
         std::vector<alignment_specifier> alignment_specifiers;
         std::vector<simple_type_specifier> simple_type_specifiers;
-        std::vector<const type*> direct_type_specifiers;
+        std::vector<qual_type> direct_type_specifiers;
+        // struct, union and enum specifiers, and the type names of
+        // _Atomic ( type-name ), until they can be made into types
+        std::vector<node_id> tagged_type_specifiers;
+        // the specifiers_node for all of the above
+        node_id node = no_node;
+
+        bool has_type_specifier() const {
+            return !simple_type_specifiers.empty() ||
+                   !direct_type_specifiers.empty() ||
+                   !tagged_type_specifiers.empty();
+        }
 
         const type* build_unqualified_type();
+        // the same with the qualifiers of the specifiers and of a typedef
+        // name among them
+        qual_type build_type();
     };
 
     decl_spec parse_decl_spec(parser&);
@@ -4,70 +4,92 @@
 #include "parser.hh"
 
 namespace parse {
-    extern ruleset declarator_ruleset;
+    extern const ruleset declarator_ruleset;
 
     class abstract_placeholder_node : public node {
     public:
-        abstract_placeholder_node(token rparen) : rparen{rparen} { }
-        loc_range range() override { return rparen.range; }
-    private:
-        std::string get_dump_info() const override {
-            return "ABSTRACT PLACEHOLDER";
+        static constexpr node_kind kind_tag = node_kind::abstract_placeholder;
+
+        abstract_placeholder_node(token_id rparen) :
+        node{kind_tag}, rparen{rparen} { }
+        loc_range range(const ast& tree) const {
+            return tree.token_at(rparen).range;
         }
-        std::vector<const node*> children() const override {
-            return {};
+        std::string dump_info(const ast&) const {
+            return "ABSTRACT PLACEHOLDER";
         }
-
-        token rparen;
+        template<typename F>
+        void for_each_child(const ast&, F&&) const { }
+    private:
+        token_id rparen;
     };
 
     class abstract_placeholder_rule : public prefix_rule {
     public:
-        node_ptr parse(parser&, token) const override;
+        node_id parse(parser&, token_id) const override;
     };
 
     class declarator_array_node : public node {
     public:
-        declarator_array_node(node_ptr base, std::vector<token> mods,
-                              node_ptr sz, token left, token right) :
-        lhs{std::move(base)}, mods{std::move(mods)}, sz{std::move(sz)},
-        left{left}, right{right} { }
+        static constexpr node_kind kind_tag = node_kind::declarator_array;
 
-        loc_range range() override {
-            return { left.range.first, right.range.second };
-        }
+        declarator_array_node(node_id base, id_list mods, node_id sz,
+                              token_id left, token_id right) :
+        node{kind_tag}, lhs{base}, mods{mods}, sz{sz}, left{left},
+        right{right} { }
 
-        const std::vector<token>& modifiers() const { return mods; }
-        const node* size() const { return sz.get(); }
-        const node& base() const { return *lhs; }
-    private:
-        std::string get_dump_info() const override {
+        loc_range range(const ast& tree) const {
+            return { tree.token_at(left).range.first,
+                     tree.token_at(right).range.second };
+        }
+        std::string dump_info(const ast&) const {
             return "ARRAY";
         }
-        std::vector<const node*> children() const override {
-            std::vector<const node*> result = { lhs.get() };
-            if (sz) result.push_back(sz.get());
-            return result;
+        template<typename F>
+        void for_each_child(const ast&, F&& f) const {
+            f(lhs);
+            if (sz != no_node) f(sz);
         }
 
-        node_ptr lhs;
-        std::vector<token> mods;
-        node_ptr sz;
-        token left, right;
+        // the tokens of the qualifiers, static and *
+        id_list modifiers() const { return mods; }
+        // no_node for []
+        node_id size() const { return sz; }
+        node_id base() const { return lhs; }
+    private:
+        node_id lhs;
+        id_list mods;
+        node_id sz;
+        token_id left, right;
     };
 
     class declarator_array_rule : public infix_rule {
     public:
-        node_ptr parse(parser&, node_ptr, token) const override;
+        node_id parse(parser&, node_id, token_id) const override;
         int precedence() const override { return INT_MAX; }
     };
 
     struct init_declarator {
-        node_ptr declarator;
-        node_ptr init;
+        node_id declarator = no_node;
+        node_id init = no_node;
     };
 
+    // a declarator, diagnosing one that consumes nothing
+    node_id parse_declarator(parser&);
+    // the initializer after = that may follow a declarator, or no_node
+    node_id parse_optional_initializer(parser&);
+    // a declarator and, after =, its initializer
+    init_declarator parse_init_declarator(parser&);
     std::vector<init_declarator> parse_init_declarator_list(parser&);
+
+    struct declarator_info {
+        // no_token for an abstract declarator
+        token_id name = no_token;
+        // the pointer, array or call node that applies to the name first,
+        // and so says what it declares, or no_node for a plain identifier
+        node_id derivation = no_node;
+    };
+    declarator_info inspect_declarator(const ast&, node_id);
 }
 
 #endif
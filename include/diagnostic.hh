@@ -9,6 +9,7 @@
 #include <string>
 #include <string_view>
 #include <optional>
+#include <exception>
 
 namespace diagnostic {
     enum class category {
@@ -25,6 +26,8 @@ namespace diagnostic {
         invalid_option,
         invalid_size,
         not_yet_implemented,
+        server_error,
+        pch_unusable,
         pp1_invalid_utf8,
         pp2_missing_newline,
         pp3_unmatched_quote,
@@ -52,6 +55,7 @@ namespace diagnostic {
         pp4_cannot_use_va_args_here,
         pp4_non_directive_ignored,
         pp4_too_many_nested_includes,
+        pp4_invalid_condition,
         pp6_cannot_concatenate_wide_utf8,
         pp6_cannot_concatenate_diff_wide,
         pp7_expected_end_of_list,
@@ -61,8 +65,10 @@ namespace diagnostic {
         pp7_expected_semicolon,
         pp7_invalid_decl_spec_type,
         pp7_expected_token,
+        pp7_syntax_error,
         pp_token_is_not_a_valid_token,
         translation_limit_exceeded,
+        too_many_errors,
         aux_previous_def,
         aux_previous_use,
         aux_expanded_here,
@@ -71,12 +77,15 @@ namespace diagnostic {
     };
 
     struct info {
+        std::string name;
         std::string pattern;
         std::string citation;
         category category;
     };
 
     const info& find(id diag);
+    std::optional<id> find_by_name(std::string_view name);
+    std::optional<category> find_category(std::string_view name);
     std::string format_diagnostic_message(const std::string& pattern,
                                           std::vector<std::string> args);
 
@@ -93,24 +102,55 @@ namespace diagnostic {
     }
 
     template<typename... T>
-    std::string format_diagnostic_message(const std::string& pattern, T... t) {
+    std::string format_diagnostic_message(const std::string& pattern,
+                                          const T&... t) {
         using diagnostic::to_string;
         using std::to_string;
         std::vector<std::string> args = { to_string(t)... };
         return format_diagnostic_message(pattern, std::move(args));
     }
 
-    void emit_diagnostic(const info&, std::optional<location>,
-                         const std::string& msg);
+    void emit_diagnostic(const info&, category, std::optional<location>,
+                         const std::string& msg, std::string_view fixit = {});
 
     std::pair<std::size_t, std::size_t> compute_line_col(location loc);
 
+    // applies the command line controls to a diagnostic, returning its
+    // effective category or nothing if it is suppressed
+    std::optional<category> map_diagnostic(id diag, const info& info,
+                                           const std::optional<location>& loc);
+
+    template<typename... T>
+    void diagnose(id diag, std::optional<location> loc, const T&... t) {
+        auto& info = find(diag);
+        auto cat = map_diagnostic(diag, info, loc);
+        if (!cat) return;
+        auto msg = format_diagnostic_message(info.pattern, t...);
+        emit_diagnostic(info, *cat, loc, msg);
+    }
+
+    // like diagnose, but also suggests inserting text at the location;
+    // callers should recover as if the suggestion had been applied
     template<typename... T>
-    void diagnose(id diag, std::optional<location> loc, T... t) {
+    void diagnose_fixit(id diag, location loc, std::string_view insertion,
+                        const T&... t) {
         auto& info = find(diag);
+        auto cat = map_diagnostic(diag, info, loc);
+        if (!cat) return;
         auto msg = format_diagnostic_message(info.pattern, t...);
-        emit_diagnostic(info, loc, msg);
+        emit_diagnostic(info, *cat, loc, msg, insertion);
     }
+
+    // thrown by diagnose when a translation unit exceeds -ferror-limit
+    class error_limit_reached : public std::exception {
+    public:
+        const char* what() const noexcept override {
+            return "error limit reached";
+        }
+    };
+
+    // errors diagnosed in the current compilation context
+    std::size_t error_count();
 }
 
 #endif
@@ -0,0 +1,71 @@
+#ifndef SPCC_HEADER_CACHE_HH
+#define SPCC_HEADER_CACHE_HH
+
+#include "buffer.hh"
+#include "token.hh"
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace pp {
+    // For the # of each #if, #ifdef, #ifndef, #elif and #else, how many
+    // tokens further on the # of the next #elif, #else or #endif of the
+    // same conditional is, so that a skipped group is stepped over at
+    // once. Keyed by where the # is spelled, which is the same in every
+    // copy of the tokens.
+    using conditional_map = std::unordered_map<const char*, std::size_t>;
+
+    // A header after phases 1 to 3. Its tokens are located in buf and must
+    // be rebased onto an included_buffer for each inclusion.
+    struct cached_header {
+        std::shared_ptr<const buffer> buf;
+        std::vector<token> tokens;
+        // X if the whole file is wrapped in #ifndef X ... #endif
+        std::optional<std::string> guard;
+        conditional_map conditionals;
+        std::filesystem::file_time_type mtime;
+        std::uintmax_t size = 0;
+    };
+
+    using header_ptr = std::shared_ptr<const cached_header>;
+
+    // Headers shared between inclusions, translation units and, in server
+    // mode, requests. An entry is reused while the file's modification
+    // time and size are unchanged. Headers whose lexing issued diagnostics
+    // are not cached so that the diagnostics appear on every inclusion.
+    class header_cache {
+    public:
+        // nullptr if the file cannot be read; key is header_key(path)
+        header_ptr load(const std::string& path,
+                        const std::filesystem::path& key,
+                        location included_at);
+        void clear();
+    private:
+        std::mutex mutex;
+        std::map<std::filesystem::path, header_ptr> entries;
+    };
+
+    extern header_cache headers;
+
+    // the name a header is known by regardless of how it is spelled
+    std::filesystem::path header_key(const std::string& path);
+
+    std::optional<std::string> detect_include_guard(
+        const std::vector<token>& tokens
+    );
+
+    conditional_map map_conditionals(const std::vector<token>& tokens);
+
+    // copies of the tokens of a header, located in the given inclusion
+    std::vector<token> rebase_tokens(const cached_header& header,
+                                     const included_buffer& inclusion);
+}
+
+#endif
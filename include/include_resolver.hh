@@ -0,0 +1,47 @@
+#ifndef SPCC_INCLUDE_RESOLVER_HH
+#define SPCC_INCLUDE_RESOLVER_HH
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace pp {
+    // Finds the file an #include names. "..." searches the directory of
+    // the including file first; both forms then search the -I and then
+    // the -isystem directories. Every (directory, name) lookup is
+    // remembered, including failed ones, and each search directory is
+    // listed once on first use so that names whose first component is not
+    // in it are rejected without touching the file system.
+    class include_resolver {
+    public:
+        // the path to open, or nothing if no directory has the file
+        std::optional<std::string> resolve(std::string_view name,
+                                           bool angled,
+                                           const std::string& includer_dir);
+        // forgets everything, for when files may have come or gone
+        void clear();
+    private:
+        using listing = std::set<std::string, std::less<>>;
+
+        std::optional<std::string> lookup(const std::string& dir,
+                                          std::string_view name,
+                                          bool use_listing);
+        // nullptr if the directory cannot be listed
+        std::shared_ptr<const listing> listing_of(const std::string& dir);
+
+        std::mutex mutex;
+        std::map<std::pair<std::string, std::string>,
+                 std::optional<std::string>> lookups;
+        std::map<std::string, std::shared_ptr<const listing>> listings;
+    };
+
+    extern include_resolver includes;
+}
+
+#endif
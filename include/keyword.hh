@@ -1,8 +1,8 @@
 #ifndef SPCC_KEYWORD_HH
 #define SPCC_KEYWORD_HH
 
-#include <string>
-#include <map>
+#include <optional>
+#include <string_view>
 
 enum keyword {
     kw_auto,
@@ -51,6 +51,13 @@ enum keyword {
     kw_Thread_local,
 };
 
-extern std::map<std::string, keyword> keyword_table;
+// nullopt if the identifier is not a keyword
+std::optional<keyword> find_keyword(std::string_view spelling);
+
+// whether the keyword can be a type specifier or qualifier, and so
+// start a type name [6.7.7]/1
+bool is_specifier_qualifier(keyword kw);
+// whether the keyword can start the specifiers of a declaration [6.7]/1
+bool is_declaration_specifier(keyword kw);
 
 #endif
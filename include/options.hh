@@ -1,8 +1,12 @@
 #ifndef SPCC_OPTIONS_HH
 #define SPCC_OPTIONS_HH
 
+#include "diagnostic.hh"
+
 #include <vector>
 #include <string>
+#include <map>
+#include <set>
 
 namespace options {
     enum class run_mode {
@@ -14,9 +18,23 @@ namespace options {
         debug_parse_declarator,
         debug_parse_expr,
         debug_scratch,
+        server,
+        client,
         option_parsing_error,
     };
 
+    enum class dependency_mode {
+        none,
+        only, // -M
+        also, // -MD
+    };
+
+    enum class report_format {
+        none,
+        table,
+        json,
+    };
+
     struct size_info {
         unsigned bits_per_byte = 8;
         unsigned size_bytes = 8;
@@ -26,21 +44,53 @@ namespace options {
         unsigned long_long_bytes = 8;
     };
 
+    // -W flags; per-id settings take precedence over category settings
+    struct diagnostic_controls {
+        std::map<diagnostic::id, bool> enabled;
+        std::map<diagnostic::id, bool> as_error;
+        std::set<diagnostic::category> disabled_categories;
+        std::set<diagnostic::category> error_categories;
+        std::vector<std::string> system_header_prefixes;
+    };
+
     struct config {
         std::vector<std::string> input_filenames;
         run_mode mode = run_mode::normal;
         bool use_color = true;
-        int exit_code = 0;
         size_info sizes;
         bool is_char_signed = true;
+        diagnostic_controls diagnostics;
+        bool preprocess_only = false; // -E
+        std::string output_file; // stdout if empty
+        std::vector<std::string> include_dirs; // -I
+        std::vector<std::string> system_include_dirs; // -isystem
+        dependency_mode dependencies = dependency_mode::none;
+        std::string dependency_file; // -MF
+        std::size_t error_limit = 0; // 0 means unlimited
+        unsigned jobs = 1; // translation units processed concurrently
+        unsigned parse_jobs = 1; // threads parsing one unit's bodies
+        bool lazy_bodies = false; // skim function bodies, parse none
+        report_format time_report = report_format::none;
+        std::string time_trace_file;
+        unsigned time_trace_granularity = 500; // microseconds
+        std::string socket_path; // --server and --connect
+        std::string emit_pch_file; // preprocessor state after the input
+        std::string include_pch_file; // state to start each unit from
+        // parse each unit this many times and report the throughput
+        unsigned bench_parse_runs = 0;
 
         std::string debug_string_to_parse;
     };
 
+    // the command line the process was started with; a unit's code reads
+    // its options from current_context() instead
     extern config state;
 
+    // parses the command line into state
     void parse(int argc, char** argv);
-    void dump();
+    // parses a command line of its own, such as a server request's
+    config parse(std::vector<std::string> args);
+    void dump(const config& shown);
 }
 
 #endif
@@ -0,0 +1,514 @@
+#ifndef SPCC_PARSE_DECL_HH
+#define SPCC_PARSE_DECL_HH
+
+#include "parser.hh"
+
+namespace parse {
+    // the specifiers and qualifiers of a declaration, with the struct,
+    // union and enum specifiers and the operands of _Alignas and
+    // _Atomic as children
+    class specifiers_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::specifiers;
+
+        specifiers_node(token_id first, token_id end, id_list words,
+                        id_list parts) :
+        node{kind_tag}, first{first}, end{end}, word_ids{words},
+        part_ids{parts} { }
+
+        loc_range range(const ast& tree) const {
+            if (end == first) {
+                auto loc = tree.token_at(first).range.first;
+                return { loc, loc };
+            }
+            return { tree.token_at(first).range.first,
+                     tree.token_at(end - 1).range.second };
+        }
+        std::string dump_info(const ast& tree) const {
+            std::string result = "SPECIFIERS";
+            for (auto word : tree.list(word_ids)) {
+                result += " " + std::string(tree.token_at(word).spelling);
+            }
+            return result;
+        }
+        template<typename F>
+        void for_each_child(const ast& tree, F&& f) const {
+            for (auto part : tree.list(part_ids)) f(part);
+        }
+        // the keywords and typedef name, in order
+        id_list words() const { return word_ids; }
+        bool empty() const { return end == first; }
+    private:
+        token_id first, end;
+        id_list word_ids;
+        id_list part_ids;
+    };
+
+    class declaration_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::declaration;
+
+        declaration_node(node_id specs, id_list declarators,
+                         token_id semicolon) :
+        node{kind_tag}, specs{specs}, decls{declarators},
+        semicolon{semicolon} { }
+
+        loc_range range(const ast& tree) const {
+            auto first = tree.range(specs).first;
+            if (semicolon != no_token) {
+                return { first, tree.token_at(semicolon).range.second };
+            }
+            auto last = decls.count ? tree.list(decls).back() : specs;
+            return { first, tree.range(last).second };
+        }
+        std::string dump_info(const ast&) const {
+            return "DECLARATION";
+        }
+        template<typename F>
+        void for_each_child(const ast& tree, F&& f) const {
+            f(specs);
+            for (auto decl : tree.list(decls)) f(decl);
+        }
+        node_id specifiers() const { return specs; }
+        // init_declarator_node or, in a struct or union, declarators and
+        // bit_field_nodes
+        id_list declarators() const { return decls; }
+    private:
+        node_id specs;
+        id_list decls;
+        token_id semicolon;
+    };
+
+    class init_declarator_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::init_declarator;
+
+        // init is no_node if there is no initializer
+        init_declarator_node(node_id declarator, node_id init) :
+        node{kind_tag}, decl{declarator}, init{init} { }
+
+        loc_range range(const ast& tree) const {
+            return { tree.range(decl).first,
+                     tree.range(init == no_node ? decl : init).second };
+        }
+        std::string dump_info(const ast&) const {
+            return "INIT DECLARATOR";
+        }
+        template<typename F>
+        void for_each_child(const ast&, F&& f) const {
+            f(decl);
+            if (init != no_node) f(init);
+        }
+        node_id declarator() const { return decl; }
+        node_id initializer() const { return init; }
+    private:
+        node_id decl;
+        node_id init;
+    };
+
+    class bit_field_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::bit_field;
+
+        // declarator is no_node for an unnamed bit-field
+        bit_field_node(node_id declarator, token_id colon, node_id width) :
+        node{kind_tag}, decl{declarator}, colon{colon}, bits{width} { }
+
+        loc_range range(const ast& tree) const {
+            auto first = decl == no_node ? tree.token_at(colon).range.first
+                                         : tree.range(decl).first;
+            return { first, tree.range(bits).second };
+        }
+        std::string dump_info(const ast&) const {
+            return "BIT FIELD";
+        }
+        template<typename F>
+        void for_each_child(const ast&, F&& f) const {
+            if (decl != no_node) f(decl);
+            f(bits);
+        }
+        node_id declarator() const { return decl; }
+        node_id width() const { return bits; }
+    private:
+        node_id decl;
+        token_id colon;
+        node_id bits;
+    };
+
+    // a parameter of a prototype; the declarator may be abstract
+    class parameter_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::parameter;
+
+        parameter_node(node_id specs, node_id declarator) :
+        node{kind_tag}, specs{specs}, decl{declarator} { }
+
+        loc_range range(const ast& tree) const {
+            return { tree.range(specs).first, tree.range(decl).second };
+        }
+        std::string dump_info(const ast&) const {
+            return "PARAMETER";
+        }
+        template<typename F>
+        void for_each_child(const ast&, F&& f) const {
+            f(specs);
+            f(decl);
+        }
+        node_id specifiers() const { return specs; }
+        node_id declarator() const { return decl; }
+    private:
+        node_id specs;
+        node_id decl;
+    };
+
+    class type_name_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::type_name;
+
+        type_name_node(node_id specs, node_id declarator) :
+        node{kind_tag}, specs{specs}, decl{declarator} { }
+
+        loc_range range(const ast& tree) const {
+            return { tree.range(specs).first, tree.range(decl).second };
+        }
+        std::string dump_info(const ast&) const {
+            return "TYPE NAME";
+        }
+        template<typename F>
+        void for_each_child(const ast&, F&& f) const {
+            f(specs);
+            f(decl);
+        }
+        node_id specifiers() const { return specs; }
+        node_id declarator() const { return decl; }
+    private:
+        node_id specs;
+        node_id decl;
+    };
+
+    // a struct or union specifier, with or without a tag and members
+    class record_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::record;
+
+        // name is no_token without a tag, lbrace without members, and
+        // rbrace without members or if it was missing
+        record_node(token_id kw, token_id name, token_id lbrace,
+                    id_list members, token_id rbrace) :
+        node{kind_tag}, kw{kw}, name{name}, left{lbrace},
+        member_ids{members}, right{rbrace} { }
+
+        loc_range range(const ast& tree) const {
+            auto first = tree.token_at(kw).range.first;
+            if (right == no_token && member_ids.count) {
+                auto last = tree.list(member_ids).back();
+                return { first, tree.range(last).second };
+            }
+            auto last = right != no_token ? right
+                      : left != no_token ? left
+                      : name != no_token ? name : kw;
+            return { first, tree.token_at(last).range.second };
+        }
+        std::string dump_info(const ast& tree) const {
+            auto result = tree.token_at(kw).is(kw_struct) ? "STRUCT"
+                                                          : "UNION";
+            if (name == no_token) return result;
+            return result + (" " + std::string(tree.token_at(name).spelling));
+        }
+        template<typename F>
+        void for_each_child(const ast& tree, F&& f) const {
+            for (auto member : tree.list(member_ids)) f(member);
+        }
+        token_id keyword() const { return kw; }
+        token_id tag() const { return name; }
+        bool has_members() const { return left != no_token; }
+        // declaration_nodes and static_assertion_nodes
+        id_list members() const { return member_ids; }
+    private:
+        token_id kw;
+        token_id name;
+        token_id left;
+        id_list member_ids;
+        token_id right;
+    };
+
+    class enumeration_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::enumeration;
+
+        // name is no_token without a tag, lbrace without enumerators,
+        // and rbrace without enumerators or if it was missing
+        enumeration_node(token_id kw, token_id name, token_id lbrace,
+                         id_list enumerators, token_id rbrace) :
+        node{kind_tag}, kw{kw}, name{name}, left{lbrace},
+        enumerator_ids{enumerators}, right{rbrace} { }
+
+        loc_range range(const ast& tree) const {
+            auto first = tree.token_at(kw).range.first;
+            if (right == no_token && enumerator_ids.count) {
+                auto last = tree.list(enumerator_ids).back();
+                return { first, tree.range(last).second };
+            }
+            auto last = right != no_token ? right
+                      : left != no_token ? left
+                      : name != no_token ? name : kw;
+            return { first, tree.token_at(last).range.second };
+        }
+        std::string dump_info(const ast& tree) const {
+            if (name == no_token) return "ENUM";
+            return "ENUM " + std::string(tree.token_at(name).spelling);
+        }
+        template<typename F>
+        void for_each_child(const ast& tree, F&& f) const {
+            for (auto enumerator : tree.list(enumerator_ids)) f(enumerator);
+        }
+        token_id tag() const { return name; }
+        bool has_enumerators() const { return left != no_token; }
+        id_list enumerators() const { return enumerator_ids; }
+    private:
+        token_id kw;
+        token_id name;
+        token_id left;
+        id_list enumerator_ids;
+        token_id right;
+    };
+
+    class enumerator_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::enumerator;
+
+        // value is no_node without = constant-expression
+        enumerator_node(token_id name, node_id value) :
+        node{kind_tag}, name{name}, val{value} { }
+
+        loc_range range(const ast& tree) const {
+            auto first = tree.token_at(name).range.first;
+            if (val == no_node) return { first, first };
+            return { first, tree.range(val).second };
+        }
+        std::string dump_info(const ast& tree) const {
+            return "ENUMERATOR " + std::string(tree.token_at(name).spelling);
+        }
+        template<typename F>
+        void for_each_child(const ast&, F&& f) const {
+            if (val != no_node) f(val);
+        }
+        token_id identifier() const { return name; }
+        node_id value() const { return val; }
+    private:
+        token_id name;
+        node_id val;
+    };
+
+    class initializer_list_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::initializer_list;
+
+        initializer_list_node(token_id lbrace, id_list items,
+                              token_id rbrace) :
+        node{kind_tag}, left{lbrace}, item_ids{items}, right{rbrace} { }
+
+        loc_range range(const ast& tree) const {
+            auto first = tree.token_at(left).range;
+            if (right != no_token) {
+                return { first.first, tree.token_at(right).range.second };
+            }
+            if (!item_ids.count) return first;
+            auto last = tree.list(item_ids).back();
+            return { first.first, tree.range(last).second };
+        }
+        std::string dump_info(const ast&) const {
+            return "INITIALIZER LIST {}";
+        }
+        template<typename F>
+        void for_each_child(const ast& tree, F&& f) const {
+            for (auto item : tree.list(item_ids)) f(item);
+        }
+        // initializers, some of them designation_nodes
+        id_list items() const { return item_ids; }
+    private:
+        token_id left;
+        id_list item_ids;
+        token_id right;
+    };
+
+    // designators = initializer
+    class designation_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::designation;
+
+        designation_node(id_list designators, node_id init) :
+        node{kind_tag}, designator_ids{designators}, init{init} { }
+
+        loc_range range(const ast& tree) const {
+            auto first = tree.list(designator_ids).front();
+            return { tree.range(first).first, tree.range(init).second };
+        }
+        std::string dump_info(const ast&) const {
+            return "DESIGNATION";
+        }
+        template<typename F>
+        void for_each_child(const ast& tree, F&& f) const {
+            for (auto designator : tree.list(designator_ids)) f(designator);
+            f(init);
+        }
+        id_list designators() const { return designator_ids; }
+        node_id initializer() const { return init; }
+    private:
+        id_list designator_ids;
+        node_id init;
+    };
+
+    // [ constant-expression ] or . identifier
+    class designator_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::designator;
+
+        // index is no_node for a member, whose name is last
+        designator_node(token_id first, node_id index, token_id last) :
+        node{kind_tag}, first{first}, idx{index}, last{last} { }
+
+        loc_range range(const ast& tree) const {
+            auto end = last != no_token ? tree.token_at(last).range
+                                        : tree.range(idx);
+            return { tree.token_at(first).range.first, end.second };
+        }
+        std::string dump_info(const ast& tree) const {
+            if (idx != no_node) return "DESIGNATOR []";
+            return "DESIGNATOR ." + std::string(tree.token_at(last).spelling);
+        }
+        template<typename F>
+        void for_each_child(const ast&, F&& f) const {
+            if (idx != no_node) f(idx);
+        }
+        node_id index() const { return idx; }
+        token_id member() const { return last; }
+    private:
+        token_id first;
+        node_id idx;
+        token_id last;
+    };
+
+    class static_assertion_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::static_assertion;
+
+        // message is no_token if the string literal was missing
+        static_assertion_node(token_id kw, node_id condition,
+                              token_id message, token_id semicolon) :
+        node{kind_tag}, kw{kw}, cond{condition}, msg{message},
+        semicolon{semicolon} { }
+
+        loc_range range(const ast& tree) const {
+            auto first = tree.token_at(kw).range.first;
+            if (semicolon != no_token) {
+                return { first, tree.token_at(semicolon).range.second };
+            }
+            auto last = msg != no_token ? tree.token_at(msg).range
+                                        : tree.range(cond);
+            return { first, last.second };
+        }
+        std::string dump_info(const ast& tree) const {
+            if (msg == no_token) return "STATIC ASSERT";
+            return "STATIC ASSERT " + std::string(tree.token_at(msg).spelling);
+        }
+        template<typename F>
+        void for_each_child(const ast&, F&& f) const { f(cond); }
+        node_id condition() const { return cond; }
+        token_id message() const { return msg; }
+    private:
+        token_id kw;
+        node_id cond;
+        token_id msg;
+        token_id semicolon;
+    };
+
+    class function_definition_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::function_definition;
+
+        // body is no_node if it was deferred, to be parsed into another
+        // tree; rbrace is its } either way
+        function_definition_node(node_id specs, node_id declarator,
+                                 id_list parameter_decls, node_id body,
+                                 token_id rbrace) :
+        node{kind_tag}, specs{specs}, decl{declarator},
+        param_decls{parameter_decls}, stmt{body}, right{rbrace} { }
+
+        loc_range range(const ast& tree) const {
+            return { tree.range(specs).first,
+                     tree.token_at(right).range.second };
+        }
+        std::string dump_info(const ast&) const {
+            return "FUNCTION DEFINITION";
+        }
+        template<typename F>
+        void for_each_child(const ast& tree, F&& f) const {
+            f(specs);
+            f(decl);
+            for (auto param : tree.list(param_decls)) f(param);
+            if (stmt != no_node) f(stmt);
+        }
+        node_id specifiers() const { return specs; }
+        node_id declarator() const { return decl; }
+        // the declarations between an identifier list and the body
+        id_list parameter_declarations() const { return param_decls; }
+        node_id body() const { return stmt; }
+    private:
+        node_id specs;
+        node_id decl;
+        id_list param_decls;
+        node_id stmt;
+        token_id right;
+    };
+
+    class translation_unit_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::translation_unit;
+
+        translation_unit_node(id_list declarations, token_id end) :
+        node{kind_tag}, decls{declarations}, end{end} { }
+
+        loc_range range(const ast& tree) const {
+            auto last = tree.token_at(end).range.second;
+            if (!decls.count) return { last, last };
+            return { tree.range(tree.list(decls).front()).first, last };
+        }
+        std::string dump_info(const ast&) const {
+            return "TRANSLATION UNIT";
+        }
+        template<typename F>
+        void for_each_child(const ast& tree, F&& f) const {
+            for (auto decl : tree.list(decls)) f(decl);
+        }
+        // declaration_nodes, function_definition_nodes and
+        // static_assertion_nodes
+        id_list declarations() const { return decls; }
+    private:
+        id_list decls;
+        token_id end;
+    };
+
+    // specifier-qualifier-list abstract-declarator(opt)
+    node_id parse_type_name(parser&);
+    // an assignment expression or a braced initializer list
+    node_id parse_initializer(parser&);
+    // at struct or union
+    node_id parse_record_specifier(parser&);
+    // at enum
+    node_id parse_enum_specifier(parser&);
+    // at _Static_assert
+    node_id parse_static_assert(parser&);
+    // a declaration in a block, including its ;
+    node_id parse_declaration(parser&);
+    // a declaration or function definition at file scope
+    node_id parse_external_declaration(parser&);
+    // all of the tokens, recovering from syntax errors at the next ; or }
+    node_id parse_translation_unit(parser&);
+    // a body that unit deferred, with its parameters in scope, into the
+    // tree of the parser given
+    node_id parse_deferred_body(parser&, const parser& unit,
+                                const deferred_body& body);
+}
+
+#endif
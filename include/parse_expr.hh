@@ -4,7 +4,7 @@
 #include "parser.hh"
 
 namespace parse {
-    extern ruleset expr_ruleset;
+    extern const ruleset expr_ruleset;
 
     enum expr_precedence {
         ep_postfix = 1000,
@@ -26,26 +26,212 @@ namespace parse {
 
     class cast_node : public node {
     public:
-        cast_node(token left, token right, node_ptr declarator,
-                  node_ptr op) :
-        left{left}, right{right}, declarator{std::move(declarator)},
-        op{std::move(op)} { }
+        static constexpr node_kind kind_tag = node_kind::cast;
 
-        loc_range range() override {
-            return { left.range.first, right.range.second };
+        cast_node(token_id left, token_id right, node_id type, node_id op) :
+        node{kind_tag}, left{left}, right{right}, type{type}, op{op} { }
+
+        loc_range range(const ast& tree) const {
+            return { tree.token_at(left).range.first,
+                     tree.range(op).second };
         }
-    private:
-        std::string get_dump_info() const override {
+        std::string dump_info(const ast&) const {
             return "CAST";
         }
-        std::vector<const node*> children() const override {
-            return { declarator.get(), op.get() };
+        template<typename F>
+        void for_each_child(const ast&, F&& f) const {
+            f(type);
+            f(op);
+        }
+        node_id type_name() const { return type; }
+        node_id operand() const { return op; }
+    private:
+        token_id left, right;
+        node_id type;
+        node_id op;
+    };
+
+    class subscript_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::subscript;
+
+        subscript_node(node_id base, token_id left, node_id index,
+                       token_id right) :
+        node{kind_tag}, lhs{base}, left{left}, idx{index}, right{right} { }
+
+        loc_range range(const ast& tree) const {
+            auto last = right != no_token ? tree.token_at(right).range
+                                          : tree.range(idx);
+            return { tree.range(lhs).first, last.second };
+        }
+        std::string dump_info(const ast&) const {
+            return "SUBSCRIPT []";
+        }
+        template<typename F>
+        void for_each_child(const ast&, F&& f) const {
+            f(lhs);
+            f(idx);
+        }
+        node_id base() const { return lhs; }
+        node_id index() const { return idx; }
+    private:
+        node_id lhs;
+        token_id left;
+        node_id idx;
+        token_id right;
+    };
+
+    // ( type-name ) { initializer-list }
+    class compound_literal_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::compound_literal;
+
+        compound_literal_node(token_id lparen, node_id type, node_id init) :
+        node{kind_tag}, left{lparen}, type{type}, init{init} { }
+
+        loc_range range(const ast& tree) const {
+            return { tree.token_at(left).range.first,
+                     tree.range(init).second };
+        }
+        std::string dump_info(const ast&) const {
+            return "COMPOUND LITERAL";
+        }
+        template<typename F>
+        void for_each_child(const ast&, F&& f) const {
+            f(type);
+            f(init);
+        }
+        node_id type_name() const { return type; }
+        node_id initializer() const { return init; }
+    private:
+        token_id left;
+        node_id type;
+        node_id init;
+    };
+
+    // sizeof or _Alignof applied to a parenthesized type name
+    class type_query_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::type_query;
+
+        type_query_node(token_id op, node_id type, token_id rparen) :
+        node{kind_tag}, op{op}, type{type}, right{rparen} { }
+
+        loc_range range(const ast& tree) const {
+            auto last = right != no_token ? tree.token_at(right).range
+                                          : tree.range(type);
+            return { tree.token_at(op).range.first, last.second };
+        }
+        std::string dump_info(const ast& tree) const {
+            return "TYPE QUERY " + std::string(tree.token_at(op).spelling);
+        }
+        template<typename F>
+        void for_each_child(const ast&, F&& f) const { f(type); }
+        token_id token() const { return op; }
+        node_id type_name() const { return type; }
+    private:
+        token_id op;
+        node_id type;
+        token_id right;
+    };
+
+    class generic_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::generic;
+
+        generic_node(token_id kw, node_id control, id_list assocs,
+                     token_id rparen) :
+        node{kind_tag}, kw{kw}, control{control}, assocs{assocs},
+        right{rparen} { }
+
+        loc_range range(const ast& tree) const {
+            auto first = tree.token_at(kw).range.first;
+            if (right != no_token) {
+                return { first, tree.token_at(right).range.second };
+            }
+            auto last = assocs.count ? tree.list(assocs).back() : control;
+            return { first, tree.range(last).second };
+        }
+        std::string dump_info(const ast&) const {
+            return "GENERIC";
+        }
+        template<typename F>
+        void for_each_child(const ast& tree, F&& f) const {
+            f(control);
+            for (auto assoc : tree.list(assocs)) f(assoc);
         }
+        node_id controlling_expr() const { return control; }
+        id_list associations() const { return assocs; }
+    private:
+        token_id kw;
+        node_id control;
+        id_list assocs;
+        token_id right;
+    };
 
-        token left, right;
-        node_ptr declarator;
-        node_ptr op;
+    class generic_association_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::generic_association;
+
+        // type is no_node for default
+        generic_association_node(token_id first, node_id type,
+                                 node_id value) :
+        node{kind_tag}, first{first}, type{type}, value{value} { }
+
+        loc_range range(const ast& tree) const {
+            return { tree.token_at(first).range.first,
+                     tree.range(value).second };
+        }
+        std::string dump_info(const ast&) const {
+            return type == no_node ? "DEFAULT ASSOCIATION" : "ASSOCIATION";
+        }
+        template<typename F>
+        void for_each_child(const ast&, F&& f) const {
+            if (type != no_node) f(type);
+            f(value);
+        }
+        node_id type_name() const { return type; }
+        node_id result() const { return value; }
+    private:
+        token_id first;
+        node_id type;
+        node_id value;
     };
+
+    class ternary_rule : public infix_rule {
+    public:
+        node_id parse(parser&, node_id, token_id) const override;
+        int precedence() const override { return ep_conditonal; }
+    };
+
+    class subscript_rule : public infix_rule {
+    public:
+        node_id parse(parser&, node_id, token_id) const override;
+        int precedence() const override { return ep_postfix; }
+    };
+
+    // . and ->, which must be followed by a member name
+    class member_rule : public infix_rule {
+    public:
+        node_id parse(parser&, node_id, token_id) const override;
+        int precedence() const override { return ep_postfix; }
+    };
+
+    // sizeof and _Alignof, whose operand may be a type name
+    class type_query_rule : public prefix_rule {
+    public:
+        node_id parse(parser&, token_id) const override;
+    };
+
+    class generic_rule : public prefix_rule {
+    public:
+        node_id parse(parser&, token_id) const override;
+    };
+
+    // an expression binding tighter than precedence, whichever ruleset
+    // is in use; ep_assignment gives a constant expression and ep_comma
+    // an assignment expression
+    node_id parse_expression(parser&, int precedence = 0);
 }
 
 #endif
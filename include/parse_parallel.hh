@@ -0,0 +1,57 @@
+#ifndef SPCC_PARSE_PARALLEL_HH
+#define SPCC_PARSE_PARALLEL_HH
+
+#include "parser.hh"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace parse {
+    // The { and } of each pair of braces at file scope, in order, found
+    // by counting braces rather than by parsing. Those of a function body
+    // let a parser skip it without looking inside. A { that is never
+    // closed pairs with nothing, and so does one whose parentheses and
+    // brackets within do not balance, so that a parser sees the error.
+    std::vector<brace_span> skim_braces(const std::vector<token>& tokens);
+
+    // a unit whose function bodies are parsed apart from the rest of it
+    struct parsed_unit {
+        // the parser of all but the bodies, kept for its tree and its
+        // file scope
+        std::unique_ptr<parser> top;
+        node_id root;
+        // the parsers of the bodies, each holding the tree it parsed
+        // some of them into
+        std::vector<std::unique_ptr<parser>> body_parsers;
+
+        const std::vector<deferred_body>& bodies() const {
+            return top->deferred_bodies();
+        }
+        const ast& tree_of(const deferred_body& body) const {
+            return body_parsers[body.tree]->tree();
+        }
+        // the body of the index-th deferred definition, which is parsed
+        // now if it has not been yet; not for use by more than one
+        // thread at a time
+        node_id body(std::size_t index);
+        std::size_t node_count() const;
+    };
+
+    // Parses a unit in two passes: the declarations of file scope in
+    // order, skipping the bodies the skim finds, and then the bodies in
+    // about jobs * 4 groups, on the threads of the pool the caller works
+    // for or else on jobs threads kept for the purpose. Diagnostics of
+    // the bodies come after those of file scope, in the order of the
+    // bodies, and no more errors are emitted between them than the error
+    // limit allows, though which ones depends on how the threads ran.
+    parsed_unit parse_translation_unit_parallel(
+        const std::vector<token>& tokens, unsigned jobs
+    );
+    // Parses the declarations of a unit and only skims its function
+    // bodies, for when few or none of them are needed; body() parses one
+    // when it is.
+    parsed_unit parse_translation_unit_lazy(const std::vector<token>& tokens);
+}
+
+#endif
@@ -0,0 +1,317 @@
+#ifndef SPCC_PARSE_STMT_HH
+#define SPCC_PARSE_STMT_HH
+
+#include "parser.hh"
+
+namespace parse {
+    class compound_statement_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::compound_statement;
+
+        compound_statement_node(token_id lbrace, id_list items,
+                                token_id rbrace) :
+        node{kind_tag}, left{lbrace}, item_ids{items}, right{rbrace} { }
+
+        loc_range range(const ast& tree) const {
+            auto first = tree.token_at(left).range;
+            if (right != no_token) {
+                return { first.first, tree.token_at(right).range.second };
+            }
+            if (!item_ids.count) return first;
+            auto last = tree.list(item_ids).back();
+            return { first.first, tree.range(last).second };
+        }
+        std::string dump_info(const ast&) const {
+            return "COMPOUND STATEMENT {}";
+        }
+        template<typename F>
+        void for_each_child(const ast& tree, F&& f) const {
+            for (auto item : tree.list(item_ids)) f(item);
+        }
+        // statements and declarations
+        id_list items() const { return item_ids; }
+    private:
+        token_id left;
+        id_list item_ids;
+        token_id right;
+    };
+
+    class expression_statement_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::expression_statement;
+
+        // expr is no_node for a null statement
+        expression_statement_node(node_id expr, token_id semicolon) :
+        node{kind_tag}, expr{expr}, semicolon{semicolon} { }
+
+        loc_range range(const ast& tree) const {
+            // a null statement always has its ;
+            if (expr == no_node) return tree.token_at(semicolon).range;
+            auto last = semicolon != no_token ? tree.token_at(semicolon).range
+                                              : tree.range(expr);
+            return { tree.range(expr).first, last.second };
+        }
+        std::string dump_info(const ast&) const {
+            return expr == no_node ? "NULL STATEMENT"
+                                   : "EXPRESSION STATEMENT";
+        }
+        template<typename F>
+        void for_each_child(const ast&, F&& f) const {
+            if (expr != no_node) f(expr);
+        }
+        node_id expression() const { return expr; }
+    private:
+        node_id expr;
+        token_id semicolon;
+    };
+
+    class if_statement_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::if_statement;
+
+        // otherwise is no_node without else
+        if_statement_node(token_id kw, node_id cond, node_id then,
+                          node_id otherwise) :
+        node{kind_tag}, kw{kw}, cond{cond}, then{then},
+        otherwise{otherwise} { }
+
+        loc_range range(const ast& tree) const {
+            auto last = otherwise == no_node ? then : otherwise;
+            return { tree.token_at(kw).range.first,
+                     tree.range(last).second };
+        }
+        std::string dump_info(const ast&) const {
+            return otherwise == no_node ? "IF" : "IF ELSE";
+        }
+        template<typename F>
+        void for_each_child(const ast&, F&& f) const {
+            f(cond);
+            f(then);
+            if (otherwise != no_node) f(otherwise);
+        }
+        node_id condition() const { return cond; }
+        node_id then_statement() const { return then; }
+        node_id else_statement() const { return otherwise; }
+    private:
+        token_id kw;
+        node_id cond, then, otherwise;
+    };
+
+    class switch_statement_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::switch_statement;
+
+        switch_statement_node(token_id kw, node_id cond, node_id body) :
+        node{kind_tag}, kw{kw}, cond{cond}, stmt{body} { }
+
+        loc_range range(const ast& tree) const {
+            return { tree.token_at(kw).range.first,
+                     tree.range(stmt).second };
+        }
+        std::string dump_info(const ast&) const {
+            return "SWITCH";
+        }
+        template<typename F>
+        void for_each_child(const ast&, F&& f) const {
+            f(cond);
+            f(stmt);
+        }
+        node_id condition() const { return cond; }
+        node_id body() const { return stmt; }
+    private:
+        token_id kw;
+        node_id cond, stmt;
+    };
+
+    class while_statement_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::while_statement;
+
+        while_statement_node(token_id kw, node_id cond, node_id body) :
+        node{kind_tag}, kw{kw}, cond{cond}, stmt{body} { }
+
+        loc_range range(const ast& tree) const {
+            return { tree.token_at(kw).range.first,
+                     tree.range(stmt).second };
+        }
+        std::string dump_info(const ast&) const {
+            return "WHILE";
+        }
+        template<typename F>
+        void for_each_child(const ast&, F&& f) const {
+            f(cond);
+            f(stmt);
+        }
+        node_id condition() const { return cond; }
+        node_id body() const { return stmt; }
+    private:
+        token_id kw;
+        node_id cond, stmt;
+    };
+
+    class do_statement_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::do_statement;
+
+        do_statement_node(token_id kw, node_id body, node_id cond,
+                          token_id semicolon) :
+        node{kind_tag}, kw{kw}, stmt{body}, cond{cond},
+        semicolon{semicolon} { }
+
+        loc_range range(const ast& tree) const {
+            auto last = semicolon != no_token ? tree.token_at(semicolon).range
+                                              : tree.range(cond);
+            return { tree.token_at(kw).range.first, last.second };
+        }
+        std::string dump_info(const ast&) const {
+            return "DO WHILE";
+        }
+        template<typename F>
+        void for_each_child(const ast&, F&& f) const {
+            f(stmt);
+            f(cond);
+        }
+        node_id body() const { return stmt; }
+        node_id condition() const { return cond; }
+    private:
+        token_id kw;
+        node_id stmt, cond;
+        token_id semicolon;
+    };
+
+    class for_statement_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::for_statement;
+
+        // init is a declaration, an expression or no_node, and cond and
+        // step may be no_node
+        for_statement_node(token_id kw, node_id init, node_id cond,
+                           node_id step, node_id body) :
+        node{kind_tag}, kw{kw}, init{init}, cond{cond}, step{step},
+        stmt{body} { }
+
+        loc_range range(const ast& tree) const {
+            return { tree.token_at(kw).range.first,
+                     tree.range(stmt).second };
+        }
+        std::string dump_info(const ast&) const {
+            return "FOR";
+        }
+        template<typename F>
+        void for_each_child(const ast&, F&& f) const {
+            if (init != no_node) f(init);
+            if (cond != no_node) f(cond);
+            if (step != no_node) f(step);
+            f(stmt);
+        }
+        node_id initializer() const { return init; }
+        node_id condition() const { return cond; }
+        node_id increment() const { return step; }
+        node_id body() const { return stmt; }
+    private:
+        token_id kw;
+        node_id init, cond, step, stmt;
+    };
+
+    // goto, continue and break
+    class jump_statement_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::jump_statement;
+
+        // label is no_token but for goto
+        jump_statement_node(token_id kw, token_id label,
+                            token_id semicolon) :
+        node{kind_tag}, kw{kw}, target{label}, semicolon{semicolon} { }
+
+        loc_range range(const ast& tree) const {
+            auto last = semicolon != no_token ? semicolon
+                      : target != no_token ? target : kw;
+            return { tree.token_at(kw).range.first,
+                     tree.token_at(last).range.second };
+        }
+        std::string dump_info(const ast& tree) const {
+            auto result = "JUMP " + std::string(tree.token_at(kw).spelling);
+            if (target == no_token) return result;
+            return result + " " + std::string(tree.token_at(target).spelling);
+        }
+        template<typename F>
+        void for_each_child(const ast&, F&&) const { }
+        token_id keyword() const { return kw; }
+        token_id label() const { return target; }
+    private:
+        token_id kw;
+        token_id target;
+        token_id semicolon;
+    };
+
+    class return_statement_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::return_statement;
+
+        // value is no_node for return;
+        return_statement_node(token_id kw, node_id value,
+                              token_id semicolon) :
+        node{kind_tag}, kw{kw}, val{value}, semicolon{semicolon} { }
+
+        loc_range range(const ast& tree) const {
+            auto first = tree.token_at(kw).range;
+            if (semicolon != no_token) {
+                return { first.first, tree.token_at(semicolon).range.second };
+            }
+            if (val == no_node) return first;
+            return { first.first, tree.range(val).second };
+        }
+        std::string dump_info(const ast&) const {
+            return "RETURN";
+        }
+        template<typename F>
+        void for_each_child(const ast&, F&& f) const {
+            if (val != no_node) f(val);
+        }
+        node_id value() const { return val; }
+    private:
+        token_id kw;
+        node_id val;
+        token_id semicolon;
+    };
+
+    // identifier:, case constant-expression: and default:
+    class labeled_statement_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::labeled_statement;
+
+        // value is the constant expression of case, else no_node
+        labeled_statement_node(token_id first, node_id value,
+                               node_id stmt) :
+        node{kind_tag}, first{first}, val{value}, stmt{stmt} { }
+
+        loc_range range(const ast& tree) const {
+            return { tree.token_at(first).range.first,
+                     tree.range(stmt).second };
+        }
+        std::string dump_info(const ast& tree) const {
+            const auto& tok = tree.token_at(first);
+            if (tok.is(kw_case)) return "CASE";
+            if (tok.is(kw_default)) return "DEFAULT";
+            return "LABEL " + std::string(tok.spelling);
+        }
+        template<typename F>
+        void for_each_child(const ast&, F&& f) const {
+            if (val != no_node) f(val);
+            f(stmt);
+        }
+        token_id label() const { return first; }
+        node_id value() const { return val; }
+        node_id statement() const { return stmt; }
+    private:
+        token_id first;
+        node_id val;
+        node_id stmt;
+    };
+
+    node_id parse_statement(parser&);
+    // at {, with the block items up to the matching }
+    node_id parse_compound_statement(parser&);
+}
+
+#endif
@@ -3,221 +3,368 @@
 
 #include "token.hh"
 #include "buffer.hh"
+#include "scope.hh"
 #include "type.hh"
 
+#include <array>
 #include <memory>
+#include <optional>
 #include <vector>
-#include <exception>
 #include <map>
 #include <set>
+#include <span>
 #include <cstddef>
+#include <cstdint>
+#include <new>
 #include <stack>
 #include <string>
 #include <string_view>
+#include <type_traits>
+#include <utility>
 
 namespace parse {
     class parser;
+    class ast;
+
+    // where a token is in the token vector being parsed
+    using token_id = std::uint32_t;
+    // where a node is in its ast
+    using node_id = std::uint32_t;
+    constexpr node_id no_node = ~node_id(0);
+    constexpr token_id no_token = ~token_id(0);
+
+    // a run of ids stored with the ast, for nodes with any number of
+    // children or tokens
+    struct id_list {
+        std::uint32_t first = 0;
+        std::uint32_t count = 0;
+    };
+
+    // every kind of node, so that a walk over a tree can switch on a tag
+    // instead of calling through a vtable; ast_visit.hh maps each to its
+    // class
+    enum class node_kind : std::uint8_t {
+        token,
+        unary,
+        paren,
+        binary,
+        ternary,
+        call,
+        cast,
+        subscript,
+        compound_literal,
+        type_query,
+        generic,
+        generic_association,
+        abstract_placeholder,
+        declarator_array,
+        error,
+        specifiers,
+        declaration,
+        init_declarator,
+        bit_field,
+        parameter,
+        type_name,
+        record,
+        enumeration,
+        enumerator,
+        initializer_list,
+        designation,
+        designator,
+        static_assertion,
+        function_definition,
+        translation_unit,
+        compound_statement,
+        expression_statement,
+        if_statement,
+        switch_statement,
+        while_statement,
+        do_statement,
+        for_statement,
+        jump_statement,
+        return_statement,
+        labeled_statement,
+    };
 
+    // Nodes live in an ast and refer to their children and tokens by
+    // index. They own nothing, so the ast frees all of them at once
+    // without running a destructor. Each kind gives its range, the line
+    // it dumps as and its children, in source order, through
+    // for_each_child; none of them is virtual.
     class node {
     public:
-        void dump(std::size_t indent = 0) const;
-        virtual loc_range range() = 0;
-        virtual ~node() = 0;
+        node_kind kind() const { return k; }
+    protected:
+        explicit node(node_kind k) : k{k} { }
     private:
-        virtual std::string get_dump_info() const = 0;
-        virtual std::vector<const node*> children() const = 0;
+        node_kind k;
     };
 
-    using node_ptr = std::unique_ptr<node>;
+    // The nodes of one parse, bump-allocated in large blocks so that a
+    // tree is laid out in the order it was built and goes away in one
+    // step with its ast.
+    class ast {
+    public:
+        explicit ast(const std::vector<token>& tokens) : tokens{&tokens} { }
+        ast(const ast&) = delete;
+        ast& operator=(const ast&) = delete;
+        ast(ast&&) = default;
+        ast& operator=(ast&&) = default;
+
+        template<typename T, typename... Args>
+        node_id make(Args&&... args) {
+            static_assert(std::is_trivially_destructible_v<T>);
+            void* memory = allocate(sizeof(T), alignof(T));
+            nodes.push_back(new (memory) T(std::forward<Args>(args)...));
+            return static_cast<node_id>(nodes.size() - 1);
+        }
+        const node& operator[](node_id id) const { return *nodes[id]; }
+        std::size_t size() const { return nodes.size(); }
+
+        id_list add_list(std::span<const std::uint32_t> ids);
+        std::span<const std::uint32_t> list(id_list ids) const {
+            return { lists.data() + ids.first, ids.count };
+        }
+        const token& token_at(token_id id) const { return (*tokens)[id]; }
+
+        loc_range range(node_id id) const;
+        void dump(node_id id, std::size_t indent = 0) const;
+    private:
+        void* allocate(std::size_t size, std::size_t align);
+
+        static constexpr std::size_t block_size = 64 * 1024;
+        std::vector<std::unique_ptr<std::byte[]>> blocks;
+        std::size_t block_used = block_size;
+        std::vector<node*> nodes;
+        std::vector<std::uint32_t> lists;
+        const std::vector<token>* tokens;
+    };
 
     class token_node : public node {
     public:
-        token_node(token tok) : tok{tok} { }
-        loc_range range() override { return tok.range; }
-        const struct token& token() const { return tok; }
-    private:
-        std::string get_dump_info() const override {
-            return "TOKEN " + std::string(tok.spelling);
+        static constexpr node_kind kind_tag = node_kind::token;
+
+        token_node(token_id tok) : node{kind_tag}, tok{tok} { }
+        loc_range range(const ast& tree) const {
+            return tree.token_at(tok).range;
         }
-        std::vector<const node*> children() const override {
-            return {};
+        std::string dump_info(const ast& tree) const {
+            return "TOKEN " + std::string(tree.token_at(tok).spelling);
         }
-
-        struct token tok;
+        template<typename F>
+        void for_each_child(const ast&, F&&) const { }
+        token_id token() const { return tok; }
+    private:
+        token_id tok;
     };
 
     class unary_node : public node {
     public:
-        unary_node(token tok, node_ptr operand, bool prefix) :
-        tok{tok}, op{std::move(operand)}, prefix{prefix} { }
+        static constexpr node_kind kind_tag = node_kind::unary;
 
-        loc_range range() override {
-            return { tok.range.first, op->range().second };
+        unary_node(token_id tok, node_id operand, bool prefix) :
+        node{kind_tag}, tok{tok}, op{operand}, prefix{prefix} { }
+
+        loc_range range(const ast& tree) const {
+            return { tree.token_at(tok).range.first,
+                     tree.range(op).second };
         }
-        const struct token& token() const { return tok; }
-        const node& operand() const { return *op; }
-        bool is_prefix() const { return prefix; }
-    private:
-        std::string get_dump_info() const override {
-            auto result =  "UNARY " + std::string(tok.spelling);
+        std::string dump_info(const ast& tree) const {
+            auto result = "UNARY " + std::string(tree.token_at(tok).spelling);
             result += prefix ? " prefix" : " postfix";
             return result;
         }
-        std::vector<const node*> children() const override {
-            return { op.get() };
-        }
-
-        struct token tok;
-        node_ptr op;
+        template<typename F>
+        void for_each_child(const ast&, F&& f) const { f(op); }
+        token_id token() const { return tok; }
+        node_id operand() const { return op; }
+        bool is_prefix() const { return prefix; }
+    private:
+        token_id tok;
+        node_id op;
         bool prefix;
     };
 
     class paren_node : public node {
     public:
-        paren_node(token left, node_ptr operand, token right) :
-        left{left}, op{std::move(operand)}, right{right} { }
+        static constexpr node_kind kind_tag = node_kind::paren;
+
+        paren_node(token_id left, node_id operand, token_id right) :
+        node{kind_tag}, left{left}, op{operand}, right{right} { }
 
-        loc_range range() override {
-            return { left.range.first, right.range.second };
+        loc_range range(const ast& tree) const {
+            auto last = right != no_token ? tree.token_at(right).range
+                                          : tree.range(op);
+            return { tree.token_at(left).range.first, last.second };
         }
-        const node& operand() const { return *op; }
-        const struct token& lparen() const { return left; }
-        const struct token& rparen() const { return right; }
-    private:
-        std::string get_dump_info() const override {
+        std::string dump_info(const ast&) const {
             return "PAREN GROUPING ()";
         }
-        std::vector<const node*> children() const override {
-            return { op.get() };
-        }
-
-        struct token left;
-        node_ptr op;
-        struct token right;
+        template<typename F>
+        void for_each_child(const ast&, F&& f) const { f(op); }
+        node_id operand() const { return op; }
+        token_id lparen() const { return left; }
+        token_id rparen() const { return right; }
+    private:
+        token_id left;
+        node_id op;
+        token_id right;
     };
 
     class binary_node : public node {
     public:
-        binary_node(token tok, node_ptr left, node_ptr right) :
-        tok{tok}, left{std::move(left)}, right{std::move(right)} { }
+        static constexpr node_kind kind_tag = node_kind::binary;
+
+        binary_node(token_id tok, node_id left, node_id right) :
+        node{kind_tag}, tok{tok}, left{left}, right{right} { }
 
-        loc_range range() override {
-            return { left->range().first, right->range().second };
+        loc_range range(const ast& tree) const {
+            return { tree.range(left).first, tree.range(right).second };
         }
-        const struct token& token() const { return tok; }
-        const node& lhs() const { return *left; }
-        const node& rhs() const { return *right; }
-    private:
-        std::string get_dump_info() const override {
-            return "BINARY " + std::string(tok.spelling);
+        std::string dump_info(const ast& tree) const {
+            return "BINARY " + std::string(tree.token_at(tok).spelling);
         }
-        std::vector<const node*> children() const override {
-            return { left.get(), right.get() };
+        template<typename F>
+        void for_each_child(const ast&, F&& f) const {
+            f(left);
+            f(right);
         }
-
-        struct token tok;
-        node_ptr left, right;
+        token_id token() const { return tok; }
+        node_id lhs() const { return left; }
+        node_id rhs() const { return right; }
+    private:
+        token_id tok;
+        node_id left, right;
     };
 
     class ternary_node : public node {
     public:
-        ternary_node(token tok1, token tok2, node_ptr op1,
-                     node_ptr op2, node_ptr op3) :
-        tok1{tok1}, tok2{tok2}, op1{std::move(op1)},
-        op2{std::move(op2)}, op3{std::move(op3)} { }
-
-        loc_range range() override {
-            return { op1->range().first, op3->range().second };
-        }
-        const struct token& first_token() const { return tok1; }
-        const struct token& second_token() const { return tok2; }
-        const node& first_operand() const { return *op1; }
-        const node& second_operand() const { return *op2; }
-        const node& third_operand() const { return *op3; }
-    private:
-        std::string get_dump_info() const override {
-            auto result = "TERNARY " + std::string(tok1.spelling);
-            result += " " + std::string(tok2.spelling);
-            return result;
+        static constexpr node_kind kind_tag = node_kind::ternary;
+
+        ternary_node(token_id tok1, token_id tok2, node_id op1,
+                     node_id op2, node_id op3) :
+        node{kind_tag}, tok1{tok1}, tok2{tok2}, op1{op1}, op2{op2},
+        op3{op3} { }
+
+        loc_range range(const ast& tree) const {
+            return { tree.range(op1).first, tree.range(op3).second };
         }
-        std::vector<const node*> children() const override {
-            return { op1.get(), op2.get(), op3.get() };
+        std::string dump_info(const ast& tree) const {
+            return "TERNARY " + std::string(tree.token_at(tok1).spelling) +
+                   " :";
         }
-
-        struct token tok1, tok2;
-        node_ptr op1, op2, op3;
+        template<typename F>
+        void for_each_child(const ast&, F&& f) const {
+            f(op1);
+            f(op2);
+            f(op3);
+        }
+        token_id first_token() const { return tok1; }
+        // no_token if the : was missing
+        token_id second_token() const { return tok2; }
+        node_id first_operand() const { return op1; }
+        node_id second_operand() const { return op2; }
+        node_id third_operand() const { return op3; }
+    private:
+        token_id tok1, tok2;
+        node_id op1, op2, op3;
     };
 
     class call_node : public node {
     public:
-        call_node(node_ptr callee, token lparen, token rparen,
-                  std::vector<node_ptr> args) :
-        call_target{std::move(callee)}, left{lparen}, right{rparen},
-        arguments{std::move(args)} { }
-
-        loc_range range() override {
-            return { call_target->range().first, right.range.second };
-        }
-        const struct token& lparen() const { return left; }
-        const struct token& rparen() const { return right; }
-        const std::vector<node_ptr>& args() const { return arguments; }
-        const node& callee() const { return *call_target; }
-    private:
-        std::string get_dump_info() const override {
+        static constexpr node_kind kind_tag = node_kind::call;
+
+        call_node(node_id callee, token_id lparen, token_id rparen,
+                  id_list args) :
+        node{kind_tag}, call_target{callee}, left{lparen}, right{rparen},
+        arguments{args} { }
+
+        loc_range range(const ast& tree) const {
+            auto first = tree.range(call_target).first;
+            if (right != no_token) {
+                return { first, tree.token_at(right).range.second };
+            }
+            if (!arguments.count) {
+                return { first, tree.token_at(left).range.second };
+            }
+            return { first, tree.range(tree.list(arguments).back()).second };
+        }
+        std::string dump_info(const ast&) const {
             return "CALL()";
         }
-        std::vector<const node*> children() const override {
-            std::vector<const node*> result;
-            result.push_back(call_target.get());
-            for (const auto& arg : arguments) {
-                result.push_back(arg.get());
-            }
-            return result;
+        template<typename F>
+        void for_each_child(const ast& tree, F&& f) const {
+            f(call_target);
+            for (auto arg : tree.list(arguments)) f(arg);
         }
+        token_id lparen() const { return left; }
+        token_id rparen() const { return right; }
+        id_list args() const { return arguments; }
+        node_id callee() const { return call_target; }
+    private:
+        node_id call_target;
+        token_id left;
+        token_id right;
+        id_list arguments;
+    };
+
+    // stands in for what could not be parsed, so that a syntax error
+    // still gives the caller a tree
+    class error_node : public node {
+    public:
+        static constexpr node_kind kind_tag = node_kind::error;
 
-        node_ptr call_target;
-        struct token left;
-        struct token right;
-        std::vector<node_ptr> arguments;
+        error_node(token_id tok) : node{kind_tag}, tok{tok} { }
+        loc_range range(const ast& tree) const {
+            return tree.token_at(tok).range;
+        }
+        std::string dump_info(const ast&) const {
+            return "ERROR";
+        }
+        template<typename F>
+        void for_each_child(const ast&, F&&) const { }
+        token_id token() const { return tok; }
+    private:
+        token_id tok;
     };
 
     class prefix_rule {
     public:
-        virtual node_ptr parse(parser&, token) const = 0;
+        virtual node_id parse(parser&, token_id) const = 0;
         virtual ~prefix_rule() = default;
     };
 
     class token_rule : public prefix_rule {
     public:
-        node_ptr parse(parser&, token) const override;
+        node_id parse(parser&, token_id) const override;
     };
 
     class unary_prefix_rule : public prefix_rule {
     public:
-        unary_prefix_rule(int prec) : prec{prec} { }
-        node_ptr parse(parser&, token) const override;
+        constexpr unary_prefix_rule(int prec) : prec{prec} { }
+        node_id parse(parser&, token_id) const override;
     private:
         int prec;
     };
 
     class paren_rule : public prefix_rule {
     public:
-        node_ptr parse(parser&, token) const override;
+        node_id parse(parser&, token_id) const override;
     };
 
     class infix_rule {
     public:
-        virtual node_ptr parse(parser&, node_ptr, token) const = 0;
+        virtual node_id parse(parser&, node_id, token_id) const = 0;
         virtual int precedence() const = 0;
         virtual ~infix_rule() = default;
     };
 
     class binary_rule : public infix_rule {
     public:
-        binary_rule(int prec, bool right_assoc) :
+        constexpr binary_rule(int prec, bool right_assoc) :
         prec{prec}, right_assoc{right_assoc} { }
 
-        node_ptr parse(parser&, node_ptr, token) const override;
+        node_id parse(parser&, node_id, token_id) const override;
         int precedence() const override { return prec; }
     private:
         int prec;
@@ -226,8 +373,8 @@ namespace parse {
 
     class unary_postfix_rule : public infix_rule {
     public:
-        unary_postfix_rule(int prec) : prec{prec} { }
-        node_ptr parse(parser&, node_ptr, token) const override;
+        constexpr unary_postfix_rule(int prec) : prec{prec} { }
+        node_id parse(parser&, node_id, token_id) const override;
         int precedence() const override { return prec; }
     private:
         int prec;
@@ -235,69 +382,214 @@ namespace parse {
 
     class call_rule : public infix_rule {
     public:
-        node_ptr parse(parser&, node_ptr, token) const override;
+        node_id parse(parser&, node_id, token_id) const override;
         int precedence() const override { return INT_MAX; }
     };
 
-    class parse_error : public std::exception {
+    // a rule applies to a token by its kind, punctuator or keyword alone
+    using token_check = bool(*)(const token&);
+    template<typename T>
+    struct rule_entry {
+        token_check matches;
+        const T* rule;
+    };
+    template<typename T>
+    using rule_list = std::span<const rule_entry<T>>;
+
+    constexpr std::size_t token_kind_count = token::end_of_input + 1;
+    constexpr std::size_t punctuator_count =
+        static_cast<std::size_t>(punctuator::hash_hash) + 1;
+    constexpr std::size_t keyword_count = kw_Thread_local + 1;
+    constexpr std::size_t dispatch_size =
+        token_kind_count + punctuator_count + keyword_count;
+
+    // where a token's rule is in a dispatch_table
+    inline std::size_t dispatch_index(const token& tok) {
+        if (tok.is(token::punctuator)) {
+            return token_kind_count + static_cast<std::size_t>(tok.punc);
+        }
+        if (tok.is(token::keyword)) {
+            return token_kind_count + punctuator_count + tok.kw;
+        }
+        return tok.kind;
+    }
+
+    // one token for each slot of a dispatch_table
+    std::span<const token> token_shapes();
+
+    // A rule list asked once, up front, about every kind of token, so
+    // that finding the rule for a token is a single array load. Tokens
+    // that more than one rule claims are counted rather than thrown
+    // about while parsing; the tests require there to be none.
+    template<typename T>
+    class dispatch_table {
     public:
-        parse_error(std::string msg) : msg{std::move(msg)} { }
-        const char* what() const noexcept override {
-            return msg.c_str();
+        dispatch_table(rule_list<T> rules) {
+            for (const auto& tok : token_shapes()) {
+                const T* match = nullptr;
+                for (const auto& entry : rules) {
+                    if (!entry.matches(tok)) continue;
+                    if (match) ++conflict_count;
+                    match = entry.rule;
+                }
+                slots[dispatch_index(tok)] = match;
+            }
+        }
+
+        const T* find(const token& tok) const {
+            return slots[dispatch_index(tok)];
         }
+        std::size_t conflicts() const { return conflict_count; }
     private:
-        std::string msg;
+        std::array<const T*, dispatch_size> slots{};
+        std::size_t conflict_count = 0;
     };
 
-    using token_check = bool(*)(const token&, parser& p);
-    template<typename T>
-    using rule_map = std::map<token_check, T*>;
+    // rules and rulesets are immutable once built, so any number of
+    // parsers may share them
     struct ruleset {
-        rule_map<prefix_rule> prefix_rules;
-        rule_map<infix_rule> infix_rules;
+        ruleset(rule_list<prefix_rule> prefix, rule_list<infix_rule> infix) :
+        prefix_rules{prefix}, infix_rules{infix} { }
+
+        dispatch_table<prefix_rule> prefix_rules;
+        dispatch_table<infix_rule> infix_rules;
+    };
+
+    extern const ruleset expr_ruleset;
+    extern const ruleset declarator_ruleset;
+
+    // the { and the matching } of a pair of braces
+    struct brace_span {
+        token_id open;
+        token_id close;
     };
 
-    extern ruleset expr_ruleset;
-    extern ruleset declarator_ruleset;
+    // a function body that the parser of its unit skipped, to be parsed
+    // apart from the rest of the unit
+    struct deferred_body {
+        // the function_definition_node, in the unit's tree
+        node_id definition;
+        brace_span braces;
+        // once parsed, which of the trees of the unit's bodies holds it
+        // and where
+        std::uint32_t tree = 0;
+        node_id body = no_node;
+    };
 
+    // Parses a token vector that ends in token::end_of_input through a
+    // cursor that never moves past it, so looking ahead needs no bounds
+    // check. A syntax error is diagnosed, leaves an error_node in the
+    // tree and puts the parser into recovery, in which parse() and
+    // expect() give up at once without consuming anything until the
+    // caller calls synchronize().
     class parser {
     public:
-        parser(const std::vector<token>& tokens) : tokens{tokens} { }
-        node_ptr parse(int precedence);
-        token next() noexcept(false);
-        const token& peek() const noexcept(false);
+        parser(const std::vector<token>& tokens);
+        node_id parse(int precedence);
+        const token& next() {
+            const token& tok = *cursor;
+            if (!tok.is(token::end_of_input)) ++cursor;
+            return tok;
+        }
+        const token& peek() const { return *cursor; }
+        // the token after peek(), or the end if there is none
+        const token& peek_next() const {
+            return has_next_token() ? cursor[1] : *cursor;
+        }
         void rewind();
-        bool has_next_token() const;
+        // moves the cursor to the token at position, out of any recovery
+        void seek(token_id position);
+        bool has_next_token() const {
+            return !cursor->is(token::end_of_input);
+        }
         const ruleset& rules() const;
-        bool is_typedef_name(std::string_view name) const;
-        const sem::type* get_typedef_type(std::string_view name) const;
+        bool is_typedef_name(std::string_view name) const {
+            return find_typedef(name);
+        }
+        // the declaration of name in the innermost scope that has one,
+        // if that makes it a typedef name, else null
+        const scope_table::symbol* find_typedef(std::string_view name) const {
+            auto sym = scopes.find(name);
+            if (!sym && file_scope) {
+                sym = file_scope->find_before(name, file_scope_end);
+            }
+            return sym && sym->is_typedef ? sym : nullptr;
+        }
+        // the type is null until types are built from declarators
+        void declare_typedef(std::string_view name, sem::qual_type ty);
+        // an object, function or enumeration constant, which hides a
+        // typedef name of an enclosing scope
+        void declare_ordinary(std::string_view name);
+        void push_scope() { scopes.push_scope(); }
+        void pop_scope() { scopes.pop_scope(); }
+        const scope_table& scope() const { return scopes; }
+        // For a parser of bodies another parser deferred: what the body
+        // does not declare itself is looked up in the unit's file scope,
+        // as it stood at the token at position.
+        void use_file_scope(const scope_table& unit, token_id position) {
+            file_scope = &unit;
+            file_scope_end = position;
+        }
+        // Skips function bodies that start one of braces, the file-scope
+        // brace pairs of the tokens in order, recording each in
+        // deferred_bodies() rather than parsing it.
+        void defer_bodies(std::vector<brace_span> braces);
+        // the } of the body starting at the cursor, if it is to be skipped
+        std::optional<token_id> deferrable_body() const;
+        void defer_body(const deferred_body& body) {
+            deferred.push_back(body);
+        }
+        std::vector<deferred_body>& deferred_bodies() { return deferred; }
+        const std::vector<deferred_body>& deferred_bodies() const {
+            return deferred;
+        }
         void push_ruleset(bool declarator);
         void pop_ruleset();
         bool could_be_expr_ahead() const;
+        // whether peek() starts declaration specifiers or _Static_assert
+        bool declaration_ahead() const;
         bool is_parsing_declarator() const;
-
-        sem::type_manager tm;
-    private:
-        template<typename T>
-        const T* find_rule(const token& tok, const rule_map<T>& rules) {
-            T* match = nullptr;
-            for (const auto& pair : rules) {
-                if (pair.first(tok, *this)) {
-                    if (match) {
-                        throw parse_error("multiple rules matched token");
-                    }
-                    match = pair.second;
-                }
-            }
-            return match;
+        std::size_t position() const { return cursor - first; }
+        // the token the last next() returned
+        token_id last() const { return cursor - first - 1; }
+        // consumes punc and returns it, or diagnoses it as missing and
+        // returns no_token, which node ranges leave out
+        token_id expect(punctuator punc, std::string_view spelling);
+        // diagnoses a syntax error unless one is already being recovered
+        // from, and starts recovery
+        void fail(std::optional<location> loc, std::string_view message);
+        bool recovering() const { return in_recovery; }
+        // ends recovery past the next ; or past the } of a { skipped on
+        // the way; in_braces stops before a } that closes the block or
+        // struct body the caller is parsing, which it then consumes
+        void synchronize(bool in_braces = false);
+
+        template<typename T, typename... Args>
+        node_id make(Args&&... args) {
+            return nodes.make<T>(std::forward<Args>(args)...);
         }
-        int precedence_peek() noexcept(false);
+        ast& tree() { return nodes; }
+        const ast& tree() const { return nodes; }
 
-        const std::vector<token>& tokens;
-        std::size_t next_token = 0;
-
-        std::map<std::string_view, const sem::type*> typedef_names;
+        // the types of the unit being parsed, which the parsers of its
+        // bodies share, so that they compare by address across parsers
+        sem::type_manager& tm;
+    private:
+        int precedence_peek() const;
+
+        const token* first;
+        const token* cursor;
+        // the end of input
+        const token* last_token;
+        bool in_recovery = false;
+
+        scope_table scopes;
+        const scope_table* file_scope = nullptr;
+        token_id file_scope_end = 0;
+        std::vector<brace_span> skippable;
+        std::vector<deferred_body> deferred;
         std::stack<bool> use_declarator_ruleset;
+        ast nodes;
     };
 }
 
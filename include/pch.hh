@@ -0,0 +1,59 @@
+#ifndef SPCC_PCH_HH
+#define SPCC_PCH_HH
+
+#include "pp.hh"
+#include "platform.hh"
+
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace pp {
+    // Preprocessor state after a prefix header, as written by --emit-pch.
+    // The file is mapped into memory and used in place: macros are found
+    // through a hash index in the file and only become macro objects when
+    // a translation unit refers to them, so opening it costs the same no
+    // matter how many macros it holds.
+    class pch {
+    public:
+        struct contents {
+            std::vector<const macro*> macros;
+            std::set<std::filesystem::path> once_files;
+            std::map<std::filesystem::path, std::string> guards;
+            // the prefix and every file it included, with the modification
+            // times the state was computed from
+            std::map<std::filesystem::path,
+                     std::filesystem::file_time_type> dependencies;
+        };
+
+        static bool write(const std::string& path, const contents& state);
+        // nullptr after a diagnostic if the file is invalid or out of date
+        static std::shared_ptr<const pch> open(const std::string& path);
+
+        std::optional<macro> find_macro(std::string_view name) const;
+        std::size_t macro_count() const;
+        std::vector<std::filesystem::path> once_files() const;
+        std::map<std::filesystem::path, std::string> guards() const;
+
+        ~pch();
+    private:
+        struct layout;
+
+        pch(const std::string& path,
+            std::unique_ptr<platform::mapped_file> file,
+            std::unique_ptr<const layout> sections);
+
+        std::unique_ptr<platform::mapped_file> file;
+        std::unique_ptr<const layout> sections;
+        // the string pool, which macro locations point into
+        std::unique_ptr<const buffer> strings;
+    };
+}
+
+#endif
@@ -10,8 +10,34 @@
 #endif
 
 #include <cstdio>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
 
 namespace platform {
+    // CPU time consumed so far by the calling thread
+    std::chrono::nanoseconds thread_cpu_time();
+
+    // a whole file mapped read-only into memory
+    class mapped_file {
+    public:
+        // nullptr if the file cannot be opened or mapped
+        static std::unique_ptr<mapped_file> open(const std::string& path);
+        ~mapped_file();
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+        std::string_view data() const { return { address, size }; }
+    private:
+        mapped_file() = default;
+        const char* address = nullptr;
+        std::size_t size = 0;
+#if defined(PLATFORM_WIN32)
+        void* file = nullptr;
+        void* mapping = nullptr;
+#endif
+    };
+
     namespace stream {
         enum class color {
             red,
@@ -30,6 +56,42 @@ namespace platform {
         void set_style(FILE*, style);
         void reset_attributes(FILE*);
         bool is_terminal(FILE*);
+
+        // where diagnostics and other per-translation-unit output of the
+        // calling thread go; stdout unless a capture is active
+        FILE* output();
+        // the same for text that belongs on stderr
+        FILE* errors();
+
+        // Redirects output() and errors() on the calling thread into memory
+        // for the lifetime of the capture. Colors are kept if stdout or
+        // stderr is a terminal, since that is where the text ends up.
+        class capture {
+        public:
+            capture();
+            ~capture();
+            capture(const capture&) = delete;
+            capture& operator=(const capture&) = delete;
+            std::string str();
+            std::string error_str();
+        private:
+            struct memory_file {
+                memory_file();
+                ~memory_file();
+                std::string str();
+
+                FILE* file;
+#if defined(PLATFORM_POSIX)
+                char* data = nullptr;
+                std::size_t size = 0;
+#endif
+            };
+
+            memory_file out;
+            memory_file err;
+            FILE* previous_output;
+            FILE* previous_errors;
+        };
     }
 }
 
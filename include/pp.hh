@@ -2,13 +2,17 @@
 #define SPCC_PP_HH
 
 #include "buffer.hh"
+#include "header_cache.hh"
 #include "token.hh"
 
+#include <cstdint>
+#include <filesystem>
 #include <memory>
 #include <regex>
 #include <utility>
 #include <map>
 #include <optional>
+#include <set>
 
 namespace pp {
     using buffer_ptrs = std::vector<std::unique_ptr<buffer>>;
@@ -66,6 +70,8 @@ namespace pp {
         std::size_t index_ = 0;
     };
 
+    class pch;
+
     struct macro {
         std::string_view name;
         location loc;
@@ -86,9 +92,19 @@ namespace pp {
             placemarker_buffer = std::make_unique<raw_buffer>("<placemarker>",
                                                               "$\n");
             add_predefined_macros();
+            main_conditionals = map_conditionals(this->tokens);
         }
 
         std::vector<token> process(bool in_arg = false);
+        // starts from the state saved in a precompiled prefix; must be
+        // called before process()
+        void use_pch(std::shared_ptr<const pch> prefix);
+        // saves the state after process() for use with use_pch()
+        bool write_pch(const std::string& path) const;
+        // every header opened, once each, as named in its #include
+        const std::vector<std::string>& included_files() const {
+            return included_paths;
+        }
     private:
         enum ws_mode {
             SKIP,
@@ -111,12 +127,16 @@ namespace pp {
         void handle_include_directive();
         void handle_ifdef_directive();
         void handle_ifndef_directive();
+        void handle_if_directive();
+        void handle_elif_directive();
         void handle_else_directive();
         void handle_endif_directive();
         void handle_non_directive();
 
-        void maybe_diagnose_macro_redefinition(const macro& def) const;
+        macro* find_macro(std::string_view name);
+        void maybe_diagnose_macro_redefinition(const macro& def);
         std::optional<std::vector<token>> maybe_expand_macro();
+        void mark_expansion(std::vector<token>& expansion, expansion_id id);
         std::vector<token> handle_concatenation(std::vector<token> in);
         void remove_placemarkers(std::vector<token>& v);
         token make_placemarker();
@@ -128,6 +148,10 @@ namespace pp {
         token make_line_token(token at);
         bool in_disabled_region() const;
         void handle_ifdef_ifndef(token tok, bool is_ifndef);
+        void push_conditional(location loc, bool enabled);
+        bool evaluate_condition_line(token directive);
+        void skip_disabled_group(std::size_t hash_index);
+        void note_macro_change(std::string_view name);
 
         std::unique_ptr<buffer> buf;
         std::vector<token> tokens;
@@ -136,9 +160,52 @@ namespace pp {
         std::vector<std::unique_ptr<buffer>> extra_buffers;
         std::unique_ptr<raw_buffer> placemarker_buffer;
         std::size_t index = 0;
-        std::vector<bool> cond_states;
+        // the #if groups being processed, innermost last
+        struct conditional {
+            bool enabled; // the current group's tokens are kept
+            bool taken; // no later #elif or #else group can be
+            bool had_else;
+        };
+        std::vector<conditional> cond_states;
+        // #if and #elif results by the text of the condition. An entry
+        // holds while none of the names its evaluation looked at has been
+        // #define'd or #undef'd since, which saves expanding the same
+        // condition again each time a header is included.
+        struct cached_condition {
+            bool result;
+            std::uint64_t stamp; // macro_generation when it was evaluated
+            std::vector<std::string_view> names;
+        };
+        bool is_current(const cached_condition& entry) const;
+        std::map<std::string, cached_condition, std::less<>> condition_cache;
+        std::string condition_key;
+        // bumped by every #define and #undef, which also stamp the name
+        std::uint64_t macro_generation = 0;
+        std::map<std::string_view, std::uint64_t> macro_versions;
+        // when set, find_macro adds every name it is asked about, whether
+        // or not it is a macro
+        std::vector<std::string_view>* lookup_log = nullptr;
         std::size_t include_level = 0;
 
+        // macros of a precompiled prefix become entries in macros on first
+        // use, unless they have been #undef'd since
+        std::shared_ptr<const pch> prefix;
+        std::set<std::string_view> undefined_prefix_macros;
+        // the files being included, innermost last
+        struct open_file {
+            std::filesystem::path key; // header_key() of the path
+            std::string path; // as it was opened
+            const conditional_map* conditionals;
+        };
+        std::vector<open_file> include_stack;
+        conditional_map main_conditionals;
+        // headers by header_key()
+        std::set<std::filesystem::path> once_files;
+        std::map<std::filesystem::path, std::string> known_guards;
+        std::map<std::filesystem::path,
+                 std::filesystem::file_time_type> dependencies;
+        std::vector<std::string> included_paths;
+
         struct saved_state {
             std::vector<token> tokens;
             std::vector<token> out;
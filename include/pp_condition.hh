@@ -0,0 +1,30 @@
+#ifndef SPCC_PP_CONDITION_HH
+#define SPCC_PP_CONDITION_HH
+
+#include "token.hh"
+
+#include <cstdint>
+#include <optional>
+#include <span>
+
+namespace pp {
+    /* [6.10.1]/4
+     ... all signed integer types and all unsigned integer types act as if
+     they have the same representation as, respectively, the types intmax_t
+     and uintmax_t ...
+    */
+    struct condition_value {
+        std::uintmax_t bits = 0;
+        bool is_unsigned = false;
+    };
+
+    // Evaluates the controlling expression of #if or #elif once defined
+    // and macro replacement have been done, straight from the tokens and
+    // without allocating. Errors are diagnosed at directive; the result
+    // is then nothing, and the group is skipped.
+    std::optional<condition_value> evaluate_condition(
+        std::span<const token> tokens, const token& directive
+    );
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef SPCC_PP_OUTPUT_HH
+#define SPCC_PP_OUTPUT_HH
+
+#include "buffer.hh"
+#include "token.hh"
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace pp {
+    // Collects text in a large block and hands it to the stream in few
+    // big writes
+    class text_writer {
+    public:
+        explicit text_writer(FILE* out);
+        ~text_writer();
+        text_writer(const text_writer&) = delete;
+        text_writer& operator=(const text_writer&) = delete;
+
+        void write(std::string_view text) {
+            if (pending.size() + text.size() > capacity) flush();
+            pending.append(text);
+        }
+        void put(char c) {
+            if (pending.size() == capacity) flush();
+            pending.push_back(c);
+        }
+        void flush();
+    private:
+        static constexpr std::size_t capacity = 1 << 20;
+
+        FILE* out;
+        std::string pending;
+    };
+
+    // Writes the result of phase 4 as text that preprocesses to the same
+    // tokens, with line markers that tie each line to its source file.
+    // main is the buffer that phase 4 was started on.
+    void write_preprocessed(const std::vector<token>& tokens,
+                            const buffer& main, text_writer& out);
+    // the same, to the file at path as -o names it, or to output() if
+    // path is empty
+    void write_preprocessed(const std::vector<token>& tokens,
+                            const buffer& main, const std::string& path);
+
+    // a make rule with the given prerequisites, wrapped like gcc's
+    std::string format_dependencies(
+        std::string_view target, const std::vector<std::string>& prerequisites
+    );
+}
+
+#endif
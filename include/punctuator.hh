@@ -1,8 +1,8 @@
 #ifndef SPCC_PUNCTUATOR_HH
 #define SPCC_PUNCTUATOR_HH
 
-#include <map>
-#include <string>
+#include <optional>
+#include <string_view>
 
 /* [6.4.6]/1
  punctuator: one of
@@ -64,6 +64,7 @@ enum class punctuator {
     hash_hash,
 };
 
-extern std::map<std::string, punctuator> punctuator_table;
+// nullopt if the spelling is not a punctuator
+std::optional<punctuator> find_punctuator(std::string_view spelling);
 
 #endif
@@ -0,0 +1,74 @@
+#ifndef SPCC_SCOPE_HH
+#define SPCC_SCOPE_HH
+
+#include "type.hh"
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace parse {
+    /* [6.2.1]/4
+     ... If an identifier designates two different entities in the same
+     name space, the scopes might overlap. If so, the scope of one entity
+     (the inner scope) will end strictly before the scope of the other
+     entity (the outer scope). Within the inner scope, the identifier
+     designates the entity declared in the inner scope ...
+    */
+    // The ordinary identifiers of the scopes open while parsing, which is
+    // what tells a typedef name from any other identifier. Each name is
+    // interned once to a slot holding its innermost declaration, so a
+    // lookup is a single hash probe; each declaration logs what it hid,
+    // so closing a scope costs as much as the scope declared.
+    class scope_table {
+    public:
+        struct symbol {
+            bool is_typedef = false;
+            // null until types are built from declarators
+            sem::qual_type type{};
+            // the token the declaration was complete at
+            std::uint32_t declared_at = 0;
+        };
+
+        // file scope is always open; these open and close the scopes of
+        // blocks and prototypes within it
+        void push_scope();
+        void pop_scope();
+        // hides any declaration of name in an enclosing scope until the
+        // innermost scope is popped
+        void declare(std::string_view name, symbol sym);
+        // the innermost declaration of name, or null if there is none
+        const symbol* find(std::string_view name) const {
+            auto it = ids.find(name);
+            if (it == ids.end()) return nullptr;
+            const auto& slot = slots[it->second];
+            return slot ? &*slot : nullptr;
+        }
+        // the same, for a name of file scope declared before the token at
+        // position, so that a body parsed after the whole of file scope
+        // sees only what it would have in order
+        const symbol* find_before(std::string_view name,
+                                  std::uint32_t position) const {
+            auto sym = find(name);
+            return sym && sym->declared_at < position ? sym : nullptr;
+        }
+        // how many scopes are open within file scope
+        std::size_t depth() const { return marks.size(); }
+    private:
+        struct undo_entry {
+            std::uint32_t id;
+            std::optional<symbol> hidden;
+        };
+
+        // names are views of token spellings, which outlive the parse
+        std::unordered_map<std::string_view, std::uint32_t> ids;
+        std::vector<std::optional<symbol>> slots;
+        std::vector<undo_entry> undo_log;
+        // where the undo log stood when each open scope began
+        std::vector<std::size_t> marks;
+    };
+}
+
+#endif
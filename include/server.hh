@@ -0,0 +1,27 @@
+#ifndef SPCC_SERVER_HH
+#define SPCC_SERVER_HH
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+// A compile server that keeps process-wide caches, such as the header
+// cache, warm between requests. Requests carry the client's working
+// directory and argument vector. The response carries the exit code and
+// everything the request wrote to platform::stream::errors() and
+// platform::stream::output().
+namespace server {
+    using handler = std::function<int(const std::vector<std::string>& args)>;
+
+    // serves requests one at a time until the process is killed;
+    // returns false if the socket cannot be set up
+    bool serve(const std::string& socket_path, const handler& handle);
+
+    // sends the arguments to the server, copies its output to stdout and
+    // returns its exit code, or nullopt if the server cannot be reached
+    std::optional<int> request(const std::string& socket_path,
+                               const std::vector<std::string>& args);
+}
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef SPCC_STATS_HH
+#define SPCC_STATS_HH
+
+#include "trace.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <chrono>
+
+namespace stats {
+    enum class phase {
+        one,
+        two,
+        three,
+        four,
+        six,
+        seven,
+        parse,
+        count,
+    };
+
+    enum class counter {
+        tokens_lexed,
+        macros_expanded,
+        bytes_read,
+        includes_processed,
+        header_cache_hits,
+        include_guard_skips,
+        include_lookups,
+        include_lookups_cached,
+        conditions_evaluated,
+        conditions_cached,
+        diagnostics_emitted,
+        count,
+    };
+
+    // Measures wall time, CPU time, and allocations for a phase while it
+    // is alive. Timers nest; time spent in an inner timer is attributed
+    // only to the inner phase, so phases one through three of an included
+    // file are not also counted as phase four.
+    class phase_timer {
+    public:
+        phase_timer(phase p);
+        ~phase_timer();
+        phase_timer(const phase_timer&) = delete;
+        phase_timer& operator=(const phase_timer&) = delete;
+    private:
+        void pause();
+        void resume();
+
+        phase which;
+        bool active;
+        trace::span span;
+        phase_timer* outer = nullptr;
+        std::chrono::steady_clock::time_point wall_start;
+        std::chrono::nanoseconds cpu_start;
+        std::uint64_t allocs_start = 0;
+        std::chrono::nanoseconds wall{0};
+        std::chrono::nanoseconds cpu{0};
+        std::uint64_t allocs = 0;
+    };
+
+    // whether timers, counters and the allocation count are kept; they
+    // cost nothing until --time-report turns them on
+    void enable(bool on);
+    void count(counter c, std::uint64_t n = 1);
+    std::uint64_t allocation_count();
+    void report(FILE* f, bool json);
+    // forgets the totals and counts so far, for a server starting on a
+    // new request; no timer may be running
+    void reset();
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef SPCC_THREAD_POOL_HH
+#define SPCC_THREAD_POOL_HH
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of workers, each with its own task deque. Tasks submitted
+// from inside a task go to the submitting worker's deque, and the worker
+// takes the newest of those first. Tasks submitted from outside the pool
+// go to one shared queue and are started in the order they came, so
+// that results the caller consumes in that order arrive in it. A worker
+// with nothing of its own takes from the shared queue, and failing that
+// steals the oldest task from another worker.
+class thread_pool {
+public:
+    using task = std::function<void()>;
+
+    explicit thread_pool(unsigned workers);
+    ~thread_pool();
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    void submit(task t);
+    // blocks until every submitted task has finished
+    void wait();
+    // blocks until done() holds, which a finishing task may make true;
+    // a worker of the pool runs tasks submitted from inside the pool
+    // meanwhile, rather than hold up the tasks it is waiting for
+    void wait_until(const std::function<bool()>& done);
+    unsigned size() const { return threads.size(); }
+    // the pool the calling thread is a worker of, if any
+    static thread_pool* current();
+private:
+    struct worker_queue {
+        std::mutex mutex;
+        std::deque<task> tasks;
+    };
+
+    bool pop(unsigned self, task& t);
+    bool pop_submitted(task& t);
+    bool steal(unsigned self, task& t);
+    void execute(task& t);
+    void run(unsigned self);
+
+    std::vector<std::unique_ptr<worker_queue>> queues;
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable work_available;
+    // notified whenever a task finishes
+    std::condition_variable task_finished;
+    // tasks submitted from outside the pool, guarded by mutex
+    std::deque<task> submitted;
+    std::size_t queued = 0;
+    std::size_t unfinished = 0;
+    bool stopping = false;
+};
+
+#endif
@@ -32,6 +32,9 @@ struct token {
         keyword,
         floating_constant,
         integer_constant,
+        // after the last token of phase 7, so that the parser can look
+        // ahead without checking for the end
+        end_of_input,
     };
 
     token(token_kind kind, std::string_view spelling,
@@ -0,0 +1,34 @@
+#ifndef SPCC_TRACE_HH
+#define SPCC_TRACE_HH
+
+#include <chrono>
+#include <string>
+#include <string_view>
+
+// Chrome trace event output (chrome://tracing or Perfetto)
+namespace trace {
+    bool enabled();
+
+    // Records a complete event covering the lifetime of the span. Spans
+    // shorter than the granularity are dropped unless always_record is set.
+    class span {
+    public:
+        span(std::string_view name, std::string_view detail = {},
+             bool always_record = false);
+        ~span();
+        span(const span&) = delete;
+        span& operator=(const span&) = delete;
+    private:
+        std::string_view name;
+        std::string_view detail;
+        bool always_record;
+        bool active;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    void write(const std::string& filename);
+    // drops the events recorded so far
+    void reset();
+}
+
+#endif
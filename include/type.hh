@@ -3,9 +3,18 @@
 
 #include "util.hh"
 
-#include <unordered_map>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 namespace sem {
     enum type_kind {
@@ -29,18 +38,99 @@ namespace sem {
         ik_long,
         ik_long_long,
     };
+    constexpr std::size_t integer_kind_count = ik_long_long + 1;
 
     enum floating_kind {
         fk_float,
         fk_double,
         fk_long_double,
     };
+    constexpr std::size_t floating_kind_count = fk_long_double + 1;
+
+    // a set of type qualifiers [6.7.3]
+    enum qualifier : unsigned {
+        q_const = 1,
+        q_volatile = 2,
+        q_restrict = 4,
+        q_Atomic = 8,
+    };
+    constexpr unsigned all_qualifiers = q_const | q_volatile | q_restrict |
+                                        q_Atomic;
+
+    class type;
+
+    // A type with its qualifiers in one word, the way clang's QualType
+    // has them: types are aligned so that the low bits of their address
+    // are always zero, and those bits hold the qualifiers. Adding or
+    // removing one is then a mask, with nothing to allocate or look up,
+    // and a qual_type is as cheap to pass around as a pointer.
+    class qual_type {
+    public:
+        // like a pointer, indeterminate unless value-initialized, as in
+        // qual_type{}, which is null
+        qual_type() = default;
+        qual_type(const type* ty, unsigned quals = 0) :
+        bits{reinterpret_cast<std::uintptr_t>(ty) | quals} {
+            assert(!(reinterpret_cast<std::uintptr_t>(ty) & all_qualifiers));
+            assert(!(quals & ~all_qualifiers));
+        }
+
+        const type* get() const {
+            return reinterpret_cast<const type*>(bits & ~mask);
+        }
+        const type* operator->() const { return get(); }
+        const type& operator*() const { return *get(); }
+        explicit operator bool() const { return get(); }
+
+        unsigned qualifiers() const { return bits & mask; }
+        bool is_const() const { return bits & q_const; }
+        bool is_volatile() const { return bits & q_volatile; }
+        bool is_restrict() const { return bits & q_restrict; }
+        bool is_atomic() const { return bits & q_Atomic; }
+        // these leave an array type as it is; type_manager::qualify moves
+        // qualifiers to the element type as [6.7.3]/9 has it
+        qual_type with_qualifiers(unsigned quals) const {
+            return from_bits(bits | (quals & mask));
+        }
+        qual_type without_qualifiers(unsigned quals) const {
+            return from_bits(bits & ~std::uintptr_t{quals & mask});
+        }
+        qual_type unqualified() const { return from_bits(bits & ~mask); }
+
+        // the packed word, as a key for hashing
+        std::uintptr_t opaque() const { return bits; }
+        friend bool operator==(qual_type, qual_type) = default;
+
+        std::string to_string() const;
+    private:
+        static constexpr std::uintptr_t mask = all_qualifiers;
+
+        static qual_type from_bits(std::uintptr_t packed) {
+            qual_type result;
+            result.bits = packed;
+            return result;
+        }
+
+        std::uintptr_t bits;
+    };
+
+    // a member of a structure or union; name is empty for an anonymous
+    // one or unnamed bit-field
+    struct member {
+        std::string_view name;
+        qual_type member_type;
+    };
 
-    class type {
+    // Types are made by a type_manager, which makes each derived type
+    // once, so that two types are the same type exactly when they
+    // are the same object. Structures, unions and enumerations are the
+    // exception: each declaration of one with a body is a new type
+    // [6.7.2.3]/5. Qualified types are not made at all, but are
+    // qual_types of the unqualified type.
+    class alignas(all_qualifiers + 1) type {
     public:
-        type(enum type_kind kind) : kind{kind} { }
-        type(integer_kind int_kind, bool is_signed) :
-        kind{tk_integer}, int_kind{int_kind}, is_signed{is_signed} { }
+        type() : kind{tk_void} { }
+        explicit type(enum type_kind kind) : kind{kind} { }
 
         bool is_basic_type() const;
         bool is_arithmetic_type() const;
@@ -61,6 +151,31 @@ namespace sem {
 
         enum type_kind type_kind() const { return kind; }
 
+        // tk_pointer
+        qual_type pointee() const { return pointee_type; }
+        // tk_array; the size is empty for an array of unknown size
+        qual_type element() const { return array.element; }
+        std::optional<std::uint64_t> array_size() const;
+        // tk_function; the return and parameter types are unqualified,
+        // since their qualifiers make no difference to the function's
+        // type [6.7.6.3]/15, and array and function parameters are
+        // adjusted to pointers
+        const type* return_type() const { return result_type; }
+        std::span<const type* const> parameters() const {
+            return { param_types, param_count };
+        }
+        bool is_variadic() const { return variadic; }
+        // false for a declarator with an empty identifier list, as in
+        // int f(), which says nothing about the parameters
+        bool has_prototype() const { return prototype; }
+        // tk_structure, tk_union and tk_enum; the tag is empty if there
+        // is none
+        std::string_view tag() const { return { tag_chars, tag_length }; }
+        std::span<const member> members() const {
+            return { member_list, member_count };
+        }
+        bool is_complete() const;
+
         std::string to_string() const;
     private:
         friend class type_manager;
@@ -73,39 +188,108 @@ namespace sem {
                 bool is_signed;
             };
             floating_kind float_kind; // tk_*_floating
-            const type* pointee_type; // tk_pointer
+            qual_type pointee_type; // tk_pointer
             struct { // tk_function
-                // TODO
+                const type* result_type;
+                const type* const* param_types;
+                std::uint32_t param_count;
+                bool variadic;
+                bool prototype;
             };
-            struct {  // tk_array
-                // TODO
+            // tk_array; named, since anonymous structs are an extension
+            // that does not allow a member with a constructor
+            struct {
+                qual_type element;
+                std::uint64_t count;
+                bool has_size;
+            } array;
+            struct { // tk_structure, tk_union and tk_enum
+                const char* tag_chars;
+                std::uint32_t tag_length;
+                const member* member_list;
+                std::uint32_t member_count;
+                bool complete;
             };
         };
     };
 
+    // Several threads may make types with one manager at once, as the
+    // parsers of one unit's function bodies do.
     class type_manager {
     public:
         type_manager();
+        type_manager(const type_manager&) = delete;
+        type_manager& operator=(const type_manager&) = delete;
+
+        const type* get_integer_type(integer_kind kind, bool is_signed) const {
+            assert(!(kind == ik_bool && is_signed));
+            return &(is_signed ? signed_integer_types
+                               : unsigned_integer_types)[kind];
+        }
+        const type* get_real_floating_type(floating_kind kind) const {
+            return &real_floating_types[kind];
+        }
+        const type* get_complex_floating_type(floating_kind kind) const {
+            return &complex_floating_types[kind];
+        }
+        const type* get_void_type() const { return &void_type; }
+
+        const type* build_pointer_to(qual_type ty);
+        // an array of unknown size if size is empty
+        const type* build_array_of(qual_type element,
+                                   std::optional<std::uint64_t> size);
+        const type* build_function(const type* result,
+                                   std::span<const qual_type> params,
+                                   bool is_variadic, bool has_prototype);
+        // ty with quals added to those it has, which for an array type
+        // means a new type of array
+        qual_type qualify(qual_type ty, unsigned quals);
 
-        const type* build_pointer_to(const type* ty);
-        const type* get_integer_type(integer_kind kind, bool is_signed) const;
-        const type* get_real_floating_type(floating_kind kind) const;
-        const type* get_complex_floating_type(floating_kind kind) const;
-        const type* get_void_type() const;
+        // a structure, union or enumeration not like any other, which is
+        // incomplete until complete_record or complete_enum
+        type* create_tagged(enum type_kind kind, std::string_view tag);
+        void complete_record(type* record, std::span<const member> members);
+        void complete_enum(type* enumeration);
+
+        // how many derived types have been made
+        std::size_t size() const {
+            std::lock_guard lock{mutex};
+            return derived.size();
+        }
     private:
-        void initialize_integer_types();
-        void initialize_floating_types();
-        void register_integer_type(integer_kind kind, bool is_signed);
-        void register_floating_type(floating_kind kind, bool is_real);
-
-        using type_uptr = std::unique_ptr<type>;
-
-        type_uptr void_type;
-        std::unordered_map<integer_kind, type_uptr> signed_integer_types;
-        std::unordered_map<integer_kind, type_uptr> unsigned_integer_types;
-        std::unordered_map<floating_kind, type_uptr> real_floating_types;
-        std::unordered_map<floating_kind, type_uptr> complex_floating_types;
-        std::unordered_map<const type*, type_uptr> pointer_types;
+        // what makes a derived type the type it is; params points into
+        // the caller's list while looking up and into the manager's once
+        // the type exists
+        struct type_key {
+            enum type_kind kind;
+            std::uintptr_t base;
+            std::uint64_t extent;
+            std::span<const type* const> params;
+
+            bool operator==(const type_key& other) const;
+        };
+        struct key_hash {
+            std::size_t operator()(const type_key& key) const;
+        };
+
+        // the type key describes, made by make if there is none yet
+        template<typename F>
+        const type* intern(const type_key& key, F&& make);
+
+        type void_type{tk_void};
+        std::array<type, integer_kind_count> signed_integer_types;
+        std::array<type, integer_kind_count> unsigned_integer_types;
+        std::array<type, floating_kind_count> real_floating_types;
+        std::array<type, floating_kind_count> complex_floating_types;
+
+        // guards what follows, which the builtin types above need not be
+        mutable std::mutex mutex;
+        // never moved once made, so that types can point at them
+        std::deque<type> derived;
+        std::deque<type> tagged;
+        std::vector<std::unique_ptr<const type*[]>> parameter_lists;
+        std::vector<std::unique_ptr<member[]>> member_lists;
+        std::unordered_map<type_key, const type*, key_hash> interned;
     };
 }
 
@@ -1,6 +1,8 @@
 #include "buffer.hh"
+#include "context.hh"
 
 #include <algorithm>
+#include <cassert>
 
 location location::find_spelling_loc() const {
     if (buffer().parent()) {
@@ -28,10 +30,30 @@ std::size_t derived_buffer::offset_in_original(std::size_t offset) const {
     }
 }
 
-void location::add_expansion_entry(location loc, std::size_t depth) {
-    if (depth > 10) return;
-    if (expanded_from) expanded_from->add_expansion_entry(loc, depth + 1);
-    else expanded_from = std::make_shared<location>(loc);
+std::optional<location> location::expanded_from() const {
+    if (!expansion_) return {};
+    return current_context().expansion_sites()[expansion_].site;
+}
+
+std::optional<location> location::included_at() const {
+    for (auto buf = &buffer(); buf; buf = buf->parent()) {
+        if (auto at = buf->included_at()) return at;
+    }
+    return {};
+}
+
+expansion_id expansion_table::record(location site, location definition) {
+    entries_.push_back({ site, definition });
+    return static_cast<expansion_id>(entries_.size());
+}
+
+const expansion_entry& expansion_table::operator[](expansion_id id) const {
+    assert(id && id <= entries_.size());
+    return entries_[id - 1];
+}
+
+expansion_id expansion_table::parent(expansion_id id) const {
+    return (*this)[id].site.expansion();
 }
 
 std::string_view derived_buffer::peek() const {
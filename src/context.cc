@@ -0,0 +1,34 @@
+#include "context.hh"
+
+#include <cassert>
+#include <utility>
+
+namespace {
+    thread_local compilation_context* current = nullptr;
+}
+
+compilation_context::compilation_context(options::config config) :
+options{std::move(config)}, previous{current} {
+    current = this;
+}
+
+compilation_context::compilation_context(
+    helper_tag, compilation_context& unit,
+    std::atomic<std::size_t>* claimed_errors
+) :
+options{unit.options}, diagnostics_requested{unit.diagnostics_requested},
+error_count{unit.error_count}, claimed_errors{claimed_errors},
+unit_expansions{&unit.expansion_sites()}, unit_types{&unit.types()},
+previous{current} {
+    current = this;
+}
+
+compilation_context::~compilation_context() {
+    assert(current == this);
+    current = previous;
+}
+
+compilation_context& current_context() {
+    assert(current && "no compilation context on this thread");
+    return *current;
+}
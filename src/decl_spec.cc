@@ -1,7 +1,9 @@
 #include "decl_spec.hh"
 #include "parser.hh"
-#include "options.hh"
+#include "context.hh"
 #include "diagnostic.hh"
+#include "parse_decl.hh"
+#include "parse_expr.hh"
 
 #include <algorithm>
 #include <cassert>
@@ -20,7 +22,7 @@ p.next(); \
 continue;
 #define TYPE_QUALIFIER_CASE(x) \
 case kw_##x: \
-ds.type_qualifiers.push_back(tq_##x); \
+ds.type_qualifiers |= q_##x; \
 p.next(); \
 continue;
 #define FUNCTION_SPECIFIER_CASE(x) \
@@ -33,9 +35,13 @@ namespace parse {
     decl_spec parse_decl_spec(parser& p) {
         decl_spec ds;
         ds.p = &p;
+        const auto first = static_cast<token_id>(p.position());
+        std::vector<token_id> words;
+        std::vector<node_id> parts;
         for (;;) {
-            auto tok = p.peek();
-            ds.loc_start = tok.range.first;
+            const auto& tok = p.peek();
+            if (!ds.loc_start) ds.loc_start = tok.range.first;
+            words.push_back(static_cast<token_id>(p.position()));
             if (tok.is(token::keyword)) {
                 switch (tok.kw) {
                     SIMPLE_TYPE_SPECIFIER_CASE(void)
@@ -58,53 +64,76 @@ namespace parse {
                     TYPE_QUALIFIER_CASE(const)
                     TYPE_QUALIFIER_CASE(restrict)
                     TYPE_QUALIFIER_CASE(volatile)
-                    TYPE_QUALIFIER_CASE(Atomic)
                     FUNCTION_SPECIFIER_CASE(inline)
                     FUNCTION_SPECIFIER_CASE(Noreturn)
 
-                    case kw_Alignas: {
+                    case kw_Atomic:
                         p.next();
-                        auto lparen = p.next();
-                        if (!lparen.is(punctuator::paren_left)) {
-                            diagnose(diagnostic::id::pp7_expected_token,
-                                     lparen.range.first, "(");
-                            p.rewind(); // this might help recovery
+                        /* [6.7.2.4]/4
+                         If the _Atomic keyword is immediately followed by
+                         a left parenthesis, it is interpreted as a type
+                         specifier (with a type name), not as a type
+                         qualifier.
+                        */
+                        if (p.peek().is(punctuator::paren_left)) {
+                            p.next();
+                            auto type = parse_type_name(p);
+                            p.expect(punctuator::paren_right, ")");
+                            ds.tagged_type_specifiers.push_back(type);
+                            parts.push_back(type);
+                        } else {
+                            ds.type_qualifiers |= q_Atomic;
                         }
+                        continue;
+                    case kw_Alignas: {
+                        p.next();
+                        p.expect(punctuator::paren_left, "(");
                         alignment_specifier as;
                         if (p.could_be_expr_ahead()) {
-                            p.push_ruleset(false);
-                            as.expr = p.parse(0);
-                            p.pop_ruleset();
+                            as.expr = parse_expression(p, ep_assignment);
+                            parts.push_back(as.expr);
                         } else {
-                            assert(false); // TODO parse type name
-                        }
-                        auto rparen = p.next();
-                        if (!rparen.is(punctuator::paren_right)) {
-                            diagnose(diagnostic::id::pp7_expected_token,
-                                     rparen.range.first, ")");
-                            p.rewind();
+                            as.type_name = parse_type_name(p);
+                            parts.push_back(as.type_name);
                         }
+                        p.expect(punctuator::paren_right, ")");
                         ds.alignment_specifiers.push_back(std::move(as));
                         continue;
                     }
                     case kw_struct:
                     case kw_union:
-                    case kw_enum:
-                        assert(false); // TODO
-                        break;
+                    case kw_enum: {
+                        // the specifier is a part rather than a word
+                        words.pop_back();
+                        auto spec = tok.is(kw_enum) ? parse_enum_specifier(p)
+                                                    : parse_record_specifier(p);
+                        ds.tagged_type_specifiers.push_back(spec);
+                        parts.push_back(spec);
+                        continue;
+                    }
                     default:
                         break;
                 }
             } else if (tok.is(token::identifier)) {
-                if (p.is_typedef_name(tok.spelling)) {
-                    auto ty = p.get_typedef_type(tok.spelling);
-                    ds.direct_type_specifiers.push_back(ty);
+                // a typedef name cannot be combined with other type
+                // specifiers, so after one an identifier is what is
+                // being declared, even if it names a type outside
+                auto name = ds.has_type_specifier()
+                           ? nullptr : p.find_typedef(tok.spelling);
+                if (name) {
+                    ds.direct_type_specifiers.push_back(name->type);
                     p.next();
                     continue;
                 }
             }
+            words.pop_back();
             break;
         }
+        auto word_list = p.tree().add_list(words);
+        auto part_list = p.tree().add_list(parts);
+        ds.node = p.make<specifiers_node>(
+            first, static_cast<token_id>(p.position()), word_list, part_list
+        );
         return ds;
     }
 
@@ -133,7 +162,7 @@ namespace parse {
             if (match(specs, { sts_void })) {
                 return p->tm.get_void_type();
             } else if (match(specs, { sts_char })) {
-                bool char_signed = options::state.is_char_signed;
+                bool char_signed = current_context().options.is_char_signed;
                 return p->tm.get_integer_type(ik_char, char_signed);
             } else if (match(specs, { sts_signed, sts_char })) {
                 return p->tm.get_integer_type(ik_char, true);
@@ -202,7 +231,18 @@ namespace parse {
                 diagnose(diagnostic::id::pp7_invalid_decl_spec_type,
                          loc_start);
             }
-            return direct_type_specifiers[0];
+            return direct_type_specifiers[0].get();
+        }
+    }
+
+    qual_type decl_spec::build_type() {
+        auto quals = type_qualifiers;
+        if (!direct_type_specifiers.empty()) {
+            quals |= direct_type_specifiers[0].qualifiers();
         }
+        auto ty = build_unqualified_type();
+        // null until typedef names are given their types
+        if (!ty) return {};
+        return p->tm.qualify(ty, quals);
     }
 }
@@ -1,6 +1,7 @@
 #include "declarator.hh"
 #include "util.hh"
 #include "diagnostic.hh"
+#include "parse_decl.hh"
 #include "parse_expr.hh"
 
 using diagnostic::diagnose;
@@ -23,22 +24,24 @@ static bool is_type_qualifier(keyword kw) {
 }
 
 namespace parse {
-    node_ptr abstract_placeholder_rule::parse(parser& p, token tok) const {
+    node_id abstract_placeholder_rule::parse(parser& p, token_id tok) const {
         p.rewind(); // we don't want to consume this token
-        return std::make_unique<abstract_placeholder_node>(tok);
+        return p.make<abstract_placeholder_node>(tok);
     }
 
-    node_ptr declarator_array_rule::parse(parser& p, node_ptr lhs,
-                                          token tok) const {
-        std::vector<token> mods;
+    node_id declarator_array_rule::parse(parser& p, node_id lhs,
+                                         token_id tok) const {
+        std::vector<token_id> mods;
         while (p.peek().is(token::keyword)) {
             if (is_type_qualifier(p.peek().kw) || p.peek().is(kw_static)) {
-                mods.push_back(p.next());
+                p.next();
+                mods.push_back(p.last());
             } else break;
         }
         bool found_star = false;
         if (p.peek().is(punctuator::star)) {
-            mods.push_back(p.next());
+            p.next();
+            mods.push_back(p.last());
             found_star = true;
         }
         if (found_star && !p.peek().is(punctuator::square_right)) {
@@ -48,100 +51,174 @@ namespace parse {
             mods.pop_back();
             p.rewind();
         }
-        node_ptr size = nullptr;
+        node_id size = no_node;
         if (!p.peek().is(punctuator::square_right)) {
             p.push_ruleset(false);
             size = p.parse(0);
             p.pop_ruleset();
         }
-        auto end = p.next();
-        if (!end.is(punctuator::square_right)) {
+        auto end = static_cast<token_id>(p.position());
+        if (p.peek().is(punctuator::square_right)) {
+            p.next();
+        } else if (!p.recovering()) {
             diagnose(diagnostic::id::pp7_expected_end_of_array_declarator,
-                     end.range.first);
+                     p.peek().range.first);
+        }
+        auto mod_list = p.tree().add_list(mods);
+        return p.make<declarator_array_node>(lhs, mod_list, size, tok, end);
+    }
+
+    node_id parse_declarator(parser& p) {
+        const auto start = p.position();
+        p.push_ruleset(true);
+        auto declarator = p.parse(0);
+        p.pop_ruleset();
+        if (p.position() == start) {
+            // an abstract declarator consumed nothing, so there is
+            // no way to make progress here
+            p.fail(p.peek().range.first, "expected declarator");
         }
-        return std::make_unique<declarator_array_node>(std::move(lhs),
-                                                       std::move(mods),
-                                                       std::move(size),
-                                                       tok, end);
+        return declarator;
+    }
+
+    node_id parse_optional_initializer(parser& p) {
+        if (p.recovering() || !p.peek().is(punctuator::equal)) return no_node;
+        p.next();
+        return parse_initializer(p);
+    }
+
+    init_declarator parse_init_declarator(parser& p) {
+        init_declarator id;
+        id.declarator = parse_declarator(p);
+        id.init = parse_optional_initializer(p);
+        return id;
     }
 
     std::vector<init_declarator> parse_init_declarator_list(parser& p) {
         std::vector<init_declarator> declarators;
         bool first = true;
-        while (!p.peek().is(punctuator::semicolon)) {
+        while (!p.peek().is(punctuator::semicolon) && p.has_next_token()) {
             if (!first) {
                 if (p.peek().is(punctuator::comma)) {
                     p.next();
                 } else {
-                    diagnose(diagnostic::id::pp7_expected_token,
-                             p.peek().range.first, ",");
+                    diagnostic::diagnose_fixit(diagnostic::id::pp7_expected_token,
+                                               p.peek().range.first, ",", ",");
                 }
             }
             first = false;
-            init_declarator id;
-            p.push_ruleset(true);
-            id.declarator = p.parse(0);
-            p.pop_ruleset();
-            if (p.peek().is(punctuator::equal)) {
-                p.next();
-                p.push_ruleset(false);
-                id.init = p.parse(ep_comma);
-                p.pop_ruleset();
-            }
+            auto id = parse_init_declarator(p);
+            if (p.recovering()) break;
             declarators.push_back(std::move(id));
         }
         return declarators;
     }
+
+    declarator_info inspect_declarator(const ast& tree, node_id id) {
+        declarator_info info;
+        // down from the outermost derivation, which applies last
+        for (;;) {
+            const auto& n = tree[id];
+            switch (n.kind()) {
+                case node_kind::token: {
+                    auto tok = static_cast<const token_node&>(n).token();
+                    if (tree.token_at(tok).is(token::identifier)) {
+                        info.name = tok;
+                    }
+                    return info;
+                }
+                case node_kind::unary: {
+                    const auto& pointer = static_cast<const unary_node&>(n);
+                    // a qualifier applies to the pointer before it
+                    if (tree.token_at(pointer.token()).is(punctuator::star)) {
+                        info.derivation = id;
+                    }
+                    id = pointer.operand();
+                    break;
+                }
+                case node_kind::paren:
+                    id = static_cast<const paren_node&>(n).operand();
+                    break;
+                case node_kind::call:
+                    info.derivation = id;
+                    id = static_cast<const call_node&>(n).callee();
+                    break;
+                case node_kind::declarator_array:
+                    info.derivation = id;
+                    id = static_cast<const declarator_array_node&>(n).base();
+                    break;
+                default:
+                    return info;
+            }
+        }
+    }
 }
 
-parse::ruleset parse::declarator_ruleset = {
-    {
+namespace {
+    using namespace parse;
+
+    const unary_prefix_rule qualifier{dp_qual};
+    const token_rule identifier;
+    const unary_prefix_rule pointer{dp_pointer};
+    const paren_rule grouping;
+    const abstract_placeholder_rule placeholder;
+    const call_rule function;
+    const declarator_array_rule array;
+
+    constexpr rule_entry<prefix_rule> prefix_rules[] = {
         {
-            +[](const token& tok, parser& p) -> bool {
+            +[](const token& tok) -> bool {
                 if (!tok.is(token::keyword)) return false;
                 return is_type_qualifier(tok.kw);
             },
-            new parse::unary_prefix_rule(dp_qual)
+            &qualifier
         },
         {
-            +[](const token& tok, parser& p) -> bool {
+            +[](const token& tok) -> bool {
                 return tok.is(token::identifier);
             },
-            new parse::token_rule
+            &identifier
         },
         {
-            +[](const token& tok, parser& p) -> bool {
+            +[](const token& tok) -> bool {
                 return tok.is(punctuator::star);
             },
-            new parse::unary_prefix_rule(dp_pointer)
+            &pointer
         },
         {
-            +[](const token& tok, parser& p) -> bool {
+            +[](const token& tok) -> bool {
                 return tok.is(punctuator::paren_left);
             },
-            new parse::paren_rule
+            &grouping
         },
         {
-            +[](const token& tok, parser& p) -> bool {
+            +[](const token& tok) -> bool {
                 return tok.is(punctuator::paren_right) ||
                        tok.is(punctuator::comma) ||
-                       tok.is(punctuator::square_right);
+                       tok.is(punctuator::square_right) ||
+                       tok.is(punctuator::colon) ||
+                       // the derivation of an abstract declarator such
+                       // as int [3]
+                       tok.is(punctuator::square_left);
             },
-            new parse::abstract_placeholder_rule
+            &placeholder
         },
-    },
-    {
+    };
+
+    constexpr rule_entry<infix_rule> infix_rules[] = {
         {
-            +[](const token& tok, parser& p) -> bool {
+            +[](const token& tok) -> bool {
                 return tok.is(punctuator::paren_left);
             },
-            new parse::call_rule
+            &function
         },
         {
-            +[](const token& tok, parser& p) -> bool {
+            +[](const token& tok) -> bool {
                 return tok.is(punctuator::square_left);
             },
-            new parse::declarator_array_rule
+            &array
         },
-    }
-};
+    };
+}
+
+const parse::ruleset parse::declarator_ruleset = { prefix_rules, infix_rules };
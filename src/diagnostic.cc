@@ -1,7 +1,9 @@
 #include "diagnostic.hh"
 #include "platform.hh"
 #include "options.hh"
+#include "context.hh"
 #include "utf8.hh"
+#include "stats.hh"
 
 #include <cassert>
 #include <map>
@@ -10,10 +12,11 @@
 using namespace platform::stream;
 
 namespace diagnostic {
-    static std::map<id, info> diags = {
+    static const std::map<id, info> diags = {
         {
             id::no_input_files,
             {
+                "no_input_files",
                 "no input files",
                 {},
                 category::error
@@ -22,6 +25,7 @@ namespace diagnostic {
         {
             id::cannot_open_file,
             {
+                "cannot_open_file",
                 "cannot open file '%%'",
                 {},
                 category::error
@@ -30,6 +34,7 @@ namespace diagnostic {
         {
             id::input_file_not_dot_c,
             {
+                "input_file_not_dot_c",
                 "input file '%%' does not have a '.c' extension",
                 {},
                 category::warning
@@ -38,6 +43,7 @@ namespace diagnostic {
         {
             id::invalid_option,
             {
+                "invalid_option",
                 "invalid option '%%': %%",
                 {},
                 category::error
@@ -46,6 +52,7 @@ namespace diagnostic {
         {
             id::invalid_size,
             {
+                "invalid_size",
                 "invalid size: %%",
                 {},
                 category::error
@@ -54,14 +61,34 @@ namespace diagnostic {
         {
             id::not_yet_implemented,
             {
+                "not_yet_implemented",
                 "not yet implemented: %%",
                 {},
                 category::error
             }
         },
+        {
+            id::server_error,
+            {
+                "server_error",
+                "compile server: %% (%%)",
+                {},
+                category::error
+            }
+        },
+        {
+            id::pch_unusable,
+            {
+                "pch_unusable",
+                "cannot use precompiled header '%%': %%",
+                {},
+                category::error
+            }
+        },
         {
             id::pp1_invalid_utf8,
             {
+                "pp1_invalid_utf8",
                 "invalid UTF-8",
                 "[5.1.1.2]/1.1",
                 category::error
@@ -70,6 +97,7 @@ namespace diagnostic {
         {
             id::pp2_missing_newline,
             {
+                "pp2_missing_newline",
                 "missing newline at end of file",
                 "[5.1.1.2]/1.2",
                 category::error
@@ -78,6 +106,7 @@ namespace diagnostic {
         {
             id::pp3_unmatched_quote,
             {
+                "pp3_unmatched_quote",
                 "%% quote did match any preprocessing token",
                 "[6.4]/3",
                 category::undefined
@@ -86,6 +115,7 @@ namespace diagnostic {
         {
             id::pp3_ambiguous_lex,
             {
+                "pp3_ambiguous_lex",
                 "interpretation of character sequence as "
                 "a preprocessing token is ambiguous",
                 "[6.4]",
@@ -95,6 +125,7 @@ namespace diagnostic {
         {
             id::pp3_incomplete_comment,
             {
+                "pp3_incomplete_comment",
                 "incomplete multiline comment",
                 "[5.1.1.2]/1.3",
                 category::error
@@ -103,6 +134,7 @@ namespace diagnostic {
         {
             id::pp3_undef_char_in_hdr_name,
             {
+                "pp3_undef_char_in_hdr_name",
                 "use of %% in a header name",
                 "[6.4.7]/3",
                 category::undefined
@@ -111,6 +143,7 @@ namespace diagnostic {
         {
             id::pp4_error_directive,
             {
+                "pp4_error_directive",
                 "#error directive: %%",
                 "[6.10.5]",
                 category::error
@@ -119,6 +152,7 @@ namespace diagnostic {
         {
             id::pp4_unknown_pragma,
             {
+                "pp4_unknown_pragma",
                 "unrecognized #pragma directive",
                 "[6.10.6]",
                 category::warning
@@ -127,6 +161,7 @@ namespace diagnostic {
         {
             id::pp4_expected_macro_name,
             {
+                "pp4_expected_macro_name",
                 "expected macro name",
                 "[6.10]",
                 category::error
@@ -135,6 +170,7 @@ namespace diagnostic {
         {
             id::pp4_extra_after_directive,
             {
+                "pp4_extra_after_directive",
                 "extra tokens after #%% directive",
                 "[6.10]",
                 category::error
@@ -143,6 +179,7 @@ namespace diagnostic {
         {
             id::pp4_macro_redef,
             {
+                "pp4_macro_redef",
                 "macro '%%' redefined differently",
                 "[6.10.3]/2",
                 category::error
@@ -151,6 +188,7 @@ namespace diagnostic {
         {
             id::pp4_duplicate_macro_param,
             {
+                "pp4_duplicate_macro_param",
                 "duplicate macro parameter name '%%'",
                 "[6.10.3]/6",
                 category::error
@@ -159,6 +197,7 @@ namespace diagnostic {
         {
             id::pp4_unexpected_macro_param,
             {
+                "pp4_unexpected_macro_param",
                 "unexpected token in function-like macro parameter list",
                 "[6.10.3]",
                 category::error
@@ -167,6 +206,7 @@ namespace diagnostic {
         {
             id::pp4_missing_macro_space,
             {
+                "pp4_missing_macro_space",
                 "missing whitespace before replacement list",
                 "[6.10.3]/3",
                 category::error
@@ -175,6 +215,7 @@ namespace diagnostic {
         {
             id::pp4_missing_macro_right_paren,
             {
+                "pp4_missing_macro_right_paren",
                 "expected right parenthesis to terminate function-like "
                 "macro parameter list",
                 "[6.10.3]",
@@ -184,6 +225,7 @@ namespace diagnostic {
         {
             id::pp4_missing_macro_args_end,
             {
+                "pp4_missing_macro_args_end",
                 "expected right parenthesis to terminate function-like "
                 "macro invocation",
                 "[6.10.3]",
@@ -193,6 +235,7 @@ namespace diagnostic {
         {
             id::pp4_wrong_arity_macro_args,
             {
+                "pp4_wrong_arity_macro_args",
                 "function-like macro '%%' requires %% argument%%, but "
                 "%% %% provided",
                 "[6.10.3]",
@@ -202,6 +245,7 @@ namespace diagnostic {
         {
             id::pp4_cannot_use_hash_hash_here,
             {
+                "pp4_cannot_use_hash_hash_here",
                 "## cannot be used here",
                 "[6.10.3.3]",
                 category::error
@@ -210,6 +254,7 @@ namespace diagnostic {
         {
             id::pp4_stringize_invalid_token,
             {
+                "pp4_stringize_invalid_token",
                 "use of # operator did not produce a valid "
                 "character string literal",
                 "[6.10.3.2]/2",
@@ -219,6 +264,7 @@ namespace diagnostic {
         {
             id::pp4_stringize_no_parameter,
             {
+                "pp4_stringize_no_parameter",
                 "# must be followed a parameter name",
                 "[6.10.3.2]/2",
                 category::error
@@ -227,6 +273,7 @@ namespace diagnostic {
         {
             id::pp4_concatenate_invalid_token,
             {
+                "pp4_concatenate_invalid_token",
                 "use of ## operator did not produce a valid "
                 "preprocessing token",
                 "[6.10.3.3]/3",
@@ -236,6 +283,7 @@ namespace diagnostic {
         {
             id::pp4_cannot_use_predef_macro_here,
             {
+                "pp4_cannot_use_predef_macro_here",
                 "cannot use predefined macro name '%%' here",
                 "[6.10.8]/2",
                 category::error
@@ -244,6 +292,7 @@ namespace diagnostic {
         {
             id::pp4_predef_expand_failure,
             {
+                "pp4_predef_expand_failure",
                 "failed to expand dynamic predefined macro '%%'",
                 {},
                 category::error
@@ -252,6 +301,7 @@ namespace diagnostic {
         {
             id::pp4_mismatched_cond_directive,
             {
+                "pp4_mismatched_cond_directive",
                 "mismatched #%% directive",
                 "[6.10.1]",
                 category::error
@@ -260,6 +310,7 @@ namespace diagnostic {
         {
             id::pp4_cannot_use_va_args_here,
             {
+                "pp4_cannot_use_va_args_here",
                 "cannot use __VA_ARGS__ here",
                 "[6.10.3]/5",
                 category::error
@@ -268,6 +319,7 @@ namespace diagnostic {
         {
             id::pp4_non_directive_ignored,
             {
+                "pp4_non_directive_ignored",
                 "non-directive ignored",
                 "[6.10]",
                 category::warning
@@ -276,14 +328,25 @@ namespace diagnostic {
         {
             id::pp4_too_many_nested_includes,
             {
+                "pp4_too_many_nested_includes",
                 "too many nested #include directives",
                 {},
                 category::error
             }
         },
+        {
+            id::pp4_invalid_condition,
+            {
+                "pp4_invalid_condition",
+                "invalid #%% expression: %%",
+                "[6.10.1]",
+                category::error
+            }
+        },
         {
             id::pp6_cannot_concatenate_wide_utf8,
             {
+                "pp6_cannot_concatenate_wide_utf8",
                 "cannot concatenate UTF-8 and wide string literals",
                 "[6.4.5]/2",
                 category::error
@@ -292,6 +355,7 @@ namespace diagnostic {
         {
             id::pp6_cannot_concatenate_diff_wide,
             {
+                "pp6_cannot_concatenate_diff_wide",
                 "cannot concatenate wide string literals of different "
                 "character sizes",
                 "[6.4.5]/5",
@@ -301,6 +365,7 @@ namespace diagnostic {
         {
             id::pp7_expected_end_of_list,
             {
+                "pp7_expected_end_of_list",
                 "expected end of list",
                 {},
                 category::error
@@ -309,6 +374,7 @@ namespace diagnostic {
         {
             id::pp7_incomplete_list,
             {
+                "pp7_incomplete_list",
                 "unexpected end of list",
                 {},
                 category::error
@@ -317,6 +383,7 @@ namespace diagnostic {
         {
             id::pp7_expected_end_of_array_declarator,
             {
+                "pp7_expected_end_of_array_declarator",
                 "expected ] to end array declarator",
                 {},
                 category::error
@@ -325,6 +392,7 @@ namespace diagnostic {
         {
             id::pp7_expected_ident_or_body,
             {
+                "pp7_expected_ident_or_body",
                 "expected identifier or body",
                 {},
                 category::error
@@ -333,6 +401,7 @@ namespace diagnostic {
         {
             id::pp7_expected_semicolon,
             {
+                "pp7_expected_semicolon",
                 "expected semicolon",
                 {},
                 category::error
@@ -341,6 +410,7 @@ namespace diagnostic {
         {
             id::pp7_invalid_decl_spec_type,
             {
+                "pp7_invalid_decl_spec_type",
                 "invalid combination of type specifiers",
                 {},
                 category::error
@@ -349,14 +419,34 @@ namespace diagnostic {
         {
             id::pp7_expected_token,
             {
+                "pp7_expected_token",
                 "expected token %%",
                 {},
                 category::error
             }
         },
+        {
+            id::pp7_syntax_error,
+            {
+                "pp7_syntax_error",
+                "%%",
+                {},
+                category::error
+            }
+        },
+        {
+            id::too_many_errors,
+            {
+                "too_many_errors",
+                "too many errors emitted, stopping now",
+                {},
+                category::error
+            }
+        },
         {
             id::translation_limit_exceeded,
             {
+                "translation_limit_exceeded",
                 "minimum translation limit exceeded: %% %%",
                 "[5.2.4.1]",
                 category::warning
@@ -365,6 +455,7 @@ namespace diagnostic {
         {
             id::pp_token_is_not_a_valid_token,
             {
+                "pp_token_is_not_a_valid_token",
                 "preprocessing token could not be converted into a token",
                 "[6.4]/2",
                 category::error
@@ -373,6 +464,7 @@ namespace diagnostic {
         {
             id::aux_previous_def,
             {
+                "aux_previous_def",
                 "previous definition is here",
                 {},
                 category::auxiliary
@@ -381,6 +473,7 @@ namespace diagnostic {
         {
             id::aux_previous_use,
             {
+                "aux_previous_use",
                 "previous use is here",
                 {},
                 category::auxiliary
@@ -389,6 +482,7 @@ namespace diagnostic {
         {
             id::aux_expanded_here,
             {
+                "aux_expanded_here",
                 "expanded from here",
                 {},
                 category::auxiliary
@@ -397,6 +491,7 @@ namespace diagnostic {
         {
             id::aux_included_here,
             {
+                "aux_included_here",
                 "in file included here",
                 {},
                 category::auxiliary
@@ -405,6 +500,7 @@ namespace diagnostic {
         {
             id::aux_macro_defined_here,
             {
+                "aux_macro_defined_here",
                 "macro '%%' defined here",
                 {},
                 category::auxiliary
@@ -413,7 +509,16 @@ namespace diagnostic {
     };
 
     const info& find(id diag) {
-        return diags[diag];
+        auto it = diags.find(diag);
+        assert(it != diags.end());
+        return it->second;
+    }
+
+    std::optional<id> find_by_name(std::string_view name) {
+        for (const auto& pair : diags) {
+            if (pair.second.name == name) return pair.first;
+        }
+        return {};
     }
 
     std::string format_diagnostic_message(const std::string& pattern,
@@ -435,6 +540,12 @@ namespace diagnostic {
         return result;
     }
 
+    // with -E, stdout carries the preprocessed text
+    FILE* stream() {
+        if (current_context().options.preprocess_only) return errors();
+        return output();
+    }
+
     std::pair<std::size_t, std::size_t> compute_line_col(location loc) {
         std::size_t line = 0, col = 0;
         for (std::size_t i = 0; i < loc.offset(); ++i) {
@@ -448,10 +559,10 @@ namespace diagnostic {
     }
 
     void emit_file_line_col(location loc) {
-        set_color(stdout, color::white);
+        set_color(stream(), color::white);
         const auto line_col = compute_line_col(loc);
-        std::print("{}:{}:{}: ", loc.buffer().name(), line_col.first + 1, line_col.second + 1);
-        reset_attributes(stdout);
+        std::print(stream(), "{}:{}:{}: ", loc.buffer().name(), line_col.first + 1, line_col.second + 1);
+        reset_attributes(stream());
     }
 
     std::string to_string(category cat) {
@@ -463,6 +574,84 @@ namespace diagnostic {
         }
     }
 
+    std::optional<category> find_category(std::string_view name) {
+        for (auto cat : { category::error, category::warning,
+                          category::undefined }) {
+            if (to_string(cat) == name) return cat;
+        }
+        return {};
+    }
+
+    std::size_t error_count() {
+        return current_context().error_count;
+    }
+
+    // whether the file name is the path dir or lies under it, matching
+    // whole components so that /usr/include does not take in
+    // /usr/include2
+    static bool is_under(std::string_view name, std::string_view dir) {
+        if (!name.starts_with(dir)) return false;
+        if (dir.empty() || name.size() == dir.size()) return true;
+        auto is_separator = [](char c) { return c == '/' || c == '\\'; };
+        return is_separator(dir.back()) || is_separator(name[dir.size()]);
+    }
+
+    static bool is_in_system_header(const location& loc) {
+        const auto& prefixes =
+            current_context().options.diagnostics.system_header_prefixes;
+        auto name = loc.find_spelling_loc().buffer().name();
+        for (const auto& prefix : prefixes) {
+            if (is_under(name, prefix)) return true;
+        }
+        return false;
+    }
+
+    std::optional<category> map_diagnostic(id diag, const info& info,
+                                           const std::optional<location>& loc) {
+        auto& context = current_context();
+        ++context.diagnostics_requested;
+        const auto& controls = context.options.diagnostics;
+        // auxiliary diagnostics belong to the preceding diagnostic
+        // and share its fate
+        if (info.category == category::auxiliary) {
+            if (context.last_suppressed) return {};
+            return info.category;
+        }
+        context.last_suppressed = false;
+        bool as_error = info.category == category::error;
+        if (!as_error) {
+            bool enabled = !controls.disabled_categories.count(info.category);
+            if (auto it = controls.enabled.find(diag);
+                it != controls.enabled.end()) {
+                enabled = it->second;
+            }
+            if (enabled && loc && is_in_system_header(*loc)) enabled = false;
+            if (!enabled) {
+                context.last_suppressed = true;
+                return {};
+            }
+            as_error = controls.error_categories.count(info.category);
+            if (auto it = controls.as_error.find(diag);
+                it != controls.as_error.end()) {
+                as_error = it->second;
+            }
+            if (!as_error) return info.category;
+        }
+        const auto limit = context.options.error_limit;
+        // contexts sharing a limit claim their place under it at once, so
+        // that two threads cannot both take the last one
+        const auto errors = context.claimed_errors ?
+            context.claimed_errors->fetch_add(1) : context.error_count;
+        if (limit && errors >= limit) {
+            // the previous error was the last one we were allowed to emit,
+            // so give up on the rest of this translation unit
+            const auto& stop = find(id::too_many_errors);
+            emit_diagnostic(stop, stop.category, {}, stop.pattern);
+            throw error_limit_reached{};
+        }
+        return category::error;
+    }
+
     color get_category_color(category cat) {
         switch (cat) {
             case category::error: return color::red;
@@ -473,12 +662,12 @@ namespace diagnostic {
     }
 
     void emit_category_message(category cat, const std::string& msg) {
-        set_color(stdout, get_category_color(cat));
-        set_style(stdout, style::bold);
-        std::print("{}: ", to_string(cat));
-        set_color(stdout, color::white);
-        std::print("{}", msg);
-        reset_attributes(stdout);
+        set_color(stream(), get_category_color(cat));
+        set_style(stream(), style::bold);
+        std::print(stream(), "{}: ", to_string(cat));
+        set_color(stream(), color::white);
+        std::print(stream(), "{}", msg);
+        reset_attributes(stream());
     }
 
     std::string generate_caret_indent(std::size_t col, std::string_view line) {
@@ -506,46 +695,49 @@ namespace diagnostic {
         return data.substr(line_start, j - line_start);
     }
 
-    void emit_snippet_caret(location loc) {
+    void emit_snippet_caret(location loc, std::string_view fixit) {
         auto line_col = compute_line_col(loc);
         auto line = compute_nth_line(loc.buffer().data(), line_col.first);
-        std::println("{}", line);
-        set_color(stdout, color::green);
-        std::print("{}^", generate_caret_indent(line_col.second, line));
-        reset_attributes(stdout);
-        std::println("");
+        std::println(stream(), "{}", line);
+        auto indent = generate_caret_indent(line_col.second, line);
+        set_color(stream(), color::green);
+        std::print(stream(), "{}^", indent);
+        if (!fixit.empty()) std::print(stream(), "\n{}{}", indent, fixit);
+        reset_attributes(stream());
+        std::println(stream(), "");
     }
 
     void update_exit_code(category cat) {
-        switch (cat) {
-            case category::error:
-                options::state.exit_code = 1;
-            default:
-                break;
-        }
+        if (cat != category::error) return;
+        auto& context = current_context();
+        ++context.error_count;
+        context.exit_code = 1;
     }
 
-    void emit_diagnostic(const info& info,
+    void emit_diagnostic(const info& info, category cat,
                          std::optional<location> loc,
-                         const std::string& msg) {
+                         const std::string& msg, std::string_view fixit) {
         auto original_loc = loc;
-        update_exit_code(info.category);
+        stats::count(stats::counter::diagnostics_emitted);
+        update_exit_code(cat);
         if (loc) loc = loc->find_spelling_loc();
         if (loc) emit_file_line_col(*loc);
-        emit_category_message(info.category, msg);
+        emit_category_message(cat, msg);
         if (!info.citation.empty()) {
-            set_color(stdout, color::white);
-            std::print(" {}", info.citation);
-            reset_attributes(stdout);
+            set_color(stream(), color::white);
+            std::print(stream(), " {}", info.citation);
+            reset_attributes(stream());
         }
-        std::println("");
-        if (loc) emit_snippet_caret(*loc);
+        std::println(stream(), "");
+        if (loc) emit_snippet_caret(*loc, fixit);
 
-        if (loc && loc->buffer().included_at()) {
-            diagnose(id::aux_included_here, *loc->buffer().included_at());
-        }
-        if (original_loc && original_loc->expanded_from) {
-            diagnose(id::aux_expanded_here, *original_loc->expanded_from);
+        if (original_loc) {
+            if (auto at = original_loc->included_at()) {
+                diagnose(id::aux_included_here, *at);
+            }
+            if (auto site = original_loc->expanded_from()) {
+                diagnose(id::aux_expanded_here, *site);
+            }
         }
     }
 }
@@ -0,0 +1,172 @@
+#include "header_cache.hh"
+#include "pp.hh"
+#include "context.hh"
+#include "stats.hh"
+
+#include <fstream>
+#include <sstream>
+#include <system_error>
+
+pp::header_cache pp::headers;
+
+namespace pp {
+    std::filesystem::path header_key(const std::string& path) {
+        std::error_code ec;
+        auto key = std::filesystem::weakly_canonical(path, ec);
+        if (ec) key = std::filesystem::absolute(path);
+        return key;
+    }
+
+    header_ptr header_cache::load(const std::string& path,
+                                  const std::filesystem::path& key,
+                                  location included_at) {
+        std::error_code ec;
+        auto mtime = std::filesystem::last_write_time(key, ec);
+        auto size = ec ? 0 : std::filesystem::file_size(key, ec);
+        if (!ec) {
+            std::lock_guard lock{mutex};
+            auto it = entries.find(key);
+            if (it != entries.end() && it->second->mtime == mtime &&
+                it->second->size == size) {
+                stats::count(stats::counter::header_cache_hits);
+                return it->second;
+            }
+        }
+
+        std::ifstream file{path};
+        if (!file.good()) return nullptr;
+        std::stringstream ss;
+        ss << file.rdbuf();
+        auto data = ss.str();
+        stats::count(stats::counter::bytes_read, data.size());
+
+        auto& context = current_context();
+        const auto diagnostics_before = context.diagnostics_requested;
+        auto raw = std::make_unique<raw_buffer>(path, std::move(data));
+        auto raw_ptr = raw.get();
+        // diagnostics issued while lexing refer to the raw buffer itself
+        raw_ptr->mark_included_at(included_at);
+        auto post_p1 = perform_phase_one(std::move(raw));
+        auto post_p2 = perform_phase_two(std::move(post_p1));
+        auto header = std::make_shared<cached_header>();
+        header->tokens = perform_phase_three(*post_p2);
+        header->buf = std::move(post_p2);
+        header->guard = detect_include_guard(header->tokens);
+        header->conditionals = map_conditionals(header->tokens);
+        header->mtime = mtime;
+        header->size = size;
+        if (ec || context.diagnostics_requested != diagnostics_before) {
+            return header;
+        }
+        // later inclusions get their site from an included_buffer, and
+        // this one must not outlive the unit it points into
+        raw_ptr->mark_included_at({});
+        std::lock_guard lock{mutex};
+        entries[key] = header;
+        return header;
+    }
+
+    void header_cache::clear() {
+        std::lock_guard lock{mutex};
+        entries.clear();
+    }
+
+    std::optional<std::string> detect_include_guard(
+        const std::vector<token>& tokens) {
+        std::optional<std::string> guard;
+        std::size_t depth = 0;
+        bool closed = false;
+        std::size_t i = 0;
+        while (i < tokens.size()) {
+            // each iteration looks at one line
+            while (i < tokens.size() && tokens[i].is(token::space)) ++i;
+            if (i == tokens.size()) break;
+            if (tokens[i].is(token::newline)) {
+                ++i;
+                continue;
+            }
+            // anything but whitespace before or after the guarded region
+            if (closed) return {};
+            std::string_view directive;
+            std::size_t name_index = tokens.size();
+            if (tokens[i].is(punctuator::hash)) {
+                std::size_t j = i + 1;
+                while (j < tokens.size() && tokens[j].is(token::space)) ++j;
+                if (j < tokens.size() && tokens[j].is(token::identifier)) {
+                    directive = tokens[j].spelling;
+                    name_index = j + 1;
+                }
+            }
+            if (!guard) {
+                if (directive != "ifndef") return {};
+                std::size_t j = name_index;
+                while (j < tokens.size() && tokens[j].is(token::space)) ++j;
+                if (j == tokens.size() || !tokens[j].is(token::identifier)) {
+                    return {};
+                }
+                guard = std::string(tokens[j].spelling);
+                depth = 1;
+            } else if (directive == "if" || directive == "ifdef" ||
+                       directive == "ifndef") {
+                ++depth;
+            } else if (directive == "endif") {
+                closed = --depth == 0;
+            } else if (depth == 1 && (directive == "else" ||
+                                      directive == "elif")) {
+                // the alternative is included when the guard is defined
+                return {};
+            }
+            while (i < tokens.size() && !tokens[i].is(token::newline)) ++i;
+        }
+        if (!closed) return {};
+        return guard;
+    }
+
+    conditional_map map_conditionals(const std::vector<token>& tokens) {
+        conditional_map result;
+        // the # of the latest directive of each open conditional
+        std::vector<std::size_t> open;
+        bool at_line_start = true;
+        for (std::size_t i = 0; i < tokens.size(); ++i) {
+            if (tokens[i].is(token::newline)) {
+                at_line_start = true;
+                continue;
+            }
+            if (tokens[i].is(token::space)) continue;
+            bool is_directive = at_line_start &&
+                                tokens[i].is(punctuator::hash);
+            at_line_start = false;
+            if (!is_directive) continue;
+            std::size_t j = i + 1;
+            while (j < tokens.size() && tokens[j].is(token::space)) ++j;
+            if (j == tokens.size() || !tokens[j].is(token::identifier)) {
+                continue;
+            }
+            auto name = tokens[j].spelling;
+            if (name == "if" || name == "ifdef" || name == "ifndef") {
+                open.push_back(i);
+            } else if (open.empty()) {
+                continue;
+            } else if (name == "elif" || name == "else" || name == "endif") {
+                result[tokens[open.back()].spelling.data()] =
+                    i - open.back();
+                if (name == "endif") open.pop_back();
+                else open.back() = i;
+            }
+        }
+        return result;
+    }
+
+    std::vector<token> rebase_tokens(const cached_header& header,
+                                     const included_buffer& inclusion) {
+        std::vector<token> result = header.tokens;
+        for (auto& tok : result) {
+            location first{inclusion, tok.range.first.offset()};
+            location second{inclusion, tok.range.second.offset()};
+            first.set_expansion(tok.range.first.expansion());
+            second.set_expansion(tok.range.second.expansion());
+            tok.range = { first, second };
+        }
+        return result;
+    }
+}
@@ -0,0 +1,90 @@
+#include "include_resolver.hh"
+#include "context.hh"
+#include "stats.hh"
+
+#include <filesystem>
+#include <system_error>
+
+pp::include_resolver pp::includes;
+
+namespace pp {
+    std::optional<std::string> include_resolver::resolve(
+        std::string_view name, bool angled, const std::string& includer_dir) {
+        if (std::filesystem::path(name).is_absolute()) {
+            std::error_code ec;
+            if (std::filesystem::is_regular_file(name, ec)) {
+                return std::string(name);
+            }
+            return {};
+        }
+        if (!angled) {
+            if (auto path = lookup(includer_dir, name, false)) return path;
+        }
+        const auto& options = current_context().options;
+        for (const auto& dir : options.include_dirs) {
+            if (auto path = lookup(dir, name, true)) return path;
+        }
+        for (const auto& dir : options.system_include_dirs) {
+            if (auto path = lookup(dir, name, true)) return path;
+        }
+        return {};
+    }
+
+    void include_resolver::clear() {
+        std::lock_guard lock{mutex};
+        lookups.clear();
+        listings.clear();
+    }
+
+    std::optional<std::string> include_resolver::lookup(
+        const std::string& dir, std::string_view name, bool use_listing) {
+        std::pair<std::string, std::string> key{dir, name};
+        {
+            std::lock_guard lock{mutex};
+            auto it = lookups.find(key);
+            if (it != lookups.end()) {
+                stats::count(stats::counter::include_lookups_cached);
+                return it->second;
+            }
+        }
+        // the file system is only asked once the directory is known to
+        // have something by the name's first component, which a listing
+        // cannot say of . or ..
+        std::optional<std::string> result;
+        auto first = name.substr(0, name.find('/'));
+        bool listed = first != "." && first != "..";
+        auto entries = use_listing && listed ? listing_of(dir) : nullptr;
+        if (!entries || entries->count(first)) {
+            auto path = dir.empty() ? std::filesystem::path(name)
+                                    : std::filesystem::path(dir) / name;
+            std::error_code ec;
+            stats::count(stats::counter::include_lookups);
+            if (std::filesystem::is_regular_file(path, ec)) {
+                result = path.string();
+            }
+        }
+        std::lock_guard lock{mutex};
+        lookups.emplace(std::move(key), result);
+        return result;
+    }
+
+    std::shared_ptr<const include_resolver::listing>
+    include_resolver::listing_of(const std::string& dir) {
+        {
+            std::lock_guard lock{mutex};
+            auto it = listings.find(dir);
+            if (it != listings.end()) return it->second;
+        }
+        auto entries = std::make_shared<listing>();
+        std::error_code ec;
+        std::filesystem::directory_iterator it{dir.empty() ? "." : dir, ec};
+        for (; !ec && it != std::filesystem::directory_iterator{};
+             it.increment(ec)) {
+            entries->insert(it->path().filename().string());
+        }
+        std::shared_ptr<const listing> result;
+        if (!ec) result = std::move(entries);
+        std::lock_guard lock{mutex};
+        return listings.emplace(dir, result).first->second;
+    }
+}
@@ -1,47 +1,106 @@
 #include "keyword.hh"
 
-std::map<std::string, keyword> keyword_table = {
-    { "auto", kw_auto },
-    { "break", kw_break },
-    { "case", kw_case },
-    { "char", kw_char },
-    { "const", kw_const },
-    { "continue", kw_continue },
-    { "default", kw_default },
-    { "do", kw_do },
-    { "double", kw_double },
-    { "else", kw_else },
-    { "enum", kw_enum },
-    { "extern", kw_extern },
-    { "float", kw_float },
-    { "for", kw_for },
-    { "goto", kw_goto },
-    { "if", kw_if },
-    { "inline", kw_inline },
-    { "int", kw_int },
-    { "long", kw_long },
-    { "register", kw_register },
-    { "restrict", kw_restrict },
-    { "return", kw_return },
-    { "short", kw_short },
-    { "sizeof", kw_sizeof },
-    { "static", kw_static },
-    { "struct", kw_struct },
-    { "switch", kw_switch },
-    { "typedef", kw_typedef },
-    { "union", kw_union },
-    { "unsigned", kw_unsigned },
-    { "void", kw_void },
-    { "volatile", kw_volatile },
-    { "while", kw_while },
-    { "_Alignas", kw_Alignas },
-    { "_Alignof", kw_Alignof },
-    { "_Atomic", kw_Atomic },
-    { "_Bool", kw_Bool },
-    { "_Complex", kw_Complex },
-    { "_Generic", kw_Generic },
-    { "_Imaginary", kw_Imaginary },
-    { "_Noreturn", kw_Noreturn },
-    { "_Static_assert", kw_Static_assert },
-    { "_Thread_local", kw_Thread_local },
-};
+#include <algorithm>
+#include <utility>
+
+namespace {
+    using entry = std::pair<std::string_view, keyword>;
+
+    // sorted by spelling so that lookups can use a binary search
+    constexpr entry keyword_table[] = {
+        { "_Alignas", kw_Alignas },
+        { "_Alignof", kw_Alignof },
+        { "_Atomic", kw_Atomic },
+        { "_Bool", kw_Bool },
+        { "_Complex", kw_Complex },
+        { "_Generic", kw_Generic },
+        { "_Imaginary", kw_Imaginary },
+        { "_Noreturn", kw_Noreturn },
+        { "_Static_assert", kw_Static_assert },
+        { "_Thread_local", kw_Thread_local },
+        { "auto", kw_auto },
+        { "break", kw_break },
+        { "case", kw_case },
+        { "char", kw_char },
+        { "const", kw_const },
+        { "continue", kw_continue },
+        { "default", kw_default },
+        { "do", kw_do },
+        { "double", kw_double },
+        { "else", kw_else },
+        { "enum", kw_enum },
+        { "extern", kw_extern },
+        { "float", kw_float },
+        { "for", kw_for },
+        { "goto", kw_goto },
+        { "if", kw_if },
+        { "inline", kw_inline },
+        { "int", kw_int },
+        { "long", kw_long },
+        { "register", kw_register },
+        { "restrict", kw_restrict },
+        { "return", kw_return },
+        { "short", kw_short },
+        { "sizeof", kw_sizeof },
+        { "static", kw_static },
+        { "struct", kw_struct },
+        { "switch", kw_switch },
+        { "typedef", kw_typedef },
+        { "union", kw_union },
+        { "unsigned", kw_unsigned },
+        { "void", kw_void },
+        { "volatile", kw_volatile },
+        { "while", kw_while },
+    };
+
+    static_assert(std::ranges::is_sorted(keyword_table, {}, &entry::first));
+}
+
+std::optional<keyword> find_keyword(std::string_view spelling) {
+    auto it = std::ranges::lower_bound(keyword_table, spelling, {}, &entry::first);
+    if (it == std::end(keyword_table) || it->first != spelling) return {};
+    return it->second;
+}
+
+bool is_specifier_qualifier(keyword kw) {
+    switch (kw) {
+        case kw_void:
+        case kw_char:
+        case kw_short:
+        case kw_int:
+        case kw_long:
+        case kw_float:
+        case kw_double:
+        case kw_signed:
+        case kw_unsigned:
+        case kw_Bool:
+        case kw_Complex:
+        case kw_Atomic:
+        case kw_struct:
+        case kw_union:
+        case kw_enum:
+        case kw_const:
+        case kw_restrict:
+        case kw_volatile:
+        case kw_Alignas:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool is_declaration_specifier(keyword kw) {
+    switch (kw) {
+        case kw_typedef:
+        case kw_extern:
+        case kw_static:
+        case kw_Thread_local:
+        case kw_auto:
+        case kw_register:
+        case kw_inline:
+        case kw_Noreturn:
+            return true;
+        default:
+            return is_specifier_qualifier(kw);
+    }
+}
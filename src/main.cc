@@ -1,59 +1,149 @@
 #include "options.hh"
+#include "context.hh"
 #include "diagnostic.hh"
 #include "buffer.hh"
 #include "pp.hh"
+#include "pch.hh"
+#include "pp_output.hh"
+#include "include_resolver.hh"
 #include "test.hh"
 #include "util.hh"
 #include "platform.hh"
 #include "parser.hh"
 #include "declarator.hh"
 #include "decl_spec.hh"
+#include "parse_decl.hh"
+#include "parse_parallel.hh"
+#include "stats.hh"
+#include "trace.hh"
+#include "thread_pool.hh"
+#include "server.hh"
 
 #include <iostream>
 #include <cstdlib>
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <future>
 #include <print>
 
 using diagnostic::diagnose;
 using namespace platform::stream;
 
+static void run(char** argv);
+static int handle_request(const std::vector<std::string>& args);
 static void show_help();
 static void show_version();
 static void process_input_files();
+static int run_translation_unit(const options::config& config,
+                                const std::string& filename,
+                                std::shared_ptr<const pp::pch> prefix);
+static void process_translation_unit(const std::string& filename,
+                                     std::shared_ptr<const pp::pch> prefix);
+static void write_dependencies(const std::string& filename,
+                               const pp::phase_four_manager& p4m);
+static void benchmark_parse(const std::string& filename,
+                            const std::vector<token>& tokens);
 static void debug_parse();
 static void debug_scratch();
 
 int main(int argc, char** argv) {
+    // context for everything outside of a translation unit, starting with
+    // diagnostics about the command line itself
+    compilation_context context{{}};
     options::parse(argc, argv);
-    switch (options::state.mode) {
-        case options::run_mode::show_version:
-            show_version();
-            break;
-        case options::run_mode::show_help:
-            show_help();
-            break;
-        case options::run_mode::run_tests:
-            test::run_tests();
-            break;
-        case options::run_mode::normal:
-            process_input_files();
-            break;
-        case options::run_mode::option_parsing_error:
-            break;
-        case options::run_mode::dump_config:
-            options::dump();
-            break;
-        case options::run_mode::debug_parse_declarator:
-        case options::run_mode::debug_parse_expr:
-            debug_parse();
-            break;
-        case options::run_mode::debug_scratch:
-            debug_scratch();
-            break;
-    }
-    return options::state.exit_code;
+    context.options = options::state;
+    run(argv);
+    return context.exit_code;
+}
+
+void run(char** argv) {
+    const auto& state = current_context().options;
+    stats::enable(state.time_report != options::report_format::none);
+    try {
+        switch (state.mode) {
+            case options::run_mode::show_version:
+                show_version();
+                break;
+            case options::run_mode::show_help:
+                show_help();
+                break;
+            case options::run_mode::run_tests:
+                test::run_tests();
+                break;
+            case options::run_mode::normal:
+                process_input_files();
+                break;
+            case options::run_mode::option_parsing_error:
+                break;
+            case options::run_mode::dump_config:
+                options::dump(state);
+                break;
+            case options::run_mode::debug_parse_declarator:
+            case options::run_mode::debug_parse_expr:
+                debug_parse();
+                break;
+            case options::run_mode::debug_scratch:
+                debug_scratch();
+                break;
+            case options::run_mode::server:
+                server::serve(state.socket_path, handle_request);
+                break;
+            case options::run_mode::client: {
+                // everything but --connect goes to the server
+                std::vector<std::string> args;
+                for (auto arg = argv + 1; *arg; ++arg) {
+                    std::string_view a = *arg;
+                    if (a == "-connect") {
+                        // the single dash spelling takes the socket as
+                        // the next argument
+                        if (arg[1]) ++arg;
+                    } else if (!a.starts_with("--connect") &&
+                               !a.starts_with("-fconnect")) {
+                        args.emplace_back(a);
+                    }
+                }
+                auto exit_code = server::request(state.socket_path, args);
+                if (exit_code) current_context().exit_code = *exit_code;
+                break;
+            }
+        }
+    } catch (const diagnostic::error_limit_reached&) {
+        // the debug modes process a single input
+    }
+    // a client's work happens in the server, which reports it
+    if (state.mode == options::run_mode::client) return;
+    if (state.time_report != options::report_format::none) {
+        bool json = state.time_report == options::report_format::json;
+        stats::report(errors(), json);
+    }
+    if (trace::enabled()) trace::write(state.time_trace_file);
+}
+
+// runs a command line sent to the server; caches such as the header cache
+// are process-wide and carry over from earlier requests
+int handle_request(const std::vector<std::string>& args) {
+    // but what a report or trace covers is this request alone
+    stats::reset();
+    trace::reset();
+    // headers may have been created or deleted since the last request,
+    // which would make remembered lookups wrong; header contents are
+    // checked by the header cache itself
+    pp::includes.clear();
+    compilation_context context{{}};
+    context.options = options::parse(args);
+    auto mode = context.options.mode;
+    if (mode == options::run_mode::server ||
+        mode == options::run_mode::client) {
+        auto opt = mode == options::run_mode::server ? "--server" : "--connect";
+        diagnose(diagnostic::id::invalid_option, {},
+                 opt, "not allowed in a request");
+    } else {
+        run(nullptr);
+    }
+    return context.exit_code;
 }
 
 void show_help() {
@@ -67,57 +157,253 @@ void show_version() {
 static void debug_dump_tokens(const std::vector<token>& tokens) {
     bool first = false;
     for (const auto tok : tokens) {
+        if (tok.is(token::end_of_input)) break;
         if (!first) {
-            set_color(stdout, color::blue);
-            std::print(".");
-            reset_attributes(stdout);
+            set_color(output(), color::blue);
+            std::print(output(), ".");
+            reset_attributes(output());
         }
         first = false;
 
-        std::print("{}", tok.spelling);
+        std::print(output(), "{}", tok.spelling);
     }
 }
 
 void process_input_files() {
-    if (options::state.input_filenames.empty()) {
+    const auto& state = current_context().options;
+    if (state.input_filenames.empty()) {
         diagnose(diagnostic::id::no_input_files, {});
     }
-    for (const auto& filename : options::state.input_filenames) {
-        if (!filename.ends_with(".c")) {
-            diagnose(diagnostic::id::input_file_not_dot_c, {}, filename);
+    const auto& filenames = state.input_filenames;
+    if (!state.emit_pch_file.empty() && filenames.size() != 1) {
+        diagnose(diagnostic::id::invalid_option, {},
+                 "--emit-pch", "requires exactly one input file");
+        return;
+    }
+    if (!state.dependency_file.empty()) {
+        if (state.dependencies == options::dependency_mode::none) {
+            diagnose(diagnostic::id::invalid_option, {},
+                     "-MF", "requires -M or -MD");
+            return;
+        } else if (filenames.size() != 1) {
+            diagnose(diagnostic::id::invalid_option, {},
+                     "-MF", "requires exactly one input file");
+            return;
+        }
+    }
+    if (!state.output_file.empty()) {
+        if (!state.preprocess_only) {
+            diagnose(diagnostic::id::invalid_option, {},
+                     "-o", "only supported with -E");
+            return;
+        } else if (filenames.size() != 1) {
+            diagnose(diagnostic::id::invalid_option, {},
+                     "-o", "requires exactly one input file");
+            return;
+        }
+    }
+    // the prefix is mapped once and shared by all units
+    std::shared_ptr<const pp::pch> prefix;
+    if (!state.include_pch_file.empty()) {
+        prefix = pp::pch::open(state.include_pch_file);
+        if (!prefix) return;
+    }
+    if (state.jobs <= 1 || filenames.size() <= 1) {
+        for (const auto& filename : filenames) {
+            if (auto code = run_translation_unit(state, filename, prefix)) {
+                current_context().exit_code = code;
+            }
+        }
+        return;
+    }
+
+    // each unit's output is captured and written out in input order, as
+    // soon as it and all units before it have finished
+    struct unit_result {
+        std::string output;
+        std::string errors;
+        int exit_code;
+    };
+    std::vector<std::promise<unit_result>> promises(filenames.size());
+    thread_pool pool{std::min<unsigned>(state.jobs, filenames.size())};
+    for (std::size_t i = 0; i < filenames.size(); ++i) {
+        pool.submit([&, i] {
+            try {
+                capture captured;
+                int exit_code = run_translation_unit(state, filenames[i],
+                                                     prefix);
+                promises[i].set_value({
+                    captured.str(), captured.error_str(), exit_code
+                });
+            } catch (...) {
+                promises[i].set_exception(std::current_exception());
+            }
+        });
+    }
+    for (auto& promise : promises) {
+        auto result = promise.get_future().get();
+        // through errors() and output(), so that a server request
+        // captures them too
+        std::fwrite(result.errors.data(), 1, result.errors.size(), errors());
+        std::fwrite(result.output.data(), 1, result.output.size(), output());
+        std::fflush(output());
+        if (result.exit_code) current_context().exit_code = result.exit_code;
+    }
+}
+
+// processes one file in a fresh context and returns its exit code
+int run_translation_unit(const options::config& config,
+                         const std::string& filename,
+                         std::shared_ptr<const pp::pch> prefix) {
+    compilation_context context{config};
+    try {
+        process_translation_unit(filename, std::move(prefix));
+    } catch (const diagnostic::error_limit_reached&) {
+        // move on to the next file
+    }
+    return context.exit_code;
+}
+
+void process_translation_unit(const std::string& filename,
+                              std::shared_ptr<const pp::pch> prefix) {
+    const auto& state = current_context().options;
+    const auto& pch_file = state.emit_pch_file;
+    if (!filename.ends_with(".c") && pch_file.empty() &&
+        !state.preprocess_only) {
+        diagnose(diagnostic::id::input_file_not_dot_c, {}, filename);
+    }
+    std::ifstream file{filename};
+    if (!file.good()) {
+        diagnose(diagnostic::id::cannot_open_file, {}, filename);
+        return;
+    }
+    std::stringstream ss;
+    ss << file.rdbuf();
+    auto data = ss.str();
+    ss.clear();
+    stats::count(stats::counter::bytes_read, data.size());
+
+    auto buf = std::make_unique<raw_buffer>(filename, data);
+    auto post_p1 = pp::perform_phase_one(std::move(buf));
+    auto post_p2 = pp::perform_phase_two(std::move(post_p1));
+    auto tokens = pp::perform_phase_three(*post_p2);
+    const auto& main_buffer = *post_p2;
+    pp::phase_four_manager p4m(std::move(post_p2), std::move(tokens));
+    if (prefix) p4m.use_pch(std::move(prefix));
+    tokens = p4m.process();
+    const auto dependencies = state.dependencies;
+    if (dependencies != options::dependency_mode::none) {
+        write_dependencies(filename, p4m);
+    }
+    if (!pch_file.empty()) {
+        p4m.write_pch(pch_file);
+        return;
+    } else if (dependencies == options::dependency_mode::only) {
+        return;
+    } else if (state.preprocess_only) {
+        pp::write_preprocessed(tokens, main_buffer, state.output_file);
+        return;
+    }
+    pp::remove_whitespace(tokens);
+    pp::buffer_ptrs extra_buffers;
+    tokens = pp::perform_phase_six(std::move(tokens), extra_buffers);
+    tokens = pp::perform_phase_seven(tokens);
+    if (state.bench_parse_runs) {
+        benchmark_parse(filename, tokens);
+        return;
+    }
+    if (state.lazy_bodies) {
+        stats::phase_timer timer{stats::phase::parse};
+        parse::parse_translation_unit_lazy(tokens);
+    } else if (state.parse_jobs > 1) {
+        stats::phase_timer timer{stats::phase::parse};
+        parse::parse_translation_unit_parallel(tokens, state.parse_jobs);
+    } else {
+        stats::phase_timer timer{stats::phase::parse};
+        parse::parser p{tokens};
+        parse::parse_translation_unit(p);
+    }
+    std::println(output(), "");
+    debug_dump_tokens(tokens);
+    std::println(output(), "");
+}
+
+// parses a unit over and over to measure the parser alone, against the
+// size of the unit written out with a space after each token
+void benchmark_parse(const std::string& filename,
+                     const std::vector<token>& tokens) {
+    std::size_t bytes = 0;
+    for (const auto& tok : tokens) {
+        if (!tok.is(token::end_of_input)) bytes += tok.spelling.size() + 1;
+    }
+    const auto& state = current_context().options;
+    const auto runs = state.bench_parse_runs;
+    const auto start = std::chrono::steady_clock::now();
+    std::size_t nodes = 0;
+    for (unsigned run = 0; run < runs; ++run) {
+        stats::phase_timer timer{stats::phase::parse};
+        if (state.lazy_bodies) {
+            nodes = parse::parse_translation_unit_lazy(tokens).node_count();
+            continue;
         }
-        std::ifstream file{filename};
-        if (!file.good()) {
-            diagnose(diagnostic::id::cannot_open_file, {}, filename);
+        if (state.parse_jobs > 1) {
+            nodes = parse::parse_translation_unit_parallel(
+                tokens, state.parse_jobs
+            ).node_count();
             continue;
         }
-        std::stringstream ss;
-        ss << file.rdbuf();
-        auto data = ss.str();
-        ss.clear();
-
-        auto buf = std::make_unique<raw_buffer>(filename, data);
-        auto post_p1 = pp::perform_phase_one(std::move(buf));
-        auto post_p2 = pp::perform_phase_two(std::move(post_p1));
-        auto tokens = pp::perform_phase_three(*post_p2);
-        pp::phase_four_manager p4m(std::move(post_p2), std::move(tokens));
-        tokens = p4m.process();
-        pp::remove_whitespace(tokens);
-        pp::buffer_ptrs extra_buffers;
-        tokens = pp::perform_phase_six(std::move(tokens), extra_buffers);
-        tokens = pp::perform_phase_seven(tokens);
-        std::println("");
-        debug_dump_tokens(tokens);
-        std::println("");
+        parse::parser p{tokens};
+        parse::parse_translation_unit(p);
+        nodes = p.tree().size();
     }
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    const auto seconds = elapsed.count() / runs;
+    std::println(output(), "{}: {} bytes, {} tokens, {} nodes, "
+                 "{:.3f} ms per parse, {:.1f} MB/s", filename, bytes,
+                 tokens.size() - 1, nodes, seconds * 1e3,
+                 bytes / seconds / 1e6);
+}
+
+// the make rule for a unit goes to -MF, else to the output of -M, else
+// next to the output of -MD
+void write_dependencies(const std::string& filename,
+                        const pp::phase_four_manager& p4m) {
+    namespace fs = std::filesystem;
+    const auto& state = current_context().options;
+    auto target = fs::path(filename).filename().replace_extension(".o");
+    std::vector<std::string> prerequisites{filename};
+    if (!state.include_pch_file.empty()) {
+        prerequisites.push_back(state.include_pch_file);
+    }
+    const auto& headers = p4m.included_files();
+    prerequisites.insert(prerequisites.end(), headers.begin(), headers.end());
+    auto rule = pp::format_dependencies(target.string(), prerequisites);
+
+    auto path = state.dependency_file;
+    if (path.empty() && state.dependencies == options::dependency_mode::only) {
+        path = state.output_file;
+    } else if (path.empty()) {
+        auto base = state.output_file.empty() ? fs::path(filename).filename()
+                                              : fs::path(state.output_file);
+        path = base.replace_extension(".d").string();
+    }
+    FILE* file = path.empty() ? output() : std::fopen(path.c_str(), "wb");
+    if (!file) {
+        diagnose(diagnostic::id::cannot_open_file, {}, path);
+        return;
+    }
+    std::fwrite(rule.data(), 1, rule.size(), file);
+    if (file != output()) std::fclose(file);
 }
 
 void debug_parse() {
+    const auto& state = current_context().options;
     bool is_declarator = true;
-    if (options::state.mode == options::run_mode::debug_parse_expr) {
+    if (state.mode == options::run_mode::debug_parse_expr) {
         is_declarator = false;
     }
-    const auto& data = options::state.debug_string_to_parse;
+    const auto& data = state.debug_string_to_parse;
     auto buf = std::make_unique<raw_buffer>("<debug>", data);
     auto post_p1 = pp::perform_phase_one(std::move(buf));
     auto post_p2 = pp::perform_phase_two(std::move(post_p1));
@@ -129,15 +415,16 @@ void debug_parse() {
     tokens = pp::perform_phase_six(std::move(tokens), extra_buffers);
     tokens = pp::perform_phase_seven(tokens);
 
+    stats::phase_timer timer{stats::phase::parse};
     parse::parser p{tokens};
     p.push_ruleset(is_declarator);
     auto node = p.parse(0);
+    if (!p.recovering()) p.tree().dump(node);
     p.pop_ruleset();
-    node->dump();
 }
 
 void debug_scratch() {
-    const auto& data = options::state.debug_string_to_parse;
+    const auto& data = current_context().options.debug_string_to_parse;
     auto buf = std::make_unique<raw_buffer>("<debug>", data);
     auto post_p1 = pp::perform_phase_one(std::move(buf));
     auto post_p2 = pp::perform_phase_two(std::move(post_p1));
@@ -149,15 +436,8 @@ void debug_scratch() {
     tokens = pp::perform_phase_six(std::move(tokens), extra_buffers);
     tokens = pp::perform_phase_seven(tokens);
 
+    stats::phase_timer timer{stats::phase::parse};
     parse::parser p{tokens};
-    auto ds = parse::parse_decl_spec(p);
-    auto idl = parse::parse_init_declarator_list(p);
-    for (const auto& id : idl) {
-        id.declarator->dump();
-        if (id.init) {
-            std::print(stderr, " = ");
-            id.init->dump();
-        }
-    }
-    int bp = 0;
+    auto unit = parse::parse_translation_unit(p);
+    p.tree().dump(unit);
 }
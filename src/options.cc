@@ -3,6 +3,7 @@
 #include "diagnostic.hh"
 
 #include <utility>
+#include <algorithm>
 #include <cassert>
 #include <map>
 #include <cstdlib>
@@ -28,6 +29,8 @@ namespace options {
 
     std::map<std::string, option> options;
     std::map<std::string, std::string> short_to_long;
+    // the config the handlers fill in while parse() runs
+    config* parsed = nullptr;
 
     void register_option(option opt) {
         assert(!opt.require_arg || opt.allow_arg);
@@ -38,15 +41,15 @@ namespace options {
     }
 
     void handle_help(std::string, std::optional<std::string>) {
-        state.mode = run_mode::show_help;
+        parsed->mode = run_mode::show_help;
     }
 
     void handle_version(std::string, std::optional<std::string>) {
-        state.mode = run_mode::show_version;
+        parsed->mode = run_mode::show_version;
     }
 
     void handle_test(std::string, std::optional<std::string>) {
-        state.mode = run_mode::run_tests;
+        parsed->mode = run_mode::run_tests;
     }
 
     template<unsigned size_info::*Size>
@@ -55,39 +58,254 @@ namespace options {
         if (sz <= 0) {
             diagnose(diagnostic::id::invalid_option, {},
                      opt, "invalid argument");
-            state.mode = run_mode::option_parsing_error;
+            parsed->mode = run_mode::option_parsing_error;
             return;
         }
-        state.sizes.*Size = sz;
+        parsed->sizes.*Size = sz;
+    }
+
+    void handle_error_limit(std::string opt, std::optional<std::string> arg) {
+        auto limit = std::atoi(arg->c_str());
+        if (limit < 0 || (!limit && *arg != "0")) {
+            diagnose(diagnostic::id::invalid_option, {},
+                     opt, "invalid argument");
+            parsed->mode = run_mode::option_parsing_error;
+            return;
+        }
+        parsed->error_limit = limit;
+    }
+
+    void handle_preprocess(std::string, std::optional<std::string>) {
+        parsed->preprocess_only = true;
+    }
+
+    void handle_output(std::string, std::optional<std::string> arg) {
+        parsed->output_file = *arg;
+    }
+
+    void handle_dependencies(std::string opt, std::optional<std::string>) {
+        if (opt.ends_with("MD")) {
+            parsed->dependencies = dependency_mode::also;
+        } else {
+            // like -E, but the output is the dependencies
+            parsed->dependencies = dependency_mode::only;
+            parsed->preprocess_only = true;
+        }
+    }
+
+    void handle_dependency_file(std::string, std::optional<std::string> arg) {
+        parsed->dependency_file = *arg;
+    }
+
+    void handle_include_dir(std::string, std::optional<std::string> arg) {
+        parsed->include_dirs.push_back(*arg);
+    }
+
+    void handle_system_include_dir(std::string,
+                                   std::optional<std::string> arg) {
+        parsed->system_include_dirs.push_back(*arg);
+        // diagnostics in system headers are controlled separately
+        parsed->diagnostics.system_header_prefixes.push_back(*arg);
+    }
+
+    void handle_jobs(std::string opt, std::optional<std::string> arg) {
+        auto jobs = std::atoi(arg->c_str());
+        if (jobs <= 0) {
+            diagnose(diagnostic::id::invalid_option, {},
+                     opt, "invalid argument");
+            parsed->mode = run_mode::option_parsing_error;
+            return;
+        }
+        parsed->jobs = jobs;
+    }
+
+    void handle_parse_jobs(std::string opt,
+                           std::optional<std::string> arg) {
+        auto jobs = std::atoi(arg->c_str());
+        if (jobs <= 0) {
+            diagnose(diagnostic::id::invalid_option, {},
+                     opt, "invalid argument");
+            parsed->mode = run_mode::option_parsing_error;
+            return;
+        }
+        parsed->parse_jobs = jobs;
+    }
+
+    void handle_lazy_bodies(std::string, std::optional<std::string>) {
+        parsed->lazy_bodies = true;
+    }
+
+    void handle_time_report(std::string opt, std::optional<std::string> arg) {
+        if (!arg || *arg == "table") parsed->time_report = report_format::table;
+        else if (*arg == "json") parsed->time_report = report_format::json;
+        else {
+            diagnose(diagnostic::id::invalid_option, {},
+                     opt, "argument must be 'table' or 'json'");
+            parsed->mode = run_mode::option_parsing_error;
+        }
+    }
+
+    void handle_time_trace(std::string, std::optional<std::string> arg) {
+        parsed->time_trace_file = arg ? *arg : "spcc-trace.json";
+    }
+
+    void handle_time_trace_granularity(std::string opt,
+                                       std::optional<std::string> arg) {
+        auto us = std::atoi(arg->c_str());
+        if (us < 0 || (!us && *arg != "0")) {
+            diagnose(diagnostic::id::invalid_option, {},
+                     opt, "invalid argument");
+            parsed->mode = run_mode::option_parsing_error;
+            return;
+        }
+        parsed->time_trace_granularity = us;
+    }
+
+    void handle_bench_parse(std::string opt,
+                            std::optional<std::string> arg) {
+        auto runs = arg ? std::atoi(arg->c_str()) : 10;
+        if (runs <= 0) {
+            diagnose(diagnostic::id::invalid_option, {},
+                     opt, "invalid argument");
+            parsed->mode = run_mode::option_parsing_error;
+            return;
+        }
+        parsed->bench_parse_runs = runs;
     }
 
     void handle_char(std::string opt, std::optional<std::string> arg) {
-        if (*arg == "signed") state.is_char_signed = true;
-        else if (*arg == "unsigned") state.is_char_signed = false;
+        if (*arg == "signed") parsed->is_char_signed = true;
+        else if (*arg == "unsigned") parsed->is_char_signed = false;
         else {
             diagnose(diagnostic::id::invalid_option, {},
                      opt, "argument must be 'signed' or 'unsigned'");
-            state.mode = run_mode::option_parsing_error;
+            parsed->mode = run_mode::option_parsing_error;
+        }
+    }
+
+    void handle_server(std::string opt, std::optional<std::string> arg) {
+        if (parsed->mode == run_mode::client) {
+            diagnose(diagnostic::id::invalid_option, {},
+                     opt, "cannot be combined with --connect");
+            parsed->mode = run_mode::option_parsing_error;
+            return;
+        }
+        parsed->mode = run_mode::server;
+        parsed->socket_path = *arg;
+    }
+
+    void handle_connect(std::string opt, std::optional<std::string> arg) {
+        if (parsed->mode == run_mode::server) {
+            diagnose(diagnostic::id::invalid_option, {},
+                     opt, "cannot be combined with --server");
+            parsed->mode = run_mode::option_parsing_error;
+            return;
         }
+        parsed->mode = run_mode::client;
+        parsed->socket_path = *arg;
+    }
+
+    void handle_emit_pch(std::string opt, std::optional<std::string> arg) {
+        if (!parsed->include_pch_file.empty()) {
+            diagnose(diagnostic::id::invalid_option, {},
+                     opt, "cannot be combined with --include-pch");
+            parsed->mode = run_mode::option_parsing_error;
+            return;
+        }
+        parsed->emit_pch_file = *arg;
+    }
+
+    void handle_include_pch(std::string opt, std::optional<std::string> arg) {
+        if (!parsed->emit_pch_file.empty()) {
+            diagnose(diagnostic::id::invalid_option, {},
+                     opt, "cannot be combined with --emit-pch");
+            parsed->mode = run_mode::option_parsing_error;
+            return;
+        }
+        parsed->include_pch_file = *arg;
     }
 
     void handle_dump_config(std::string, std::optional<std::string>) {
-        state.mode = run_mode::dump_config;
+        parsed->mode = run_mode::dump_config;
     }
 
     void handle_parse_declarator(std::string, std::optional<std::string> arg) {
-        state.mode = run_mode::debug_parse_declarator;
-        state.debug_string_to_parse = *arg + "\n";
+        parsed->mode = run_mode::debug_parse_declarator;
+        parsed->debug_string_to_parse = *arg + "\n";
     }
 
     void handle_parse_expr(std::string, std::optional<std::string> arg) {
-        state.mode = run_mode::debug_parse_expr;
-        state.debug_string_to_parse = *arg + "\n";
+        parsed->mode = run_mode::debug_parse_expr;
+        parsed->debug_string_to_parse = *arg + "\n";
     }
 
     void handle_debug_scratch(std::string, std::optional<std::string> arg) {
-        state.mode = run_mode::debug_scratch;
-        if (arg) state.debug_string_to_parse = *arg + "\n";
+        parsed->mode = run_mode::debug_scratch;
+        if (arg) parsed->debug_string_to_parse = *arg + "\n";
+    }
+
+    // -W<name>, -Wno-<name>, -Werror, -Werror=<name>, -Wno-error=<name>
+    // where <name> is a diagnostic id or a category
+    void handle_diagnostic_flag(std::string opt,
+                                std::optional<std::string> arg) {
+        auto& controls = parsed->diagnostics;
+        std::string name = *arg;
+        bool negated = name.starts_with("no-");
+        if (negated) name = name.substr(3);
+        bool error = false;
+        if (name == "error") {
+            if (negated) controls.error_categories.clear();
+            else controls.error_categories.insert(diagnostic::category::warning);
+            return;
+        } else if (name.starts_with("error=")) {
+            error = true;
+            name = name.substr(6);
+        }
+        if (auto cat = diagnostic::find_category(name)) {
+            if (*cat == diagnostic::category::error) {
+                diagnose(diagnostic::id::invalid_option, {},
+                         opt, "errors cannot be controlled");
+                parsed->mode = run_mode::option_parsing_error;
+            } else if (error && negated) {
+                controls.error_categories.erase(*cat);
+            } else if (error) {
+                controls.error_categories.insert(*cat);
+            } else if (negated) {
+                controls.disabled_categories.insert(*cat);
+            } else {
+                controls.disabled_categories.erase(*cat);
+            }
+            return;
+        }
+        std::replace(name.begin(), name.end(), '-', '_');
+        auto diag = diagnostic::find_by_name(name);
+        if (!diag) {
+            diagnose(diagnostic::id::invalid_option, {},
+                     opt, "unknown diagnostic name");
+            parsed->mode = run_mode::option_parsing_error;
+            return;
+        }
+        auto cat = diagnostic::find(*diag).category;
+        if (cat == diagnostic::category::error ||
+            cat == diagnostic::category::auxiliary) {
+            diagnose(diagnostic::id::invalid_option, {},
+                     opt, "diagnostic cannot be controlled");
+            parsed->mode = run_mode::option_parsing_error;
+            return;
+        }
+        if (error) controls.as_error[*diag] = !negated;
+        else controls.enabled[*diag] = !negated;
+    }
+
+    void handle_no_warnings(std::string, std::optional<std::string>) {
+        parsed->diagnostics.disabled_categories.insert(
+            diagnostic::category::warning
+        );
+    }
+
+    void handle_system_header_prefix(std::string,
+                                     std::optional<std::string> arg) {
+        parsed->diagnostics.system_header_prefixes.push_back(*arg);
     }
 
     void register_options() {
@@ -162,6 +380,162 @@ namespace options {
             "configure the signedness of the plain char type",
             "--char=signed|unsigned"
         });
+        register_option({
+            "W", "diagnostic",
+            handle_diagnostic_flag,
+            true, true,
+            "enable, disable, or promote a diagnostic or category",
+            "-W[no-][error=]name"
+        });
+        register_option({
+            "w", "no-warnings",
+            handle_no_warnings,
+            false, false,
+            "suppress all warnings",
+            {}
+        });
+        register_option({
+            {}, "system-header-prefix",
+            handle_system_header_prefix,
+            true, true,
+            "suppress warnings in files under a path",
+            "--system-header-prefix=path"
+        });
+        register_option({
+            {}, "error-limit",
+            handle_error_limit,
+            true, true,
+            "stop processing a file after n errors (0 for no limit)",
+            "--error-limit=n"
+        });
+        register_option({
+            "E", "preprocess",
+            handle_preprocess,
+            false, false,
+            "write the preprocessed input instead of compiling it",
+            "-E"
+        });
+        register_option({
+            "o", "output",
+            handle_output,
+            true, true,
+            "write the output to a file instead of stdout",
+            "-o file"
+        });
+        register_option({
+            "I", "include-dir",
+            handle_include_dir,
+            true, true,
+            "search a directory for #include files",
+            "-I dir"
+        });
+        register_option({
+            {}, "isystem",
+            handle_system_include_dir,
+            true, true,
+            "search a directory of system headers after the -I ones",
+            "-isystem dir"
+        });
+        register_option({
+            {}, "M",
+            handle_dependencies,
+            false, false,
+            "write make dependencies instead of the preprocessed input",
+            "-M"
+        });
+        register_option({
+            {}, "MD",
+            handle_dependencies,
+            false, false,
+            "write make dependencies while compiling",
+            "-MD"
+        });
+        register_option({
+            {}, "MF",
+            handle_dependency_file,
+            true, true,
+            "file for the dependencies of -MD or -M",
+            "-MF file"
+        });
+        register_option({
+            "j", "jobs",
+            handle_jobs,
+            true, true,
+            "process up to n input files in parallel",
+            "-j n"
+        });
+        register_option({
+            {}, "parse-jobs",
+            handle_parse_jobs,
+            true, true,
+            "parse the function bodies of each input on n threads, or on "
+            "those of -j; with --error-limit, which body errors are "
+            "reported may vary from run to run",
+            "--parse-jobs=n"
+        });
+        register_option({
+            {}, "lazy-bodies",
+            handle_lazy_bodies,
+            false, false,
+            "only skim function bodies, parsing the declarations alone",
+            "--lazy-bodies"
+        });
+        register_option({
+            {}, "time-report",
+            handle_time_report,
+            true, false,
+            "report time, allocations, and counters for each phase",
+            "--time-report[=table|json]"
+        });
+        register_option({
+            {}, "time-trace",
+            handle_time_trace,
+            true, false,
+            "write a Chrome trace of phases, includes, and macro expansions",
+            "--time-trace[=file]"
+        });
+        register_option({
+            {}, "time-trace-granularity",
+            handle_time_trace_granularity,
+            true, true,
+            "minimum duration in microseconds of recorded trace events",
+            "--time-trace-granularity=n"
+        });
+        register_option({
+            {}, "bench-parse",
+            handle_bench_parse,
+            true, false,
+            "parse each input n times, 10 by default, and report MB/s",
+            "--bench-parse[=n]"
+        });
+        register_option({
+            {}, "server",
+            handle_server,
+            true, true,
+            "serve requests from --connect clients, keeping caches warm",
+            "--server=socket"
+        });
+        register_option({
+            {}, "connect",
+            handle_connect,
+            true, true,
+            "have the server at the socket process the other arguments",
+            "--connect=socket"
+        });
+        register_option({
+            {}, "emit-pch",
+            handle_emit_pch,
+            true, true,
+            "save the preprocessor state after a prefix header",
+            "--emit-pch=file"
+        });
+        register_option({
+            {}, "include-pch",
+            handle_include_pch,
+            true, true,
+            "start each input from a state saved with --emit-pch",
+            "--include-pch=file"
+        });
         register_option({
             {}, "dump-config",
             handle_dump_config,
@@ -192,14 +566,32 @@ namespace options {
         });
     }
 
+    void parse_arguments(std::vector<std::string> args);
     void validate_sizes();
 }
 
 void options::parse(int argc, char** argv) {
-    register_options();
-    std::vector<std::string> args(argv + 1, argv + argc);
-    for (auto& arg : args) {
-        if (state.mode == run_mode::option_parsing_error) return;
+    state = parse(std::vector<std::string>(argv + 1, argv + argc));
+}
+
+options::config options::parse(std::vector<std::string> args) {
+    config result;
+    parsed = &result;
+    parse_arguments(std::move(args));
+    parsed = nullptr;
+    return result;
+}
+
+void options::parse_arguments(std::vector<std::string> args) {
+    // a server parses the arguments of every request
+    if (options.empty()) register_options();
+    for (std::size_t i = 0; i < args.size(); ++i) {
+        auto& arg = args[i];
+        if (parsed->mode == run_mode::option_parsing_error) return;
+        if (arg.starts_with("-f") && arg.size() > 2) {
+            // -fname[=value] is an alternate spelling of --name[=value]
+            arg = "--" + arg.substr(2);
+        }
         if (arg.starts_with("-")) {
             std::string long_form = "";
             std::optional<std::string> opt_arg;
@@ -209,6 +601,13 @@ void options::parse(int argc, char** argv) {
                 if (arg.contains('=')) {
                     opt_arg = arg.substr(arg.find('=') + 1);
                 }
+            } else if (options.count(arg.substr(1))) {
+                // gcc style single dash long options, such as -MF file
+                long_form = arg.substr(1);
+                if (options.at(long_form).require_arg &&
+                    i + 1 < args.size()) {
+                    opt_arg = args[++i];
+                }
             } else {
                 auto short_form = arg.substr(1, 1);
                 auto it = short_to_long.find(short_form);
@@ -216,6 +615,10 @@ void options::parse(int argc, char** argv) {
                     long_form = it->second;
                     if (arg.size() > 2) {
                         opt_arg = arg.substr(2);
+                    } else if (options.at(long_form).require_arg &&
+                               i + 1 < args.size()) {
+                        // -j 4 as well as -j4
+                        opt_arg = args[++i];
                     }
                 }
             }
@@ -224,30 +627,30 @@ void options::parse(int argc, char** argv) {
                 if (it->second.require_arg && !opt_arg) {
                     diagnose(diagnostic::id::invalid_option, {},
                              arg, "missing argument");
-                    state.mode = run_mode::option_parsing_error;
+                    parsed->mode = run_mode::option_parsing_error;
                     return;
                 } else if (!it->second.allow_arg && opt_arg) {
                     diagnose(diagnostic::id::invalid_option, {},
                              arg, "option does not take arguments");
-                    state.mode = run_mode::option_parsing_error;
+                    parsed->mode = run_mode::option_parsing_error;
                     return;
                 }
                 it->second.handler(arg, opt_arg);
             } else {
                 diagnose(diagnostic::id::invalid_option, {},
                          arg, "unknown option name");
-                state.mode = run_mode::option_parsing_error;
+                parsed->mode = run_mode::option_parsing_error;
                 return;
             }
         } else {
-            state.input_filenames.push_back(std::move(arg));
+            parsed->input_filenames.push_back(std::move(arg));
         }
     }
     validate_sizes();
 }
 
 void options::validate_sizes() {
-    const auto& sizes = state.sizes;
+    const auto& sizes = parsed->sizes;
     bool good = true;
     std::string error;
     const auto bpb = sizes.bits_per_byte;
@@ -277,23 +680,23 @@ void options::validate_sizes() {
                "long long", "long-long");
     if (!good) {
         diagnose(diagnostic::id::invalid_size, {}, error);
-        state.mode = run_mode::option_parsing_error;
+        parsed->mode = run_mode::option_parsing_error;
     }
 }
 
-void options::dump() {
-    if (!state.input_filenames.empty()) {
+void options::dump(const config& shown) {
+    if (!shown.input_filenames.empty()) {
         std::println("input filenames:");
-        for (const auto& filename : state.input_filenames) {
+        for (const auto& filename : shown.input_filenames) {
             std::println("\t{}", filename);
         }
     }
 
-    std::println("plain char: {}", state.is_char_signed ? "signed" : "unsigned");
+    std::println("plain char: {}", shown.is_char_signed ? "signed" : "unsigned");
 
-    std::println("bits per byte: {}", state.sizes.bits_per_byte);
-    std::println("sizeof(short): {}", state.sizes.short_bytes);
-    std::println("sizeof(int): {}", state.sizes.int_bytes);
-    std::println("sizeof(long): {}", state.sizes.long_bytes);
-    std::println("sizeof(long long): {}", state.sizes.long_long_bytes);
+    std::println("bits per byte: {}", shown.sizes.bits_per_byte);
+    std::println("sizeof(short): {}", shown.sizes.short_bytes);
+    std::println("sizeof(int): {}", shown.sizes.int_bytes);
+    std::println("sizeof(long): {}", shown.sizes.long_bytes);
+    std::println("sizeof(long long): {}", shown.sizes.long_long_bytes);
 }
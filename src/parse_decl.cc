@@ -0,0 +1,374 @@
+#include "parse_decl.hh"
+#include "decl_spec.hh"
+#include "declarator.hh"
+#include "parse_expr.hh"
+#include "parse_stmt.hh"
+
+#include <algorithm>
+
+namespace {
+    using namespace parse;
+
+    // [ constant-expression ] and . identifier, any number of them, before
+    // an initializer in a list [6.7.9]/1
+    node_id parse_designated_initializer(parser& p) {
+        std::vector<node_id> designators;
+        while (!p.recovering()) {
+            if (p.peek().is(punctuator::dot)) {
+                p.next();
+                const auto dot = p.last();
+                if (!p.peek().is(token::identifier)) {
+                    p.fail(p.peek().range.first, "expected member name");
+                    break;
+                }
+                p.next();
+                designators.push_back(
+                    p.make<designator_node>(dot, no_node, p.last())
+                );
+            } else if (p.peek().is(punctuator::square_left)) {
+                p.next();
+                const auto left = p.last();
+                auto index = parse_expression(p, ep_assignment);
+                auto right = p.expect(punctuator::square_right, "]");
+                designators.push_back(
+                    p.make<designator_node>(left, index, right)
+                );
+            } else {
+                break;
+            }
+        }
+        if (designators.empty()) return parse_initializer(p);
+        p.expect(punctuator::equal, "=");
+        auto init = parse_initializer(p);
+        auto designator_list = p.tree().add_list(designators);
+        return p.make<designation_node>(designator_list, init);
+    }
+
+    // a member declaration of a struct or union, whose declarators may be
+    // bit-fields and which may have none at all for an anonymous member
+    node_id parse_member_declaration(parser& p) {
+        if (p.peek().is(kw_Static_assert)) return parse_static_assert(p);
+        auto ds = parse_decl_spec(p);
+        std::vector<node_id> decls;
+        while (!p.peek().is(punctuator::semicolon) && !p.recovering()) {
+            if (!decls.empty()) p.expect(punctuator::comma, ",");
+            auto decl = no_node;
+            if (!p.peek().is(punctuator::colon)) {
+                const auto start = p.position();
+                p.push_ruleset(true);
+                decl = p.parse(0);
+                p.pop_ruleset();
+                if (p.position() == start) {
+                    p.fail(p.peek().range.first, "expected declarator");
+                }
+            }
+            if (p.peek().is(punctuator::colon) && !p.recovering()) {
+                p.next();
+                const auto colon = p.last();
+                auto width = parse_expression(p, ep_assignment);
+                decl = p.make<bit_field_node>(decl, colon, width);
+            }
+            decls.push_back(decl);
+        }
+        auto semicolon = p.expect(punctuator::semicolon, ";");
+        auto decl_list = p.tree().add_list(decls);
+        return p.make<declaration_node>(ds.node, decl_list, semicolon);
+    }
+
+    // the init declarators of a declaration from the first declarator,
+    // which has been parsed up to any initializer, and its ;
+    node_id finish_declaration(parser& p, const decl_spec& ds,
+                               node_id first) {
+        const bool is_typedef = std::find(ds.storage_classes.begin(),
+                                          ds.storage_classes.end(),
+                                          sc_typedef) !=
+                                ds.storage_classes.end();
+        std::vector<node_id> decls;
+        auto add = [&](node_id declarator) {
+            /* [6.2.1]/7
+             ... Any other identifier has scope that begins just after the
+             completion of its declarator.
+            */
+            // so the name is declared before its own initializer, which
+            // may use it, as in int T = sizeof(T) with T a typedef name
+            auto name = inspect_declarator(p.tree(), declarator).name;
+            if (name != no_token) {
+                auto spelling = p.tree().token_at(name).spelling;
+                if (is_typedef) p.declare_typedef(spelling, {});
+                else p.declare_ordinary(spelling);
+            }
+            auto init = parse_optional_initializer(p);
+            decls.push_back(p.make<init_declarator_node>(declarator, init));
+        };
+        add(first);
+        while (p.peek().is(punctuator::comma) && !p.recovering()) {
+            p.next();
+            add(parse_declarator(p));
+        }
+        auto semicolon = p.expect(punctuator::semicolon, ";");
+        auto decl_list = p.tree().add_list(decls);
+        return p.make<declaration_node>(ds.node, decl_list, semicolon);
+    }
+
+    // the named parameters of a function declarator's prototype, which
+    // is in tree
+    void declare_parameters(parser& p, const ast& tree, node_id function) {
+        const auto& call = static_cast<const call_node&>(tree[function]);
+        for (auto arg : tree.list(call.args())) {
+            if (tree[arg].kind() != node_kind::parameter) continue;
+            const auto& param = static_cast<const parameter_node&>(tree[arg]);
+            auto name = inspect_declarator(tree, param.declarator()).name;
+            if (name != no_token) {
+                p.declare_ordinary(tree.token_at(name).spelling);
+            }
+        }
+    }
+
+    // the names an old-style definition declares between its identifier
+    // list and its body, which is in tree
+    void declare_identifiers(parser& p, const ast& tree, node_id decl) {
+        if (tree[decl].kind() != node_kind::declaration) return;
+        const auto& d = static_cast<const declaration_node&>(tree[decl]);
+        for (auto id : tree.list(d.declarators())) {
+            const auto& init =
+                static_cast<const init_declarator_node&>(tree[id]);
+            auto name = inspect_declarator(tree, init.declarator()).name;
+            if (name != no_token) {
+                p.declare_ordinary(tree.token_at(name).spelling);
+            }
+        }
+    }
+
+    // a declaration of nothing but a tag, as in struct s;
+    node_id finish_empty_declaration(parser& p, const decl_spec& ds) {
+        p.next();
+        return p.make<declaration_node>(ds.node, id_list{}, p.last());
+    }
+}
+
+namespace parse {
+    node_id parse_type_name(parser& p) {
+        const auto start = p.position();
+        auto ds = parse_decl_spec(p);
+        if (p.position() == start) {
+            p.fail(p.peek().range.first, "expected type name");
+        }
+        p.push_ruleset(true);
+        auto declarator = p.parse(0);
+        p.pop_ruleset();
+        return p.make<type_name_node>(ds.node, declarator);
+    }
+
+    node_id parse_initializer(parser& p) {
+        if (!p.peek().is(punctuator::curly_left)) {
+            return parse_expression(p, ep_comma);
+        }
+        p.next();
+        const auto left = p.last();
+        std::vector<node_id> items;
+        while (!p.peek().is(punctuator::curly_right) && !p.recovering()) {
+            items.push_back(parse_designated_initializer(p));
+            // a trailing comma is allowed
+            if (!p.peek().is(punctuator::comma)) break;
+            p.next();
+        }
+        auto right = p.expect(punctuator::curly_right, "}");
+        auto item_list = p.tree().add_list(items);
+        return p.make<initializer_list_node>(left, item_list, right);
+    }
+
+    node_id parse_record_specifier(parser& p) {
+        p.next();
+        const auto kw = p.last();
+        auto name = no_token;
+        if (p.peek().is(token::identifier)) {
+            p.next();
+            name = p.last();
+        }
+        if (!p.peek().is(punctuator::curly_left)) {
+            if (name == no_token) {
+                p.fail(p.peek().range.first, "expected tag or {");
+            }
+            return p.make<record_node>(kw, name, no_token, id_list{},
+                                       no_token);
+        }
+        p.next();
+        const auto left = p.last();
+        std::vector<node_id> members;
+        while (!p.peek().is(punctuator::curly_right) && p.has_next_token()) {
+            members.push_back(parse_member_declaration(p));
+            if (p.recovering()) p.synchronize(true);
+        }
+        auto right = p.expect(punctuator::curly_right, "}");
+        auto member_list = p.tree().add_list(members);
+        return p.make<record_node>(kw, name, left, member_list, right);
+    }
+
+    node_id parse_enum_specifier(parser& p) {
+        p.next();
+        const auto kw = p.last();
+        auto name = no_token;
+        if (p.peek().is(token::identifier)) {
+            p.next();
+            name = p.last();
+        }
+        if (!p.peek().is(punctuator::curly_left)) {
+            if (name == no_token) {
+                p.fail(p.peek().range.first, "expected tag or {");
+            }
+            return p.make<enumeration_node>(kw, name, no_token, id_list{},
+                                            no_token);
+        }
+        p.next();
+        const auto left = p.last();
+        std::vector<node_id> enumerators;
+        while (!p.peek().is(punctuator::curly_right) && !p.recovering()) {
+            if (!p.peek().is(token::identifier)) {
+                p.fail(p.peek().range.first, "expected enumerator");
+                break;
+            }
+            p.next();
+            const auto constant = p.last();
+            auto value = no_node;
+            if (p.peek().is(punctuator::equal)) {
+                p.next();
+                value = parse_expression(p, ep_assignment);
+            }
+            enumerators.push_back(
+                p.make<enumerator_node>(constant, value)
+            );
+            p.declare_ordinary(p.tree().token_at(constant).spelling);
+            // a trailing comma is allowed
+            if (!p.peek().is(punctuator::comma)) break;
+            p.next();
+        }
+        auto right = p.expect(punctuator::curly_right, "}");
+        auto enumerator_list = p.tree().add_list(enumerators);
+        return p.make<enumeration_node>(kw, name, left, enumerator_list,
+                                        right);
+    }
+
+    node_id parse_static_assert(parser& p) {
+        p.next();
+        const auto kw = p.last();
+        p.expect(punctuator::paren_left, "(");
+        auto cond = parse_expression(p, ep_assignment);
+        p.expect(punctuator::comma, ",");
+        auto message = no_token;
+        if (p.peek().is(token::string_literal)) {
+            p.next();
+            message = p.last();
+        } else {
+            p.fail(p.peek().range.first, "expected string literal");
+        }
+        p.expect(punctuator::paren_right, ")");
+        auto semicolon = p.expect(punctuator::semicolon, ";");
+        return p.make<static_assertion_node>(kw, cond, message, semicolon);
+    }
+
+    node_id parse_declaration(parser& p) {
+        if (p.peek().is(kw_Static_assert)) return parse_static_assert(p);
+        auto ds = parse_decl_spec(p);
+        if (p.peek().is(punctuator::semicolon)) {
+            return finish_empty_declaration(p, ds);
+        }
+        return finish_declaration(p, ds, parse_declarator(p));
+    }
+
+    node_id parse_external_declaration(parser& p) {
+        if (p.peek().is(kw_Static_assert)) return parse_static_assert(p);
+        if (!p.declaration_ahead()) {
+            // implicit int is gone since C99
+            p.fail(p.peek().range.first, "expected declaration");
+            return p.make<error_node>(static_cast<token_id>(p.position()));
+        }
+        auto ds = parse_decl_spec(p);
+        if (p.peek().is(punctuator::semicolon)) {
+            return finish_empty_declaration(p, ds);
+        }
+        auto first = parse_declarator(p);
+        if (p.peek().is(punctuator::equal) || p.recovering()) {
+            return finish_declaration(p, ds, first);
+        }
+        /* [6.9.1]/2
+         The identifier declared in a function definition (which is the
+         name of the function) shall have a function type, as specified by
+         the declarator portion of the function definition.
+        */
+        auto derivation = inspect_declarator(p.tree(), first).derivation;
+        bool is_function = derivation != no_node &&
+                           p.tree()[derivation].kind() == node_kind::call;
+        if (!is_function || !(p.peek().is(punctuator::curly_left) ||
+                              p.declaration_ahead())) {
+            return finish_declaration(p, ds, first);
+        }
+        // the parameters are in scope in the body, where the prototype
+        // scope they were declared in has ended
+        p.push_scope();
+        declare_parameters(p, p.tree(), derivation);
+        // the declarations of an identifier list
+        std::vector<node_id> params;
+        while (p.declaration_ahead() && !p.recovering()) {
+            params.push_back(parse_declaration(p));
+        }
+        auto body = no_node;
+        const auto open = static_cast<token_id>(p.position());
+        auto close = p.recovering() ? std::nullopt : p.deferrable_body();
+        if (close) {
+            p.seek(*close + 1);
+        } else if (p.peek().is(punctuator::curly_left) && !p.recovering()) {
+            body = parse_compound_statement(p);
+        } else {
+            // the declarations of an identifier list need not be followed
+            // by a {, so it may be missing here
+            p.fail(p.peek().range.first, "expected {");
+            body = p.make<error_node>(static_cast<token_id>(p.position()));
+        }
+        p.pop_scope();
+        auto param_list = p.tree().add_list(params);
+        auto definition = p.make<function_definition_node>(
+            ds.node, first, param_list, body, p.last()
+        );
+        if (close) p.defer_body({ definition, { open, *close } });
+        return definition;
+    }
+
+    node_id parse_translation_unit(parser& p) {
+        std::vector<node_id> decls;
+        while (p.has_next_token()) {
+            // an empty declaration is not C, but is common after a
+            // function body and harmless
+            if (p.peek().is(punctuator::semicolon)) {
+                p.next();
+                continue;
+            }
+            decls.push_back(parse_external_declaration(p));
+            if (p.recovering()) p.synchronize();
+        }
+        auto decl_list = p.tree().add_list(decls);
+        return p.make<translation_unit_node>(
+            decl_list, static_cast<token_id>(p.position())
+        );
+    }
+
+    node_id parse_deferred_body(parser& p, const parser& unit,
+                                const deferred_body& body) {
+        const auto& tree = unit.tree();
+        const auto& definition =
+            static_cast<const function_definition_node&>(
+                tree[body.definition]
+            );
+        p.seek(body.braces.open);
+        p.use_file_scope(unit.scope(), body.braces.open);
+        p.push_scope();
+        auto derivation = inspect_declarator(tree, definition.declarator())
+                          .derivation;
+        declare_parameters(p, tree, derivation);
+        for (auto decl : tree.list(definition.parameter_declarations())) {
+            declare_identifiers(p, tree, decl);
+        }
+        auto result = parse_compound_statement(p);
+        p.pop_scope();
+        return result;
+    }
+}
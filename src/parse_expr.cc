@@ -1,22 +1,131 @@
 #include "parse_expr.hh"
+#include "parse_decl.hh"
 
-parse::ruleset parse::expr_ruleset = {
-    {
+namespace parse {
+    node_id ternary_rule::parse(parser& p, node_id cond, token_id tok) const {
+        auto middle = p.parse(0);
+        auto colon = p.expect(punctuator::colon, ":");
+        // right associative, and the last operand may not be an
+        // assignment [6.5.15]/1
+        auto last = p.parse(ep_conditonal - 1);
+        return p.make<ternary_node>(tok, colon, cond, middle, last);
+    }
+
+    node_id subscript_rule::parse(parser& p, node_id base,
+                                  token_id tok) const {
+        auto index = p.parse(0);
+        auto right = p.expect(punctuator::square_right, "]");
+        return p.make<subscript_node>(base, tok, index, right);
+    }
+
+    node_id member_rule::parse(parser& p, node_id base, token_id tok) const {
+        node_id member;
+        if (p.peek().is(token::identifier)) {
+            p.next();
+            member = p.make<token_node>(p.last());
+        } else {
+            p.fail(p.peek().range.first, "expected member name");
+            member = p.make<error_node>(static_cast<token_id>(p.position()));
+        }
+        return p.make<binary_node>(tok, base, member);
+    }
+
+    node_id type_query_rule::parse(parser& p, token_id tok) const {
+        if (p.peek().is(punctuator::paren_left)) {
+            p.next();
+            const auto lparen = p.last();
+            if (!p.could_be_expr_ahead()) {
+                auto type = parse_type_name(p);
+                auto rparen = p.expect(punctuator::paren_right, ")");
+                if (!p.peek().is(punctuator::curly_left)) {
+                    return p.make<type_query_node>(tok, type, rparen);
+                }
+                // the operand is a compound literal
+                auto init = parse_initializer(p);
+                auto literal = p.make<compound_literal_node>(lparen, type,
+                                                             init);
+                return p.make<unary_node>(tok, literal, true);
+            }
+            p.rewind();
+        }
+        auto operand = p.parse(ep_prefix);
+        return p.make<unary_node>(tok, operand, true);
+    }
+
+    node_id generic_rule::parse(parser& p, token_id tok) const {
+        p.expect(punctuator::paren_left, "(");
+        auto control = p.parse(ep_comma);
+        std::vector<node_id> assocs;
+        while (p.peek().is(punctuator::comma) && !p.recovering()) {
+            p.next();
+            const auto first = static_cast<token_id>(p.position());
+            auto type = no_node;
+            if (p.peek().is(kw_default)) p.next();
+            else type = parse_type_name(p);
+            p.expect(punctuator::colon, ":");
+            auto value = p.parse(ep_comma);
+            assocs.push_back(
+                p.make<generic_association_node>(first, type, value)
+            );
+        }
+        auto rparen = p.expect(punctuator::paren_right, ")");
+        auto assoc_list = p.tree().add_list(assocs);
+        return p.make<generic_node>(tok, control, assoc_list, rparen);
+    }
+
+    node_id parse_expression(parser& p, int precedence) {
+        p.push_ruleset(false);
+        auto result = p.parse(precedence);
+        p.pop_ruleset();
+        return result;
+    }
+}
+
+namespace {
+    using namespace parse;
+
+    const token_rule primary;
+    const paren_rule grouping;
+    const unary_prefix_rule prefix_operator{ep_prefix};
+    const unary_postfix_rule postfix_operator{ep_postfix};
+    const type_query_rule type_query;
+    const generic_rule generic_selection;
+    const call_rule call;
+    const subscript_rule subscript;
+    const member_rule member_access;
+    const binary_rule multiplicative{ep_multiplicative, false};
+    const binary_rule additive{ep_additive, false};
+    const binary_rule shift{ep_shift, false};
+    const binary_rule relational{ep_relational, false};
+    const binary_rule equality{ep_equality, false};
+    const binary_rule bit_and{ep_bit_and, false};
+    const binary_rule bit_xor{ep_bit_xor, false};
+    const binary_rule bit_or{ep_bit_or, false};
+    const binary_rule logical_and{ep_logical_and, false};
+    const binary_rule logical_or{ep_logical_or, false};
+    const ternary_rule conditional;
+    const binary_rule assignment{ep_assignment, true};
+    const binary_rule comma{ep_comma, false};
+
+    constexpr rule_entry<prefix_rule> prefix_rules[] = {
         {
-            +[](const token& tok, parser& p) -> bool {
+            +[](const token& tok) -> bool {
                 return tok.is(token::identifier) ||
-                       tok.is(token::integer_constant);
+                       tok.is(token::integer_constant) ||
+                       tok.is(token::floating_constant) ||
+                       tok.is(token::character_constant) ||
+                       tok.is(token::string_literal);
             },
-            new parse::token_rule
+            &primary
         },
         {
-            +[](const token& tok, parser& p) -> bool {
+            +[](const token& tok) -> bool {
                 return tok.is(punctuator::paren_left);
             },
-            new parse::paren_rule
+            &grouping
         },
         {
-            +[](const token& tok, parser& p) -> bool {
+            +[](const token& tok) -> bool {
                 return tok.is(punctuator::plus_plus) ||
                        tok.is(punctuator::minus_minus) ||
                        tok.is(punctuator::plus) ||
@@ -24,107 +133,148 @@ parse::ruleset parse::expr_ruleset = {
                        tok.is(punctuator::bang) ||
                        tok.is(punctuator::tilde) ||
                        tok.is(punctuator::star) ||
-                       tok.is(punctuator::ampersand) ||
-                       tok.is(kw_sizeof) ||
-                       tok.is(kw_Alignof);
+                       tok.is(punctuator::ampersand);
+            },
+            &prefix_operator
+        },
+        {
+            +[](const token& tok) -> bool {
+                return tok.is(kw_sizeof) || tok.is(kw_Alignof);
             },
-            new parse::unary_prefix_rule(ep_prefix)
+            &type_query
         },
-    },
-    {
         {
-            +[](const token& tok, parser& p) -> bool {
+            +[](const token& tok) -> bool {
+                return tok.is(kw_Generic);
+            },
+            &generic_selection
+        },
+    };
+
+    constexpr rule_entry<infix_rule> infix_rules[] = {
+        {
+            +[](const token& tok) -> bool {
                 return tok.is(punctuator::plus_plus) ||
                        tok.is(punctuator::minus_minus);
             },
-            new parse::unary_postfix_rule(ep_postfix)
+            &postfix_operator
         },
         {
-            +[](const token& tok, parser& p) -> bool {
+            +[](const token& tok) -> bool {
                 return tok.is(punctuator::paren_left);
             },
-            new parse::call_rule
+            &call
         },
         {
-            +[](const token& tok, parser& p) -> bool {
+            +[](const token& tok) -> bool {
+                return tok.is(punctuator::square_left);
+            },
+            &subscript
+        },
+        {
+            +[](const token& tok) -> bool {
                 return tok.is(punctuator::dot) ||
                        tok.is(punctuator::arrow);
             },
-            new parse::binary_rule(ep_postfix, false)
+            &member_access
         },
         {
-            +[](const token& tok, parser& p) -> bool {
+            +[](const token& tok) -> bool {
                 return tok.is(punctuator::star) ||
                        tok.is(punctuator::slash_forward) ||
                        tok.is(punctuator::percent);
             },
-            new parse::binary_rule(ep_multiplicative, false)
+            &multiplicative
         },
         {
-            +[](const token& tok, parser& p) -> bool {
+            +[](const token& tok) -> bool {
                 return tok.is(punctuator::plus) ||
                        tok.is(punctuator::minus);
             },
-            new parse::binary_rule(ep_additive, false)
+            &additive
         },
         {
-            +[](const token& tok, parser& p) -> bool {
+            +[](const token& tok) -> bool {
                 return tok.is(punctuator::less_less) ||
                        tok.is(punctuator::greater_greater);
             },
-            new parse::binary_rule(ep_shift, false)
+            &shift
         },
         {
-            +[](const token& tok, parser& p) -> bool {
+            +[](const token& tok) -> bool {
                 return tok.is(punctuator::less) ||
                        tok.is(punctuator::greater) ||
                        tok.is(punctuator::less_equal) ||
                        tok.is(punctuator::greater_equal);
             },
-            new parse::binary_rule(ep_relational, false)
+            &relational
         },
         {
-            +[](const token& tok, parser& p) -> bool {
-                return tok.is(punctuator::equal) ||
+            +[](const token& tok) -> bool {
+                return tok.is(punctuator::equal_equal) ||
                        tok.is(punctuator::bang_equal);
             },
-            new parse::binary_rule(ep_equality, false)
+            &equality
         },
         {
-            +[](const token& tok, parser& p) -> bool {
+            +[](const token& tok) -> bool {
                 return tok.is(punctuator::ampersand);
             },
-            new parse::binary_rule(ep_bit_and, false)
+            &bit_and
         },
         {
-            +[](const token& tok, parser& p) -> bool {
+            +[](const token& tok) -> bool {
                 return tok.is(punctuator::caret);
             },
-            new parse::binary_rule(ep_bit_xor, false)
+            &bit_xor
         },
         {
-            +[](const token& tok, parser& p) -> bool {
+            +[](const token& tok) -> bool {
                 return tok.is(punctuator::pipe);
             },
-            new parse::binary_rule(ep_bit_or, false)
+            &bit_or
         },
         {
-            +[](const token& tok, parser& p) -> bool {
+            +[](const token& tok) -> bool {
                 return tok.is(punctuator::ampersand_ampersand);
             },
-            new parse::binary_rule(ep_logical_and, false)
+            &logical_and
         },
         {
-            +[](const token& tok, parser& p) -> bool {
+            +[](const token& tok) -> bool {
                 return tok.is(punctuator::pipe_pipe);
             },
-            new parse::binary_rule(ep_logical_or, false)
+            &logical_or
         },
         {
-            +[](const token& tok, parser& p) -> bool {
+            +[](const token& tok) -> bool {
+                return tok.is(punctuator::question);
+            },
+            &conditional
+        },
+        {
+            +[](const token& tok) -> bool {
+                return tok.is(punctuator::equal) ||
+                       tok.is(punctuator::star_equal) ||
+                       tok.is(punctuator::slash_forward_equal) ||
+                       tok.is(punctuator::percent_equal) ||
+                       tok.is(punctuator::plus_equal) ||
+                       tok.is(punctuator::minus_equal) ||
+                       tok.is(punctuator::less_less_equal) ||
+                       tok.is(punctuator::greater_greater_equal) ||
+                       tok.is(punctuator::ampersand_equal) ||
+                       tok.is(punctuator::caret_equal) ||
+                       tok.is(punctuator::pipe_equal);
+            },
+            &assignment
+        },
+        {
+            +[](const token& tok) -> bool {
                 return tok.is(punctuator::comma);
             },
-            new parse::binary_rule(ep_comma, false)
+            &comma
         },
-    }
-};
+    };
+}
+
+const parse::ruleset parse::expr_ruleset = { prefix_rules, infix_rules };
@@ -0,0 +1,214 @@
+#include "parse_parallel.hh"
+#include "context.hh"
+#include "diagnostic.hh"
+#include "parse_decl.hh"
+#include "platform.hh"
+#include "thread_pool.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <span>
+#include <string>
+
+using namespace platform::stream;
+
+namespace {
+    using namespace parse;
+
+    // runs of bodies with about the same number of tokens each, so that
+    // the threads finish together
+    std::vector<std::span<deferred_body>> group_bodies(
+        std::vector<deferred_body>& bodies, std::size_t groups
+    ) {
+        auto length = [](const deferred_body& body) {
+            return body.braces.close - body.braces.open + 1;
+        };
+        std::size_t total = 0;
+        for (const auto& body : bodies) total += length(body);
+        const auto target = total / groups + 1;
+        std::vector<std::span<deferred_body>> result;
+        std::size_t begin = 0;
+        std::size_t size = 0;
+        for (std::size_t i = 0; i < bodies.size(); ++i) {
+            size += length(bodies[i]);
+            if (size < target && i + 1 != bodies.size()) continue;
+            result.emplace_back(bodies.data() + begin, i + 1 - begin);
+            begin = i + 1;
+            size = 0;
+        }
+        return result;
+    }
+
+    // the pool the bodies go to: the one the calling thread works for, as
+    // under -j, so that units and their bodies share its threads, or else
+    // one kept for bodies alone, so that parsing unit after unit does not
+    // start threads for each; only threads outside any pool come here,
+    // one at a time, so it is replaced only when the count changes
+    thread_pool& body_pool(unsigned jobs) {
+        if (auto pool = thread_pool::current()) return *pool;
+        static std::unique_ptr<thread_pool> own;
+        if (!own || own->size() != jobs) {
+            own = std::make_unique<thread_pool>(jobs);
+        }
+        return *own;
+    }
+
+    // what a group's thread wrote and counted, for the unit to take back
+    struct group_result {
+        std::string output;
+        std::string errors;
+        std::size_t diagnostics_requested = 0;
+        std::size_t error_count = 0;
+        int exit_code = 0;
+        bool reached_error_limit = false;
+    };
+}
+
+namespace parse {
+    std::vector<brace_span> skim_braces(const std::vector<token>& tokens) {
+        std::vector<brace_span> result;
+        std::size_t depth = 0;
+        token_id open = 0;
+        // the parentheses and brackets open within the braces, which
+        // count as balanced only if neither ever goes below zero
+        std::ptrdiff_t parens = 0;
+        std::ptrdiff_t brackets = 0;
+        bool balanced = true;
+        for (token_id i = 0; i < tokens.size(); ++i) {
+            const auto& tok = tokens[i];
+            if (!tok.is(token::punctuator)) continue;
+            if (depth) {
+                switch (tok.punc) {
+                    case punctuator::paren_left: ++parens; break;
+                    case punctuator::paren_right:
+                        if (--parens < 0) balanced = false;
+                        break;
+                    case punctuator::square_left: ++brackets; break;
+                    case punctuator::square_right:
+                        if (--brackets < 0) balanced = false;
+                        break;
+                    default: break;
+                }
+            }
+            if (tok.is(punctuator::curly_left)) {
+                if (depth++) continue;
+                open = i;
+                parens = brackets = 0;
+                balanced = true;
+            } else if (tok.is(punctuator::curly_right) && depth) {
+                if (--depth) continue;
+                if (balanced && !parens && !brackets) {
+                    result.push_back({ open, i });
+                }
+            }
+        }
+        return result;
+    }
+
+    node_id parsed_unit::body(std::size_t index) {
+        auto& deferred = top->deferred_bodies()[index];
+        if (deferred.body != no_node) return deferred.body;
+        assert(!body_parsers.empty());
+        deferred.tree = static_cast<std::uint32_t>(body_parsers.size() - 1);
+        deferred.body = parse_deferred_body(*body_parsers.back(), *top,
+                                            deferred);
+        return deferred.body;
+    }
+
+    std::size_t parsed_unit::node_count() const {
+        auto result = top->tree().size();
+        for (const auto& p : body_parsers) result += p->tree().size();
+        return result;
+    }
+
+    parsed_unit parse_translation_unit_parallel(
+        const std::vector<token>& tokens, unsigned jobs
+    ) {
+        auto top = std::make_unique<parser>(tokens);
+        top->defer_bodies(skim_braces(tokens));
+        auto root = parse_translation_unit(*top);
+        auto& bodies = top->deferred_bodies();
+        if (bodies.empty()) return { std::move(top), root, {} };
+
+        // more groups than threads, so that a thread with a long body
+        // leaves the rest to be stolen
+        auto groups = group_bodies(bodies, std::size_t{jobs} * 4);
+        std::vector<std::unique_ptr<parser>> parsers;
+        for (std::size_t i = 0; i < groups.size(); ++i) {
+            parsers.push_back(std::make_unique<parser>(tokens));
+        }
+        std::vector<group_result> results(groups.size());
+        auto& unit_context = current_context();
+        // the groups share what is left of the unit's error limit, so
+        // that together they stop where a parse on one thread would
+        std::atomic<std::size_t> claimed_errors{unit_context.error_count};
+        std::atomic<std::size_t> unfinished{groups.size()};
+        auto parse_group = [&](std::size_t i) {
+            compilation_context context{
+                compilation_context::helper_tag{}, unit_context,
+                &claimed_errors
+            };
+            capture captured;
+            auto& result = results[i];
+            auto& p = *parsers[i];
+            try {
+                for (auto& body : groups[i]) {
+                    body.tree = static_cast<std::uint32_t>(i);
+                    body.body = parse_deferred_body(p, *top, body);
+                }
+            } catch (const diagnostic::error_limit_reached&) {
+                result.reached_error_limit = true;
+            }
+            result.output = captured.str();
+            result.errors = captured.error_str();
+            result.diagnostics_requested =
+                context.diagnostics_requested -
+                unit_context.diagnostics_requested;
+            result.error_count =
+                context.error_count - unit_context.error_count;
+            result.exit_code = context.exit_code;
+        };
+        auto& pool = body_pool(jobs);
+        for (std::size_t i = 0; i < groups.size(); ++i) {
+            pool.submit([&, i] {
+                parse_group(i);
+                // once the group's context and capture are gone
+                --unfinished;
+            });
+        }
+        pool.wait_until([&] { return unfinished == 0; });
+
+        // a group that ran out of the limit ends the output, although
+        // which bodies' errors made it in depends on how the threads ran
+        for (const auto& result : results) {
+            std::fwrite(result.errors.data(), 1, result.errors.size(),
+                        errors());
+            std::fwrite(result.output.data(), 1, result.output.size(),
+                        output());
+            unit_context.diagnostics_requested +=
+                result.diagnostics_requested;
+            unit_context.error_count += result.error_count;
+            if (result.exit_code) unit_context.exit_code = result.exit_code;
+            if (result.reached_error_limit) {
+                throw diagnostic::error_limit_reached{};
+            }
+        }
+        return { std::move(top), root, std::move(parsers) };
+    }
+
+    parsed_unit parse_translation_unit_lazy(
+        const std::vector<token>& tokens
+    ) {
+        auto top = std::make_unique<parser>(tokens);
+        top->defer_bodies(skim_braces(tokens));
+        auto root = parse_translation_unit(*top);
+        // what body() asks for is parsed into one more tree
+        std::vector<std::unique_ptr<parser>> parsers;
+        parsers.push_back(std::make_unique<parser>(tokens));
+        return { std::move(top), root, std::move(parsers) };
+    }
+}
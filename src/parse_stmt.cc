@@ -0,0 +1,194 @@
+#include "parse_stmt.hh"
+#include "parse_decl.hh"
+#include "parse_expr.hh"
+
+namespace {
+    using namespace parse;
+
+    // ( expression ) after if, switch and while
+    node_id parse_condition(parser& p) {
+        p.expect(punctuator::paren_left, "(");
+        auto cond = parse_expression(p);
+        p.expect(punctuator::paren_right, ")");
+        return cond;
+    }
+
+    node_id parse_jump(parser& p, token_id kw) {
+        auto label = no_token;
+        if (p.tree().token_at(kw).is(kw_goto)) {
+            if (p.peek().is(token::identifier)) {
+                p.next();
+                label = p.last();
+            } else {
+                p.fail(p.peek().range.first, "expected label name");
+            }
+        }
+        auto semicolon = p.expect(punctuator::semicolon, ";");
+        return p.make<jump_statement_node>(kw, label, semicolon);
+    }
+
+    node_id parse_for(parser& p, token_id kw) {
+        p.expect(punctuator::paren_left, "(");
+        // what the first clause declares is in scope to the end of the
+        // loop body [6.8.5]/5
+        p.push_scope();
+        auto init = no_node;
+        if (p.declaration_ahead() || p.peek().is(kw_Static_assert)) {
+            init = parse_declaration(p);
+        } else {
+            if (!p.peek().is(punctuator::semicolon)) {
+                init = parse_expression(p);
+            }
+            p.expect(punctuator::semicolon, ";");
+        }
+        auto cond = no_node;
+        if (!p.peek().is(punctuator::semicolon)) cond = parse_expression(p);
+        p.expect(punctuator::semicolon, ";");
+        auto step = no_node;
+        if (!p.peek().is(punctuator::paren_right)) {
+            step = parse_expression(p);
+        }
+        p.expect(punctuator::paren_right, ")");
+        auto body = parse_statement(p);
+        p.pop_scope();
+        return p.make<for_statement_node>(kw, init, cond, step, body);
+    }
+
+    // a statement starting with a keyword, or no_node if the keyword does
+    // not start one
+    node_id parse_keyword_statement(parser& p) {
+        const auto& tok = p.peek();
+        switch (tok.kw) {
+            case kw_if: {
+                p.next();
+                const auto kw = p.last();
+                auto cond = parse_condition(p);
+                auto then = parse_statement(p);
+                auto otherwise = no_node;
+                // an else belongs to the nearest if [6.8.4.1]/3
+                if (p.peek().is(kw_else) && !p.recovering()) {
+                    p.next();
+                    otherwise = parse_statement(p);
+                }
+                return p.make<if_statement_node>(kw, cond, then, otherwise);
+            }
+            case kw_switch: {
+                p.next();
+                const auto kw = p.last();
+                auto cond = parse_condition(p);
+                auto body = parse_statement(p);
+                return p.make<switch_statement_node>(kw, cond, body);
+            }
+            case kw_while: {
+                p.next();
+                const auto kw = p.last();
+                auto cond = parse_condition(p);
+                auto body = parse_statement(p);
+                return p.make<while_statement_node>(kw, cond, body);
+            }
+            case kw_do: {
+                p.next();
+                const auto kw = p.last();
+                auto body = parse_statement(p);
+                if (!p.peek().is(kw_while)) {
+                    p.fail(p.peek().range.first, "expected while");
+                }
+                if (!p.recovering()) p.next();
+                auto cond = parse_condition(p);
+                auto semicolon = p.expect(punctuator::semicolon, ";");
+                return p.make<do_statement_node>(kw, body, cond, semicolon);
+            }
+            case kw_for:
+                p.next();
+                return parse_for(p, p.last());
+            case kw_goto:
+            case kw_continue:
+            case kw_break:
+                p.next();
+                return parse_jump(p, p.last());
+            case kw_return: {
+                p.next();
+                const auto kw = p.last();
+                auto value = no_node;
+                if (!p.peek().is(punctuator::semicolon)) {
+                    value = parse_expression(p);
+                }
+                auto semicolon = p.expect(punctuator::semicolon, ";");
+                return p.make<return_statement_node>(kw, value, semicolon);
+            }
+            case kw_case: {
+                p.next();
+                const auto kw = p.last();
+                auto value = parse_expression(p, ep_assignment);
+                p.expect(punctuator::colon, ":");
+                auto stmt = parse_statement(p);
+                return p.make<labeled_statement_node>(kw, value, stmt);
+            }
+            case kw_default: {
+                p.next();
+                const auto kw = p.last();
+                p.expect(punctuator::colon, ":");
+                auto stmt = parse_statement(p);
+                return p.make<labeled_statement_node>(kw, no_node, stmt);
+            }
+            default:
+                return no_node;
+        }
+    }
+
+    // a declaration or a statement [6.8.2]/1
+    node_id parse_block_item(parser& p) {
+        const auto& tok = p.peek();
+        // an identifier followed by : is a label even if it names a type
+        bool is_label = tok.is(token::identifier) &&
+                        p.peek_next().is(punctuator::colon);
+        if (!is_label &&
+            (p.declaration_ahead() || tok.is(kw_Static_assert))) {
+            return parse_declaration(p);
+        }
+        return parse_statement(p);
+    }
+}
+
+namespace parse {
+    node_id parse_statement(parser& p) {
+        if (p.recovering()) {
+            return p.make<error_node>(static_cast<token_id>(p.position()));
+        }
+        const auto& tok = p.peek();
+        if (tok.is(token::keyword)) {
+            auto stmt = parse_keyword_statement(p);
+            if (stmt != no_node) return stmt;
+        } else if (tok.is(punctuator::curly_left)) {
+            return parse_compound_statement(p);
+        } else if (tok.is(token::identifier) &&
+                   p.peek_next().is(punctuator::colon)) {
+            p.next();
+            const auto label = p.last();
+            p.next();
+            auto stmt = parse_statement(p);
+            return p.make<labeled_statement_node>(label, no_node, stmt);
+        }
+        auto expr = no_node;
+        if (!tok.is(punctuator::semicolon)) expr = parse_expression(p);
+        auto semicolon = p.expect(punctuator::semicolon, ";");
+        return p.make<expression_statement_node>(expr, semicolon);
+    }
+
+    node_id parse_compound_statement(parser& p) {
+        p.next();
+        const auto left = p.last();
+        p.push_scope();
+        std::vector<node_id> items;
+        while (!p.peek().is(punctuator::curly_right) && p.has_next_token()) {
+            items.push_back(parse_block_item(p));
+            // the } of this block ends recovery rather than being skipped
+            // as the end of a statement
+            if (p.recovering()) p.synchronize(true);
+        }
+        p.pop_scope();
+        auto right = p.expect(punctuator::curly_right, "}");
+        auto item_list = p.tree().add_list(items);
+        return p.make<compound_statement_node>(left, item_list, right);
+    }
+}
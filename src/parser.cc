@@ -1,7 +1,13 @@
 #include "parser.hh"
+#include "ast_visit.hh"
+#include "context.hh"
+#include "decl_spec.hh"
+#include "declarator.hh"
 #include "diagnostic.hh"
+#include "parse_decl.hh"
 #include "parse_expr.hh"
 
+#include <algorithm>
 #include <cassert>
 #include <climits>
 #include <iostream>
@@ -9,67 +15,118 @@
 using diagnostic::diagnose;
 
 namespace parse {
-    void node::dump(std::size_t indent) const {
-        std::println(stderr, "{}{}", std::string(indent * 4, ' '), get_dump_info());
-        const auto children = this->children();
-        for (auto child : children) {
-            child->dump(indent + 1);
+    loc_range ast::range(node_id id) const {
+        return visit(*this, id, [&](const auto& n) { return n.range(*this); });
+    }
+
+    void ast::dump(node_id id, std::size_t indent) const {
+        visit(*this, id, [&](const auto& n) {
+            std::println(stderr, "{}{}", std::string(indent * 4, ' '),
+                         n.dump_info(*this));
+            n.for_each_child(*this, [&](node_id child) {
+                dump(child, indent + 1);
+            });
+        });
+    }
+
+    id_list ast::add_list(std::span<const std::uint32_t> ids) {
+        id_list result{ static_cast<std::uint32_t>(lists.size()),
+                        static_cast<std::uint32_t>(ids.size()) };
+        lists.insert(lists.end(), ids.begin(), ids.end());
+        return result;
+    }
+
+    void* ast::allocate(std::size_t size, std::size_t align) {
+        block_used = (block_used + align - 1) & ~(align - 1);
+        if (block_used + size > block_size) {
+            assert(size <= block_size);
+            blocks.push_back(std::make_unique<std::byte[]>(block_size));
+            block_used = 0;
         }
+        void* result = blocks.back().get() + block_used;
+        block_used += size;
+        return result;
     }
 
-    node::~node() = default;
+    std::span<const token> token_shapes() {
+        static const raw_buffer buf{"<rules>", " "};
+        static const std::vector<token> shapes = [] {
+            std::vector<token> result;
+            const location loc{buf, 0};
+            const loc_range range{loc, loc};
+            for (std::size_t kind = 0; kind < token_kind_count; ++kind) {
+                auto k = static_cast<token_kind>(kind);
+                if (k == token::punctuator || k == token::keyword) continue;
+                result.emplace_back(k, buf.data(), range);
+            }
+            for (std::size_t i = 0; i < punctuator_count; ++i) {
+                result.emplace_back(token::punctuator, buf.data(), range);
+                result.back().punc = static_cast<punctuator>(i);
+            }
+            for (std::size_t i = 0; i < keyword_count; ++i) {
+                result.emplace_back(token::keyword, buf.data(), range);
+                result.back().kw = static_cast<keyword>(i);
+            }
+            return result;
+        }();
+        return shapes;
+    }
 
-    node_ptr token_rule::parse(parser& p, token tok) const {
-        return std::make_unique<token_node>(std::move(tok));
+    node_id token_rule::parse(parser& p, token_id tok) const {
+        return p.make<token_node>(tok);
     }
 
-    node_ptr unary_prefix_rule::parse(parser& p, token tok) const {
-        return std::make_unique<unary_node>(std::move(tok),
-                                            p.parse(prec),
-                                            true);
+    node_id unary_prefix_rule::parse(parser& p, token_id tok) const {
+        auto operand = p.parse(prec);
+        return p.make<unary_node>(tok, operand, true);
     }
 
-    node_ptr paren_rule::parse(parser& p, token tok) const {
-        assert(tok.is(punctuator::paren_left));
+    node_id paren_rule::parse(parser& p, token_id tok) const {
+        assert(p.tree().token_at(tok).is(punctuator::paren_left));
         if (!p.is_parsing_declarator()) {
             if (!p.could_be_expr_ahead()) {
-                p.push_ruleset(true);
-                auto declarator = p.parse(0);
-                p.pop_ruleset();
-                auto rparen = p.next();
-                assert(rparen.is(punctuator::paren_right)); // TODO error
+                auto type = parse_type_name(p);
+                auto rparen = p.expect(punctuator::paren_right, ")");
+                if (p.peek().is(punctuator::curly_left)) {
+                    auto init = parse_initializer(p);
+                    return p.make<compound_literal_node>(tok, type, init);
+                }
                 auto operand = p.parse(ep_prefix);
-                return std::make_unique<cast_node>(tok, rparen,
-                                                   std::move(declarator),
-                                                   std::move(operand));
+                return p.make<cast_node>(tok, rparen, type, operand);
             }
+        } else if (p.declaration_ahead() ||
+                   p.peek().is(punctuator::paren_right)) {
+            // the parameters of an abstract function declarator, as in
+            // int (int), rather than a grouping
+            p.rewind();
+            return p.make<abstract_placeholder_node>(tok);
         }
         auto body = p.parse(0);
-        auto rparen = p.next();
-        assert(rparen.is(punctuator::paren_right)); // TODO error
-        return std::make_unique<paren_node>(tok, std::move(body), rparen);
+        auto rparen = p.expect(punctuator::paren_right, ")");
+        return p.make<paren_node>(tok, body, rparen);
     }
 
-    node_ptr binary_rule::parse(parser& p, node_ptr left, token tok) const {
+    node_id binary_rule::parse(parser& p, node_id left, token_id tok) const {
         auto rhs_prec = prec;
         if (right_assoc) --rhs_prec;
         auto right = p.parse(rhs_prec);
-        return std::make_unique<binary_node>(tok,
-                                             std::move(left),
-                                             std::move(right));
+        return p.make<binary_node>(tok, left, right);
     }
 
-    node_ptr unary_postfix_rule::parse(parser& p, node_ptr lhs,
-                                       token tok) const {
-        return std::make_unique<unary_node>(tok, std::move(lhs), false);
+    node_id unary_postfix_rule::parse(parser& p, node_id lhs,
+                                      token_id tok) const {
+        return p.make<unary_node>(tok, lhs, false);
     }
 
-    node_ptr call_rule::parse(parser& p, node_ptr lhs, token tok) const {
-        assert(tok.is(punctuator::paren_left));
-        std::vector<node_ptr> args;
+    node_id call_rule::parse(parser& p, node_id lhs, token_id tok) const {
+        assert(p.tree().token_at(tok).is(punctuator::paren_left));
+        std::vector<node_id> args;
         bool allow_arg = true;
         bool require_arg = false;
-        while (!p.peek().is(punctuator::paren_right)) {
+        // parameters are in scope to the end of the declarator
+        const bool is_prototype = p.is_parsing_declarator();
+        if (is_prototype) p.push_scope();
+        while (!p.peek().is(punctuator::paren_right) && !p.recovering()) {
             if (!allow_arg) {
                 diagnose(diagnostic::id::pp7_expected_end_of_list,
                          p.peek().range.first);
@@ -79,16 +136,31 @@ namespace parse {
                 if (p.peek().is(punctuator::ellipsis)) {
                     allow_arg = false;
                     require_arg = false;
-                    args.push_back(std::make_unique<token_node>(p.next()));
+                    p.next();
+                    args.push_back(p.make<token_node>(p.last()));
                     continue;
+                }
+                require_arg = false;
+                const auto start = p.position();
+                if (p.declaration_ahead()) {
+                    auto specs = parse_decl_spec(p).node;
+                    auto declarator = p.parse(0);
+                    args.push_back(p.make<parameter_node>(specs, declarator));
+                    auto name = inspect_declarator(p.tree(), declarator).name;
+                    if (name != no_token) {
+                        p.declare_ordinary(p.tree().token_at(name).spelling);
+                    }
                 } else {
-                    // TODO decl spec + declarator
-                    require_arg = false;
+                    // the identifier list of an old-style definition
                     args.push_back(p.parse(0));
-                    if (p.peek().is(punctuator::comma)) {
-                        require_arg = true;
-                        p.next();
-                    }
+                }
+                if (p.peek().is(punctuator::comma)) {
+                    require_arg = true;
+                    p.next();
+                } else if (p.position() == start) {
+                    // an abstract declarator before something that
+                    // cannot follow it
+                    p.fail(p.peek().range.first, "expected )");
                 }
             } else {
                 require_arg = false;
@@ -99,60 +171,125 @@ namespace parse {
                 }
             }
         }
-        if (require_arg) {
+        if (require_arg && !p.recovering()) {
             diagnose(diagnostic::id::pp7_incomplete_list,
                      p.peek().range.first);
         }
-        auto rparen = p.next();
-        return std::make_unique<call_node>(std::move(lhs),
-                                           tok, rparen,
-                                           std::move(args));
+        if (is_prototype) p.pop_scope();
+        auto rparen = p.expect(punctuator::paren_right, ")");
+        auto arg_list = p.tree().add_list(args);
+        return p.make<call_node>(lhs, tok, rparen, arg_list);
     }
 
-    node_ptr parser::parse(int precedence) {
-        auto tok = next();
-        auto pre_rule = find_rule(tok, rules().prefix_rules);
-        if (!pre_rule) throw parse_error("no rules matched token");
-        auto node = pre_rule->parse(*this, std::move(tok));
+    parser::parser(const std::vector<token>& tokens) :
+    tm{current_context().types()}, first{tokens.data()},
+    cursor{tokens.data()}, last_token{&tokens.back()}, nodes{tokens} {
+        assert(!tokens.empty() && tokens.back().is(token::end_of_input));
+    }
+
+    node_id parser::parse(int precedence) {
+        const auto& tok = peek();
+        auto pre_rule = in_recovery ? nullptr : rules().prefix_rules.find(tok);
+        if (!pre_rule) {
+            if (tok.is(token::end_of_input)) {
+                // an empty input has nowhere to point at
+                std::optional<location> at;
+                if (position()) at = tok.range.first;
+                fail(at, "unexpected end of input");
+            } else if (is_parsing_declarator()) {
+                fail(tok.range.first, "expected declarator");
+            } else {
+                fail(tok.range.first, "expected expression");
+            }
+            return make<error_node>(static_cast<token_id>(position()));
+        }
+        next();
+        auto node = pre_rule->parse(*this, last());
         while (precedence < precedence_peek()) {
-            tok = next();
-            auto in_rule = find_rule(tok, rules().infix_rules);
-            node = in_rule->parse(*this, std::move(node), tok);
+            auto in_rule = rules().infix_rules.find(next());
+            node = in_rule->parse(*this, node, last());
         }
         return node;
     }
 
-    token parser::next() {
-        auto tok = peek();
-        ++next_token;
-        return tok;
+    token_id parser::expect(punctuator punc, std::string_view spelling) {
+        if (in_recovery) return no_token;
+        if (peek().is(punc)) {
+            next();
+            return last();
+        }
+        // recover as if the missing token had been present
+        diagnostic::diagnose_fixit(diagnostic::id::pp7_expected_token,
+                                   peek().range.first, spelling, spelling);
+        return no_token;
     }
 
-    const token& parser::peek() const {
-        if (has_next_token()) return tokens[next_token];
-        else throw parse_error("no more tokens");
+    void parser::fail(std::optional<location> loc,
+                      std::string_view message) {
+        if (in_recovery) return;
+        diagnose(diagnostic::id::pp7_syntax_error, loc, message);
+        in_recovery = true;
+    }
+
+    void parser::synchronize(bool in_braces) {
+        // skip past the next ; or } since that is likely to be followed
+        // by the start of another declaration or statement, treating a
+        // braced group met on the way as a single unit; rules pop
+        // what they push even while recovering, so a struct body or block
+        // nested in a declarator or expression can synchronize too
+        std::size_t depth = 0;
+        while (has_next_token()) {
+            if (peek().is(punctuator::curly_right) && !depth && in_braces) {
+                break;
+            }
+            const auto& tok = next();
+            if (tok.is(punctuator::curly_left)) {
+                ++depth;
+            } else if (tok.is(punctuator::curly_right)) {
+                if (!depth || !--depth) break;
+            } else if (tok.is(punctuator::semicolon) && !depth) {
+                break;
+            }
+        }
+        in_recovery = false;
     }
 
     void parser::rewind() {
-        assert(next_token);
-        --next_token;
+        assert(cursor != first);
+        --cursor;
+    }
+
+    void parser::seek(token_id position) {
+        cursor = first + position;
+        assert(cursor <= last_token);
+        in_recovery = false;
     }
 
-    bool parser::has_next_token() const {
-        return next_token < tokens.size();
+    void parser::defer_bodies(std::vector<brace_span> braces) {
+        skippable = std::move(braces);
+    }
+
+    std::optional<token_id> parser::deferrable_body() const {
+        const auto open = static_cast<token_id>(position());
+        auto it = std::lower_bound(
+            skippable.begin(), skippable.end(), open,
+            [](const brace_span& span, token_id at) { return span.open < at; }
+        );
+        if (it == skippable.end() || it->open != open) return {};
+        return it->close;
     }
 
     const ruleset& parser::rules() const {
         return is_parsing_declarator() ? declarator_ruleset : expr_ruleset;
     }
 
-    bool parser::is_typedef_name(std::string_view name) const {
-        return typedef_names.count(name);
+    void parser::declare_typedef(std::string_view name,
+                                 sem::qual_type ty) {
+        scopes.declare(name, { true, ty, last() });
     }
 
-    const sem::type* parser::get_typedef_type(std::string_view name) const {
-        assert(is_typedef_name(name));
-        return typedef_names.find(name)->second;
+    void parser::declare_ordinary(std::string_view name) {
+        scopes.declare(name, { false, nullptr, last() });
     }
 
     void parser::push_ruleset(bool declarator) {
@@ -165,15 +302,21 @@ namespace parse {
     }
 
     bool parser::could_be_expr_ahead() const {
-        auto tok = peek();
+        const auto& tok = peek();
         if (tok.is(token::identifier)) return !is_typedef_name(tok.spelling);
-        if (tok.is(token::keyword)) return tok.is(kw_sizeof);
+        if (tok.is(token::keyword)) return !is_specifier_qualifier(tok.kw);
         return true;
     }
 
-    int parser::precedence_peek() {
-        if (!has_next_token()) return 0;
-        auto in_rule = find_rule(peek(), rules().infix_rules);
+    bool parser::declaration_ahead() const {
+        const auto& tok = peek();
+        if (tok.is(token::identifier)) return is_typedef_name(tok.spelling);
+        return tok.is(token::keyword) && is_declaration_specifier(tok.kw);
+    }
+
+    int parser::precedence_peek() const {
+        if (in_recovery) return 0;
+        auto in_rule = rules().infix_rules.find(peek());
         return in_rule ? in_rule->precedence() : 0;
     }
 
@@ -0,0 +1,444 @@
+#include "pch.hh"
+#include "diagnostic.hh"
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <system_error>
+#include <type_traits>
+
+using diagnostic::diagnose;
+
+namespace {
+    // All sections are arrays of the records below in native byte order,
+    // located by offsets from the start of the file. Strings are stored
+    // once in a pool, each followed by a newline so that locations in the
+    // pool have sensible line and column numbers.
+    constexpr char magic[8] = { 'S', 'P', 'C', 'C', 'P', 'C', 'H', '1' };
+    constexpr std::uint32_t format_version = 1;
+
+    struct string_ref {
+        std::uint32_t offset; // within the string pool
+        std::uint32_t size;
+    };
+
+    struct section {
+        std::uint32_t offset;
+        std::uint32_t count;
+    };
+
+    struct file_header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t unused;
+        section strings; // bytes
+        section macros;
+        section params;
+        section tokens;
+        section index; // a power of two of slots
+        section files;
+        section once_files;
+        section guards;
+    };
+
+    enum macro_flags : std::uint32_t {
+        function_like = 1,
+        variadic = 2,
+    };
+
+    // the name is also where the definition is located
+    struct macro_record {
+        string_ref name;
+        std::uint32_t flags;
+        std::uint32_t first_param;
+        std::uint32_t param_count;
+        std::uint32_t first_token;
+        std::uint32_t token_count;
+    };
+
+    struct token_record {
+        string_ref spelling;
+        std::uint8_t kind;
+        std::uint8_t punc;
+        std::uint16_t unused;
+    };
+
+    // open addressing with linear probing; macro is its index plus one, or
+    // zero for an empty slot
+    struct index_slot {
+        std::uint32_t hash;
+        std::uint32_t macro;
+    };
+
+    struct file_record {
+        string_ref path;
+        std::int64_t mtime;
+    };
+
+    struct guard_record {
+        string_ref path;
+        string_ref name;
+    };
+
+    std::uint32_t hash_name(std::string_view name) {
+        // FNV-1a
+        std::uint32_t hash = 2166136261u;
+        for (unsigned char c : name) {
+            hash ^= c;
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    std::int64_t to_ticks(std::filesystem::file_time_type t) {
+        return static_cast<std::int64_t>(t.time_since_epoch().count());
+    }
+
+    class pool_buffer : public buffer {
+    public:
+        pool_buffer(std::string name, std::string_view data) :
+        name_(std::move(name)), data_(data) { }
+
+        std::string_view name() const override { return name_; }
+        std::string_view data() const override { return data_; }
+        const buffer* parent() const override { return nullptr; }
+        std::string_view original_data() const override { return data_; }
+        std::size_t offset_in_original(std::size_t offset) const override {
+            return offset;
+        }
+        std::optional<location> included_at() const override { return {}; }
+    private:
+        std::string name_;
+        std::string_view data_;
+    };
+
+    class pch_writer {
+    public:
+        string_ref intern(std::string_view s) {
+            auto it = interned.find(s);
+            if (it != interned.end()) {
+                return { it->second, static_cast<std::uint32_t>(s.size()) };
+            }
+            auto offset = static_cast<std::uint32_t>(strings.size());
+            strings += s;
+            strings += '\n';
+            interned.emplace(std::string(s), offset);
+            return { offset, static_cast<std::uint32_t>(s.size()) };
+        }
+
+        // s as part of the already interned line if it lies within it
+        string_ref place(std::string_view s, std::string_view line,
+                         string_ref line_ref) {
+            std::less<const char*> before;
+            if (!before(s.data(), line.data()) &&
+                !before(line.data() + line.size(), s.data() + s.size())) {
+                auto offset = static_cast<std::uint32_t>(s.data() -
+                                                         line.data());
+                return { line_ref.offset + offset,
+                         static_cast<std::uint32_t>(s.size()) };
+            }
+            return intern(s);
+        }
+
+        void add_macro(const pp::macro& mac) {
+            // the definition's line keeps the name, parameters, and body
+            // together and gives the macro a location
+            auto data = mac.loc.buffer().data();
+            auto offset = mac.loc.offset();
+            auto start = data.rfind('\n', offset);
+            start = start == data.npos ? 0 : start + 1;
+            auto end = data.find('\n', offset);
+            if (end == data.npos) end = data.size();
+            auto line = data.substr(start, end - start);
+            auto line_ref = intern(line);
+
+            macro_record rec{};
+            rec.name = place(mac.name, line, line_ref);
+            if (mac.function_like) rec.flags |= function_like;
+            if (mac.variadic) rec.flags |= variadic;
+            rec.first_param = params.size();
+            rec.param_count = mac.param_names.size();
+            for (auto name : mac.param_names) {
+                params.push_back(place(name, line, line_ref));
+            }
+            rec.first_token = tokens.size();
+            rec.token_count = mac.body.size();
+            for (const auto& tok : mac.body) {
+                token_record tr{};
+                tr.spelling = place(tok.spelling, line, line_ref);
+                tr.kind = tok.kind;
+                if (tok.is(token::punctuator)) {
+                    tr.punc = static_cast<std::uint8_t>(tok.punc);
+                }
+                tokens.push_back(tr);
+            }
+            macros.push_back(rec);
+            hashes.push_back(hash_name(mac.name));
+        }
+
+        void add_state(const pp::pch::contents& state) {
+            for (const auto& [path, mtime] : state.dependencies) {
+                files.push_back({ intern(path.string()), to_ticks(mtime) });
+            }
+            for (const auto& path : state.once_files) {
+                once_files.push_back(intern(path.string()));
+            }
+            for (const auto& [path, name] : state.guards) {
+                guards.push_back({ intern(path.string()), intern(name) });
+            }
+        }
+
+        std::string finish() {
+            std::vector<index_slot> index(
+                std::bit_ceil(std::max<std::size_t>(1, macros.size() * 2))
+            );
+            const auto mask = index.size() - 1;
+            for (std::size_t i = 0; i < macros.size(); ++i) {
+                auto slot = hashes[i] & mask;
+                while (index[slot].macro) slot = (slot + 1) & mask;
+                index[slot] = { hashes[i], static_cast<std::uint32_t>(i + 1) };
+            }
+
+            std::string out(sizeof(file_header), '\0');
+            file_header header{};
+            std::memcpy(header.magic, magic, sizeof(magic));
+            header.version = format_version;
+            header.macros = append(out, macros);
+            header.params = append(out, params);
+            header.tokens = append(out, tokens);
+            header.index = append(out, index);
+            header.files = append(out, files);
+            header.once_files = append(out, once_files);
+            header.guards = append(out, guards);
+            align(out);
+            header.strings = { static_cast<std::uint32_t>(out.size()),
+                               static_cast<std::uint32_t>(strings.size()) };
+            out += strings;
+            std::memcpy(out.data(), &header, sizeof(header));
+            return out;
+        }
+    private:
+        static void align(std::string& out) {
+            out.resize((out.size() + 7) / 8 * 8, '\0');
+        }
+
+        template<typename T>
+        static section append(std::string& out, const std::vector<T>& v) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            align(out);
+            section s{ static_cast<std::uint32_t>(out.size()),
+                       static_cast<std::uint32_t>(v.size()) };
+            out.append(reinterpret_cast<const char*>(v.data()),
+                       v.size() * sizeof(T));
+            return s;
+        }
+
+        std::string strings;
+        std::map<std::string, std::uint32_t, std::less<>> interned;
+        std::vector<macro_record> macros;
+        std::vector<std::uint32_t> hashes;
+        std::vector<string_ref> params;
+        std::vector<token_record> tokens;
+        std::vector<file_record> files;
+        std::vector<string_ref> once_files;
+        std::vector<guard_record> guards;
+    };
+}
+
+struct pp::pch::layout : file_header { };
+
+namespace {
+    template<typename T>
+    bool fits(std::string_view data, section s) {
+        return std::uint64_t(s.offset) + std::uint64_t(s.count) * sizeof(T) <=
+               data.size();
+    }
+
+    // the i-th record of a section, which has been checked to fit
+    template<typename T>
+    T record(std::string_view data, section s, std::size_t i) {
+        T result;
+        std::memcpy(&result, data.data() + s.offset + i * sizeof(T),
+                    sizeof(T));
+        return result;
+    }
+}
+
+bool pp::pch::write(const std::string& path, const contents& state) {
+    pch_writer writer;
+    for (auto mac : state.macros) writer.add_macro(*mac);
+    writer.add_state(state);
+    auto data = writer.finish();
+    std::ofstream file{path, std::ios::binary};
+    file.write(data.data(), data.size());
+    if (!file.good()) {
+        diagnose(diagnostic::id::cannot_open_file, {}, path);
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<const pp::pch> pp::pch::open(const std::string& path) {
+    auto file = platform::mapped_file::open(path);
+    if (!file) {
+        diagnose(diagnostic::id::cannot_open_file, {}, path);
+        return nullptr;
+    }
+    auto data = file->data();
+    auto sections = std::make_unique<layout>();
+    if (data.size() < sizeof(file_header)) {
+        diagnose(diagnostic::id::pch_unusable, {}, path, "file is truncated");
+        return nullptr;
+    }
+    std::memcpy(static_cast<file_header*>(sections.get()), data.data(),
+                sizeof(file_header));
+    const file_header& header = *sections;
+    if (std::memcmp(header.magic, magic, sizeof(magic)) ||
+        header.version != format_version) {
+        diagnose(diagnostic::id::pch_unusable, {}, path,
+                 "not a precompiled header of this version");
+        return nullptr;
+    }
+    if (!fits<char>(data, header.strings) ||
+        !fits<macro_record>(data, header.macros) ||
+        !fits<string_ref>(data, header.params) ||
+        !fits<token_record>(data, header.tokens) ||
+        !fits<index_slot>(data, header.index) ||
+        !std::has_single_bit(header.index.count) ||
+        !fits<file_record>(data, header.files) ||
+        !fits<string_ref>(data, header.once_files) ||
+        !fits<guard_record>(data, header.guards)) {
+        diagnose(diagnostic::id::pch_unusable, {}, path, "file is corrupt");
+        return nullptr;
+    }
+
+    std::shared_ptr<const pch> result{
+        new pch(path, std::move(file), std::move(sections))
+    };
+    // the state is only valid for the files it was computed from
+    auto pool = result->strings->data();
+    for (std::size_t i = 0; i < header.files.count; ++i) {
+        auto rec = record<file_record>(data, header.files, i);
+        if (std::uint64_t(rec.path.offset) + rec.path.size > pool.size()) {
+            diagnose(diagnostic::id::pch_unusable, {}, path,
+                     "file is corrupt");
+            return nullptr;
+        }
+        std::filesystem::path dependency{
+            pool.substr(rec.path.offset, rec.path.size)
+        };
+        std::error_code ec;
+        auto mtime = std::filesystem::last_write_time(dependency, ec);
+        if (ec || to_ticks(mtime) != rec.mtime) {
+            diagnose(diagnostic::id::pch_unusable, {}, path,
+                     "'" + dependency.string() + "' has changed");
+            return nullptr;
+        }
+    }
+    return result;
+}
+
+pp::pch::pch(const std::string& path,
+             std::unique_ptr<platform::mapped_file> file,
+             std::unique_ptr<const layout> sections) :
+file(std::move(file)), sections(std::move(sections)) {
+    auto data = this->file->data();
+    auto pool = data.substr(this->sections->strings.offset,
+                            this->sections->strings.count);
+    strings = std::make_unique<pool_buffer>(path, pool);
+}
+
+pp::pch::~pch() = default;
+
+std::optional<pp::macro> pp::pch::find_macro(std::string_view name) const {
+    const auto data = file->data();
+    const auto pool = strings->data();
+    const auto& header = *sections;
+    // records come from a file that may have been damaged, so a bad
+    // reference makes the macro unknown rather than crashing
+    auto str = [&](string_ref ref) -> std::optional<std::string_view> {
+        if (std::uint64_t(ref.offset) + ref.size > pool.size()) return {};
+        return pool.substr(ref.offset, ref.size);
+    };
+
+    const auto hash = hash_name(name);
+    const auto mask = header.index.count - 1;
+    auto slot_index = hash & mask;
+    for (std::size_t probes = 0; probes < header.index.count; ++probes) {
+        auto slot = record<index_slot>(data, header.index, slot_index);
+        if (!slot.macro || slot.macro > header.macros.count) return {};
+        slot_index = (slot_index + 1) & mask;
+        if (slot.hash != hash) continue;
+        auto rec = record<macro_record>(data, header.macros, slot.macro - 1);
+        auto rec_name = str(rec.name);
+        if (!rec_name || *rec_name != name) continue;
+
+        if (std::uint64_t(rec.first_param) + rec.param_count >
+                header.params.count ||
+            std::uint64_t(rec.first_token) + rec.token_count >
+                header.tokens.count) {
+            return {};
+        }
+        macro mac{*rec_name, location{*strings, rec.name.offset}};
+        mac.function_like = rec.flags & function_like;
+        mac.variadic = rec.flags & variadic;
+        for (std::size_t i = 0; i < rec.param_count; ++i) {
+            auto ref = record<string_ref>(data, header.params,
+                                          rec.first_param + i);
+            auto param = str(ref);
+            if (!param) return {};
+            mac.param_names.push_back(*param);
+        }
+        for (std::size_t i = 0; i < rec.token_count; ++i) {
+            auto tr = record<token_record>(data, header.tokens,
+                                           rec.first_token + i);
+            auto spelling = str(tr.spelling);
+            if (!spelling || tr.kind > token::newline) return {};
+            location first{*strings, tr.spelling.offset};
+            location second{*strings, tr.spelling.offset + tr.spelling.size};
+            token tok{static_cast<token_kind>(tr.kind), *spelling,
+                      { first, second }};
+            if (tok.is(token::punctuator)) {
+                tok.punc = static_cast<punctuator>(tr.punc);
+            }
+            mac.body.push_back(tok);
+        }
+        return mac;
+    }
+    return {};
+}
+
+std::size_t pp::pch::macro_count() const {
+    return sections->macros.count;
+}
+
+std::vector<std::filesystem::path> pp::pch::once_files() const {
+    const auto data = file->data();
+    const auto pool = strings->data();
+    std::vector<std::filesystem::path> result;
+    for (std::size_t i = 0; i < sections->once_files.count; ++i) {
+        auto ref = record<string_ref>(data, sections->once_files, i);
+        if (std::uint64_t(ref.offset) + ref.size > pool.size()) continue;
+        result.emplace_back(pool.substr(ref.offset, ref.size));
+    }
+    return result;
+}
+
+std::map<std::filesystem::path, std::string> pp::pch::guards() const {
+    const auto data = file->data();
+    const auto pool = strings->data();
+    std::map<std::filesystem::path, std::string> result;
+    for (std::size_t i = 0; i < sections->guards.count; ++i) {
+        auto rec = record<guard_record>(data, sections->guards, i);
+        if (std::uint64_t(rec.path.offset) + rec.path.size > pool.size() ||
+            std::uint64_t(rec.name.offset) + rec.name.size > pool.size()) {
+            continue;
+        }
+        result.emplace(pool.substr(rec.path.offset, rec.path.size),
+                       std::string(pool.substr(rec.name.offset,
+                                               rec.name.size)));
+    }
+    return result;
+}
@@ -1,17 +1,107 @@
 #include "platform.hh"
-#include "options.hh"
+#include "context.hh"
 
+#include <cstdlib>
 #include <print>
 
 #if defined(PLATFORM_WIN32)
 #include <io.h>
+#include <windows.h>
 #elif defined(PLATFORM_POSIX)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
+#include <time.h>
 #endif
 
+namespace {
+    thread_local FILE* captured_output = nullptr;
+    thread_local FILE* captured_errors = nullptr;
+
+    bool use_styles(FILE* f) {
+        if (!current_context().options.use_color) return false;
+        if (f == captured_output) return platform::stream::is_terminal(stdout);
+        if (f == captured_errors) return platform::stream::is_terminal(stderr);
+        return platform::stream::is_terminal(f);
+    }
+}
+
+std::chrono::nanoseconds platform::thread_cpu_time() {
+#if defined(PLATFORM_WIN32)
+    FILETIME creation, exit, kernel, user;
+    GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    // FILETIME counts 100 nanosecond intervals
+    return std::chrono::nanoseconds((k.QuadPart + u.QuadPart) * 100);
+#elif defined(PLATFORM_POSIX)
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+#endif
+}
+
+std::unique_ptr<platform::mapped_file> platform::mapped_file::open(
+    const std::string& path) {
+    std::unique_ptr<mapped_file> result{new mapped_file};
+#if defined(PLATFORM_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return nullptr;
+    result->file = file;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) return nullptr;
+    result->size = static_cast<std::size_t>(size.QuadPart);
+    // empty files cannot be mapped
+    if (!result->size) return result;
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY,
+                                        0, 0, nullptr);
+    if (!mapping) return nullptr;
+    result->mapping = mapping;
+    auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) return nullptr;
+    result->address = static_cast<const char*>(view);
+#elif defined(PLATFORM_POSIX)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+        ::close(fd);
+        return nullptr;
+    }
+    result->size = static_cast<std::size_t>(st.st_size);
+    if (result->size) {
+        auto addr = ::mmap(nullptr, result->size, PROT_READ, MAP_PRIVATE,
+                           fd, 0);
+        if (addr == MAP_FAILED) {
+            ::close(fd);
+            return nullptr;
+        }
+        result->address = static_cast<const char*>(addr);
+    }
+    // the mapping stays valid without the descriptor
+    ::close(fd);
+#endif
+    return result;
+}
+
+platform::mapped_file::~mapped_file() {
+#if defined(PLATFORM_WIN32)
+    if (address) UnmapViewOfFile(address);
+    if (mapping) CloseHandle(mapping);
+    if (file) CloseHandle(file);
+#elif defined(PLATFORM_POSIX)
+    if (address) ::munmap(const_cast<char*>(address), size);
+#endif
+}
+
 void platform::stream::set_color(FILE* f, color c) {
-    if (!options::state.use_color) return;
-    if (!is_terminal(f)) return;
+    if (!use_styles(f)) return;
 #if defined(PLATFORM_WIN32)
     // TODO
 #elif defined(PLATFORM_POSIX)
@@ -39,8 +129,7 @@ void platform::stream::set_color(FILE* f, color c) {
 }
 
 void platform::stream::set_style(FILE* f, style s) {
-    if (!options::state.use_color) return;
-    if (!is_terminal(f)) return;
+    if (!use_styles(f)) return;
 #if defined(PLATFORM_WIN32)
     // no styles on Windows
 #elif defined(PLATFORM_POSIX)
@@ -63,3 +152,62 @@ bool platform::stream::is_terminal(FILE* f) {
     return isatty(fileno(f));
 #endif
 }
+
+FILE* platform::stream::output() {
+    return captured_output ? captured_output : stdout;
+}
+
+FILE* platform::stream::errors() {
+    return captured_errors ? captured_errors : stderr;
+}
+
+platform::stream::capture::capture() :
+previous_output{captured_output}, previous_errors{captured_errors} {
+    if (out.file) captured_output = out.file;
+    if (err.file) captured_errors = err.file;
+}
+
+platform::stream::capture::~capture() {
+    captured_output = previous_output;
+    captured_errors = previous_errors;
+}
+
+std::string platform::stream::capture::str() {
+    return out.str();
+}
+
+std::string platform::stream::capture::error_str() {
+    return err.str();
+}
+
+platform::stream::capture::memory_file::memory_file() {
+#if defined(PLATFORM_WIN32)
+    file = std::tmpfile();
+#elif defined(PLATFORM_POSIX)
+    file = open_memstream(&data, &size);
+#endif
+}
+
+platform::stream::capture::memory_file::~memory_file() {
+    if (!file) return;
+    std::fclose(file);
+#if defined(PLATFORM_POSIX)
+    std::free(data);
+#endif
+}
+
+std::string platform::stream::capture::memory_file::str() {
+    if (!file) return {};
+    std::fflush(file);
+#if defined(PLATFORM_WIN32)
+    std::string result;
+    std::rewind(file);
+    char chunk[4096];
+    while (auto n = std::fread(chunk, 1, sizeof(chunk), file)) {
+        result.append(chunk, n);
+    }
+    return result;
+#elif defined(PLATFORM_POSIX)
+    return std::string(data, size);
+#endif
+}
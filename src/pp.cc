@@ -1,7 +1,14 @@
 #include "pp.hh"
 #include "utf8.hh"
 #include "diagnostic.hh"
+#include "context.hh"
+#include "header_cache.hh"
+#include "pch.hh"
+#include "pp_condition.hh"
+#include "include_resolver.hh"
 #include "util.hh"
+#include "stats.hh"
+#include "trace.hh"
 
 #include <algorithm>
 #include <cassert>
@@ -14,7 +21,7 @@
 using diagnostic::diagnose;
 using util::reverse_adaptor;
 
-std::map<std::string, std::string> trigraphs = {
+constexpr std::pair<std::string_view, std::string_view> trigraphs[] = {
     { R"(??=)", "#" },
     { R"(??()", "[" },
     { R"(??/)", "\\" },
@@ -27,6 +34,7 @@ std::map<std::string, std::string> trigraphs = {
 };
 
 std::unique_ptr<buffer> pp::perform_phase_one(std::unique_ptr<buffer> in) {
+    stats::phase_timer timer{stats::phase::one};
     /* [5.1.1.2]/1.1
      Physical source file multibyte characters are mapped, in an
      implementation-defined manner, to the source character set
@@ -57,10 +65,16 @@ std::unique_ptr<buffer> pp::perform_phase_one(std::unique_ptr<buffer> in) {
         }
         // replace trigraph sequences with corresponding single-character
         // internal representations
-        auto trigraph = trigraphs.find(std::string(out->peek().substr(0, 3)));
-        if (trigraph != trigraphs.end()) {
-            out->replace(3, trigraph->second);
-            continue;
+        if (out->peek().starts_with("??")) {
+            auto seq = out->peek().substr(0, 3);
+            auto trigraph = std::find_if(
+                std::begin(trigraphs), std::end(trigraphs),
+                [&](const auto& t) { return t.first == seq; }
+            );
+            if (trigraph != std::end(trigraphs)) {
+                out->replace(3, trigraph->second);
+                continue;
+            }
         }
 
         out->propagate(1);
@@ -69,6 +83,7 @@ std::unique_ptr<buffer> pp::perform_phase_one(std::unique_ptr<buffer> in) {
 }
 
 std::unique_ptr<buffer> pp::perform_phase_two(std::unique_ptr<buffer> in) {
+    stats::phase_timer timer{stats::phase::two};
     /* [5.1.1.2]/1.2
      Each instance of a backslash character (\) immediately followed
      by a new-line character is deleted, splicing physical source lines
@@ -159,22 +174,23 @@ std::optional<token> pp::lexer::try_lex(token_kind kind, const std::regex& regex
     else return {};
 }
 
-static std::map<token_kind, const std::regex*> pp_token_patterns = {
+constexpr std::pair<token_kind, const std::regex*> pp_token_patterns[] = {
     { token::header_name, &pp::regex::header_name },
-    { token::pp_number, &pp::regex::pp_number },
     { token::identifier, &pp::regex::identifier },
-    { token::string_literal, &pp::regex::string_literal },
+    { token::pp_number, &pp::regex::pp_number },
     { token::character_constant, &pp::regex::char_constant },
+    { token::string_literal, &pp::regex::string_literal },
     { token::punctuator, &pp::regex::punctuator },
     { token::space, &pp::regex::space },
     { token::newline, &pp::regex::newline },
 };
 
-static std::vector<std::string> header_name_undef_seqs = {
+constexpr std::string_view header_name_undef_seqs[] = {
     "'", "\"", "\\", "//", "/*"
 };
 
 std::vector<token> pp::perform_phase_three(const buffer& in) {
+    stats::phase_timer timer{stats::phase::three};
     lexer lexer{in};
     while (!lexer.done()) {
         /* [6.4]/4
@@ -223,9 +239,9 @@ std::vector<token> pp::perform_phase_three(const buffer& in) {
         // clean up and diagnose chosen token
         auto tok = lexes[0];
         if (tok.is(token::punctuator)) {
-            auto it = punctuator_table.find(std::string(tok.spelling));
-            assert(it != punctuator_table.end()); // table doesn't match regex
-            tok.punc = it->second;
+            auto punc = find_punctuator(tok.spelling);
+            assert(punc); // table doesn't match regex
+            tok.punc = *punc;
         } else if (tok.is(token::space)) {
             if (tok.spelling.starts_with("/*")) {
                 if (!tok.spelling.ends_with("*/")) {
@@ -249,13 +265,14 @@ std::vector<token> pp::perform_phase_three(const buffer& in) {
                     auto quote = seq == "'" ? "\"" : "'";
                     location loc = tok.range.first.next_loc(pos + 1);
                     diagnose(diagnostic::id::pp3_undef_char_in_hdr_name,
-                             loc, quote + seq + quote);
+                             loc, quote + std::string(seq) + quote);
                 }
             }
         }
 
         lexer.select(tok);
     }
+    stats::count(stats::counter::tokens_lexed, lexer.tokens.size());
     return std::move(lexer.tokens);
 }
 
@@ -306,30 +323,65 @@ void p4m::finish_directive_line(token name) {
     }
 }
 
-void p4m::maybe_diagnose_macro_redefinition(const macro& def) const {
-    auto old = macros.find(def.name);
-    if (old == macros.end()) return;
+pp::macro* p4m::find_macro(std::string_view name) {
+    if (lookup_log) lookup_log->push_back(name);
+    auto it = macros.find(name);
+    if (it != macros.end()) return &it->second;
+    if (!prefix || undefined_prefix_macros.count(name)) return nullptr;
+    auto mac = prefix->find_macro(name);
+    if (!mac) return nullptr;
+    // keyed by the name in the mapped file, which outlives the entry
+    auto key = mac->name;
+    return &macros.insert({ key, std::move(*mac) }).first->second;
+}
+
+void p4m::use_pch(std::shared_ptr<const pch> prefix) {
+    for (auto& path : prefix->once_files()) once_files.insert(path);
+    known_guards = prefix->guards();
+    this->prefix = std::move(prefix);
+}
+
+bool p4m::write_pch(const std::string& path) const {
+    assert(!prefix && "cannot save state that came from a prefix");
+    pch::contents state;
+    for (const auto& [name, mac] : macros) {
+        if (!mac.predefined) state.macros.push_back(&mac);
+    }
+    state.once_files = once_files;
+    state.guards = known_guards;
+    state.dependencies = dependencies;
+    auto main_file = header_key(std::string(buf->name()));
+    std::error_code ec;
+    auto mtime = std::filesystem::last_write_time(main_file, ec);
+    // unless the input did not come from a file
+    if (!ec) state.dependencies[main_file] = mtime;
+    return pch::write(path, state);
+}
+
+void p4m::maybe_diagnose_macro_redefinition(const macro& def) {
+    auto old = find_macro(def.name);
+    if (!old) return;
     bool bad = false;
-    if (def.function_like != old->second.function_like) bad = true;
-    if (def.variadic != old->second.variadic) bad = true;
+    if (def.function_like != old->function_like) bad = true;
+    if (def.variadic != old->variadic) bad = true;
     // TODO ignore whitespace differences [6.10.3]/1
-    if (def.body.size() != old->second.body.size()) bad = true;
+    if (def.body.size() != old->body.size()) bad = true;
     for (std::size_t i = 0; i < def.body.size(); ++i) {
-        if (def.body[i].spelling != old->second.body[i].spelling) {
+        if (def.body[i].spelling != old->body[i].spelling) {
             bad = true;
             break;
         }
     }
-    if (def.param_names.size() != old->second.param_names.size()) bad = true;
+    if (def.param_names.size() != old->param_names.size()) bad = true;
     for (std::size_t i = 0; i < def.param_names.size(); ++i) {
-        if (def.param_names[i] != old->second.param_names[i]) {
+        if (def.param_names[i] != old->param_names[i]) {
             bad = true;
             break;
         }
     }
     if (bad) {
         diagnose(diagnostic::id::pp4_macro_redef, def.loc, def.name);
-        diagnose(diagnostic::id::aux_previous_def, old->second.loc);
+        diagnose(diagnostic::id::aux_previous_def, old->loc);
     }
 }
 
@@ -337,9 +389,9 @@ std::optional<std::vector<token>> p4m::maybe_expand_macro() {
     auto next = peek(SKIP, SKIP);
     if (!next || !next->is(token::identifier) || next->blue) return {};
     auto loc = next->range.first;
-    auto it = macros.find(next->spelling);
-    if (it == macros.end()) return {};
-    auto& mac = it->second;
+    auto found = find_macro(next->spelling);
+    if (!found) return {};
+    auto& mac = *found;
     std::size_t rewind_point = *find(SKIP, SKIP);
     auto& original_token = tokens[rewind_point];
     const auto pre_name_index = index;
@@ -445,6 +497,8 @@ std::optional<std::vector<token>> p4m::maybe_expand_macro() {
             }
             return {};
         };
+        auto& expansions = current_context().expansions;
+        const auto id = expansions.record(loc, mac.loc);
         std::vector<token> expansion;
         hijack();
         tokens = mac.body;
@@ -467,6 +521,17 @@ std::optional<std::vector<token>> p4m::maybe_expand_macro() {
                     }
                     std::vector<token> arg;
                     if (*index < args.size()) arg = args[*index];
+                    if (!arg.empty()) {
+                        // the argument came by way of the parameter it
+                        // replaces, so macros expanded within it show
+                        // this expansion among their history too
+                        auto param = tok.range.first;
+                        param.set_expansion(id);
+                        const auto via = expansions.record(param, mac.loc);
+                        for (auto& arg_tok : arg) {
+                            arg_tok.range.first.set_expansion(via);
+                        }
+                    }
                     if (should_replace) {
                         hijack();
                         tokens = std::move(arg);
@@ -474,13 +539,6 @@ std::optional<std::vector<token>> p4m::maybe_expand_macro() {
                         unhijack();
                         arg = std::move(expansion);
                     }
-                    for (auto& arg_tok : arg) {
-                        const auto loc = tok.range.first;
-                        arg_tok.range.first.add_expansion_entry(loc);
-                        if (tok.is(punctuator::hash_hash)) {
-                            tok.blue = true;
-                        }
-                    }
                     expansion.insert(expansion.end(),
                                      arg.begin(), arg.end());
                     if (arg.empty()) {
@@ -553,6 +611,7 @@ std::optional<std::vector<token>> p4m::maybe_expand_macro() {
         unhijack();
         expansion = handle_concatenation(std::move(expansion));
         remove_placemarkers(expansion);
+        mark_expansion(expansion, id);
         return expansion;
     } else {
         if (mac.being_replaced) {
@@ -567,13 +626,20 @@ std::optional<std::vector<token>> p4m::maybe_expand_macro() {
         }
         std::vector<token> expansion = handle_concatenation(mac.body);
         remove_placemarkers(expansion);
-        for (auto& arg : expansion) {
-            arg.range.first.add_expansion_entry(loc);
-        }
+        mark_expansion(expansion,
+                       current_context().expansions.record(loc, mac.loc));
         return expansion;
     }
 }
 
+void p4m::mark_expansion(std::vector<token>& expansion, expansion_id id) {
+    // tokens that already carry history (e.g. from an argument) keep it
+    // since it is more specific than this expansion and leads back to it
+    for (auto& tok : expansion) {
+        if (!tok.range.first.expansion()) tok.range.first.set_expansion(id);
+    }
+}
+
 std::vector<token> p4m::handle_concatenation(std::vector<token> in) {
     std::vector<token> result;
     hijack();
@@ -728,11 +794,22 @@ token p4m::make_line_token(token at) {
     return tokens[0];
 }
 
+void p4m::skip_disabled_group(std::size_t hash_index) {
+    if (!in_disabled_region()) return;
+    const auto& map = include_stack.empty()
+                    ? main_conditionals
+                    : *include_stack.back().conditionals;
+    auto it = map.find(tokens[hash_index].spelling.data());
+    if (it == map.end()) return;
+    // straight to the directive that ends the group; nothing in between
+    // has been touched, so the distance still holds
+    auto target = hash_index + it->second;
+    assert(target >= index && tokens[target].is(punctuator::hash));
+    index = target;
+}
+
 bool p4m::in_disabled_region() const {
-    for (auto state : cond_states) {
-        if (!state) return true;
-    }
-    return false;
+    return !cond_states.empty() && !cond_states.back().enabled;
 }
 
 void p4m::handle_null_directive() {
@@ -753,9 +830,27 @@ void p4m::handle_error_directive() {
 }
 
 void p4m::handle_pragma_directive() {
+    // just past the #
+    const auto start = index;
     auto pragma_tok = *get(SKIP, STOP);
     const auto loc = pragma_tok.range.first;
     auto next = get(SKIP, STOP);
+    if (next && next->spelling == "once") {
+        // has no effect in the main file
+        if (!include_stack.empty()) {
+            once_files.insert(include_stack.back().key);
+        }
+        finish_directive_line(pragma_tok);
+        return;
+    }
+    if (current_context().options.preprocess_only) {
+        // the pragma is for whatever compiles the output, which needs it
+        // on a line of its own, newline included
+        (void)finish_line();
+        out.insert(out.end(), tokens.begin() + start - 1,
+                   tokens.begin() + index);
+        return;
+    }
     if (next && next->spelling == "STDC") {
         diagnose(diagnostic::id::not_yet_implemented, loc, "#pragma STDC");
     } else {
@@ -854,15 +949,13 @@ void p4m::handle_define_directive() {
         }
     }
     mac.body = finish_line();
-    auto it = macros.find(mac.name);
-    if (it != macros.end()) {
-        if (it->second.predefined) {
-            diagnose(diagnostic::id::pp4_cannot_use_predef_macro_here,
-                     loc, it->second.name);
-            return;
-        }
+    if (auto old = find_macro(mac.name); old && old->predefined) {
+        diagnose(diagnostic::id::pp4_cannot_use_predef_macro_here,
+                 loc, old->name);
+        return;
     }
     maybe_diagnose_macro_redefinition(mac);
+    note_macro_change(mac.name);
     macros.insert({ mac.name, std::move(mac) });
 }
 
@@ -885,6 +978,8 @@ void p4m::handle_undef_directive() {
         }
     }
     macros.erase(name->spelling);
+    if (prefix) undefined_prefix_macros.insert(name->spelling);
+    note_macro_change(name->spelling);
     finish_directive_line(undef_tok);
 }
 
@@ -902,26 +997,57 @@ void p4m::handle_include_directive() {
         auto hn = get(SKIP, STOP);
         finish_directive_line(include_tok);
         auto fname = hn->spelling.substr(1, hn->spelling.size() - 2);
-        std::ifstream file{std::string(fname)};
-        if (!file.good()) {
+        trace::span span{"include", fname, true};
+        /* [6.10.2]/2-3 */
+        const bool angled = hn->spelling.front() == '<';
+        const auto& includer = include_stack.empty()
+                               ? std::string(buf->name())
+                               : include_stack.back().path;
+        auto includer_dir = std::filesystem::path(includer).parent_path();
+        auto path = includes.resolve(fname, angled, includer_dir.string());
+        if (!path) {
+            diagnose(diagnostic::id::cannot_open_file, {}, fname);
+            return;
+        }
+        auto key = header_key(*path);
+        if (once_files.count(key)) {
+            stats::count(stats::counter::includes_processed);
+            return;
+        }
+        // a header seen before is skipped without even looking at it
+        auto known = known_guards.find(key);
+        if (known != known_guards.end() && find_macro(known->second)) {
+            stats::count(stats::counter::includes_processed);
+            stats::count(stats::counter::include_guard_skips);
+            return;
+        }
+        auto header = headers.load(*path, key, loc);
+        if (!header) {
             diagnose(diagnostic::id::cannot_open_file, {}, fname);
             return;
         }
-        std::stringstream ss;
-        ss << file.rdbuf();
-        auto data = ss.str();
-        ss.clear();
-
-        auto buf = std::make_unique<raw_buffer>(std::string(fname), data);
-        buf->mark_included_at(include_tok.range.first);
-        auto post_p1 = pp::perform_phase_one(std::move(buf));
-        auto post_p2 = pp::perform_phase_two(std::move(post_p1));
-        auto tokens = pp::perform_phase_three(*post_p2);
-        extra_buffers.push_back(std::move(post_p2));
+        stats::count(stats::counter::includes_processed);
+        if (dependencies.emplace(key, header->mtime).second) {
+            included_paths.push_back(*path);
+        }
+        if (header->guard) {
+            known_guards[key] = *header->guard;
+            if (find_macro(*header->guard)) {
+                // the whole file is skipped, there is nothing to process
+                stats::count(stats::counter::include_guard_skips);
+                return;
+            }
+        }
+
+        auto buf = std::make_unique<included_buffer>(header->buf, loc);
+        auto tokens = rebase_tokens(*header, *buf);
+        extra_buffers.push_back(std::move(buf));
         hijack();
         this->tokens = std::move(tokens);
         ++include_level;
+        include_stack.push_back({ key, *path, &header->conditionals });
         auto included_tokens = process();
+        include_stack.pop_back();
         --include_level;
         unhijack();
         out.insert(out.end(), included_tokens.begin(), included_tokens.end());
@@ -945,39 +1071,71 @@ void p4m::handle_ifndef_directive() {
 
 void p4m::handle_ifdef_ifndef(token tok, bool is_ifndef) {
     const auto loc = tok.range.first;
-    if (cond_states.size() == 63) {
-        diagnose(diagnostic::id::translation_limit_exceeded, loc,
-                 "63", "nested preprocessor conditionals");
-    }
     if (in_disabled_region()) {
-        cond_states.push_back(false);
+        push_conditional(loc, false);
         finish_line();
     } else {
         auto name = get(SKIP, STOP);
         if (!name || !name->is(token::identifier)) {
             diagnose(diagnostic::id::pp4_expected_macro_name, loc);
             (void)finish_line();
-            cond_states.push_back(false); // recover
+            push_conditional(loc, false); // recover
             return;
         }
-        auto it = macros.find(name->spelling);
-        bool result = it != macros.end();
+        bool result = find_macro(name->spelling);
         if (is_ifndef) result = !result;
-        cond_states.push_back(result);
+        push_conditional(loc, result);
         finish_directive_line(tok);
     }
 }
 
+void p4m::handle_if_directive() {
+    auto if_tok = *get(SKIP, STOP);
+    const auto loc = if_tok.range.first;
+    if (in_disabled_region()) {
+        push_conditional(loc, false);
+        finish_line();
+    } else push_conditional(loc, evaluate_condition_line(if_tok));
+}
+
+void p4m::handle_elif_directive() {
+    auto elif_tok = *get(SKIP, STOP);
+    const auto loc = elif_tok.range.first;
+    if (cond_states.empty() || cond_states.back().had_else) {
+        diagnose(diagnostic::id::pp4_mismatched_cond_directive, loc,
+                 elif_tok.spelling);
+        finish_line();
+        return;
+    }
+    /* [6.10.1]/6
+     ... Only the first group whose control condition evaluates to true
+     (nonzero) is processed; any following groups are skipped and their
+     controlling directives are processed as if they were in a group
+     that is skipped.
+    */
+    if (cond_states.back().taken) {
+        cond_states.back().enabled = false;
+        finish_line();
+        return;
+    }
+    bool result = evaluate_condition_line(elif_tok);
+    cond_states.back().enabled = result;
+    cond_states.back().taken = result;
+}
+
 void p4m::handle_else_directive() {
     auto else_tok = *get(SKIP, STOP);
     const auto loc = else_tok.range.first;
-    if (cond_states.empty()) {
+    if (cond_states.empty() || cond_states.back().had_else) {
         diagnose(diagnostic::id::pp4_mismatched_cond_directive, loc,
                  else_tok.spelling);
         finish_line();
         return;
     }
-    cond_states.back() = !cond_states.back();
+    auto& state = cond_states.back();
+    state.enabled = !state.taken;
+    state.taken = true;
+    state.had_else = true;
     finish_directive_line(else_tok);
 }
 
@@ -994,6 +1152,116 @@ void p4m::handle_endif_directive() {
     finish_directive_line(endif_tok);
 }
 
+void p4m::push_conditional(location loc, bool enabled) {
+    if (cond_states.size() == 63) {
+        diagnose(diagnostic::id::translation_limit_exceeded, loc,
+                 "63", "nested preprocessor conditionals");
+    }
+    // none of the groups of a conditional inside a skipped group is
+    // processed
+    bool skipped = in_disabled_region();
+    cond_states.push_back({ enabled && !skipped, enabled || skipped, false });
+}
+
+bool p4m::evaluate_condition_line(token directive) {
+    auto line = finish_line();
+    condition_key.clear();
+    for (const auto& tok : line) {
+        condition_key += tok.is(token::space) ? " " : tok.spelling;
+    }
+    auto cached = condition_cache.find(condition_key);
+    if (cached != condition_cache.end() && is_current(cached->second)) {
+        stats::count(stats::counter::conditions_cached);
+        return cached->second.result;
+    }
+    stats::count(stats::counter::conditions_evaluated);
+    // everything the result depends on: the names in the line and every
+    // name looked up while expanding it, which takes in the replacement
+    // lists of the macros it expands and identifiers made by ##
+    std::vector<std::string_view> names;
+    for (const auto& tok : line) {
+        if (tok.is(token::identifier)) names.push_back(tok.spelling);
+    }
+    /* [6.10.1]/4
+     Prior to evaluation, macro invocations in the list of preprocessing
+     tokens that will become the controlling constant expression are
+     replaced (except for those macro names modified by the defined unary
+     operator), just as in normal text.
+    */
+    std::vector<token> replaced;
+    replaced.reserve(line.size());
+    auto skip_space = [&](std::size_t i) {
+        while (i < line.size() && line[i].is(token::space)) ++i;
+        return i;
+    };
+    for (std::size_t i = 0; i < line.size(); ++i) {
+        if (!line[i].is(token::identifier) || line[i].spelling != "defined") {
+            replaced.push_back(line[i]);
+            continue;
+        }
+        /* [6.10.1]/1 defined identifier, or defined ( identifier ) */
+        auto j = skip_space(i + 1);
+        bool paren = j < line.size() && line[j].is(punctuator::paren_left);
+        if (paren) j = skip_space(j + 1);
+        if (j == line.size() || !line[j].is(token::identifier)) {
+            diagnose(diagnostic::id::pp4_expected_macro_name,
+                     line[i].range.first);
+            return false;
+        }
+        bool result = find_macro(line[j].spelling);
+        if (paren) {
+            j = skip_space(j + 1);
+            if (j == line.size() || !line[j].is(punctuator::paren_right)) {
+                diagnose(diagnostic::id::pp4_invalid_condition,
+                         line[i].range.first, directive.spelling,
+                         "expected ')' after defined");
+                return false;
+            }
+        }
+        replaced.emplace_back(token::pp_number, result ? "1" : "0",
+                              line[i].range);
+        i = j;
+    }
+    lookup_log = &names;
+    hijack();
+    tokens = std::move(replaced);
+    auto expanded = process(true);
+    unhijack();
+    lookup_log = nullptr;
+    auto value = pp::evaluate_condition(expanded, directive);
+    if (!value) return false; // diagnosed again if it comes up again
+    bool result = value->bits != 0;
+    std::ranges::sort(names);
+    names.erase(std::ranges::unique(names).begin(), names.end());
+    for (auto name : names) {
+        // __LINE__ and __FILE__ differ from one place to the next
+        if (name != "__LINE__" && name != "__FILE__") continue;
+        if (auto mac = find_macro(name); mac && mac->predefined) {
+            return result;
+        }
+    }
+    condition_cache.insert_or_assign(
+        condition_key,
+        cached_condition{ result, macro_generation, std::move(names) }
+    );
+    return result;
+}
+
+bool p4m::is_current(const cached_condition& entry) const {
+    if (entry.stamp == macro_generation) return true;
+    for (auto name : entry.names) {
+        auto it = macro_versions.find(name);
+        if (it != macro_versions.end() && it->second > entry.stamp) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void p4m::note_macro_change(std::string_view name) {
+    macro_versions[name] = ++macro_generation;
+}
+
 void p4m::handle_non_directive() {
     auto tok = *get(SKIP, STOP);
     diagnose(diagnostic::id::pp4_non_directive_ignored, tok.range.first);
@@ -1001,26 +1269,47 @@ void p4m::handle_non_directive() {
 }
 
 std::vector<token> p4m::process(bool in_arg) {
+    // only the outermost call is timed; those for an #include or a macro
+    // argument are part of it
+    std::optional<stats::phase_timer> timer;
+    if (!in_arg && include_level == 0) timer.emplace(stats::phase::four);
     bool allow_directive = !in_arg;
     std::map<std::string_view, std::size_t> exp_end;
+    // covers a top-level expansion until its rescanning has finished
+    std::optional<trace::span> expansion_span;
     while (index < tokens.size()) {
         auto next = *peek(TAKE, TAKE);
         if (next.is(token::newline)) {
             out.push_back(*get(STOP, TAKE));
             allow_directive = true;
             continue;
+        } else if (!in_arg && in_disabled_region() &&
+                   !(next.is(punctuator::hash) && allow_directive)) {
+            /* [6.10.1]/6
+             ... directives are processed only through the name that
+             determines the directive in order to keep track of the level
+             of nested conditionals; the rest of the directives'
+             preprocessing tokens are ignored, as are the other
+             preprocessing tokens in the group.
+            */
+            (void)get(TAKE, TAKE);
+            if (!next.is(token::space)) allow_directive = false;
+            continue;
         } else if (next.is(token::space)) {
             out.push_back(*get(TAKE, STOP));
             continue;
         } else if (next.is(punctuator::hash) && allow_directive) {
+            const auto hash_index = index;
             (void)get(SKIP, TAKE);
             auto id = peek(SKIP, STOP);
 
             if (in_disabled_region()) {
                 if (id) {
                     bool exempt = false;
+                    exempt |= id->spelling == "if";
                     exempt |= id->spelling == "ifdef";
                     exempt |= id->spelling == "ifndef";
+                    exempt |= id->spelling == "elif";
                     exempt |= id->spelling == "else";
                     exempt |= id->spelling == "endif";
                     if (!exempt) {
@@ -1044,10 +1333,14 @@ std::vector<token> p4m::process(bool in_arg) {
                 handle_undef_directive();
             } else if (id->spelling == "include") {
                 handle_include_directive();
+            } else if (id->spelling == "if") {
+                handle_if_directive();
             } else if (id->spelling == "ifdef") {
                 handle_ifdef_directive();
             } else if (id->spelling == "ifndef") {
                 handle_ifndef_directive();
+            } else if (id->spelling == "elif") {
+                handle_elif_directive();
             } else if (id->spelling == "else") {
                 handle_else_directive();
             } else if (id->spelling == "endif") {
@@ -1055,6 +1348,7 @@ std::vector<token> p4m::process(bool in_arg) {
             } else {
                 handle_non_directive();
             }
+            skip_disabled_group(hash_index);
         } else {
             allow_directive = false;
             for (auto it = exp_end.begin(); it != exp_end.end();) {
@@ -1063,10 +1357,17 @@ std::vector<token> p4m::process(bool in_arg) {
                     it = exp_end.erase(it);
                 } else ++it;
             }
+            if (exp_end.empty()) expansion_span.reset();
             auto old_index = index;
             auto invocation_start = tokens.begin() + index;
             auto old_id = peek(SKIP, SKIP);
+            if (!in_arg && exp_end.empty() && trace::enabled()) {
+                if (old_id && find_macro(old_id->spelling)) {
+                    expansion_span.emplace("macro", old_id->spelling);
+                }
+            }
             if (auto exp = maybe_expand_macro()) {
+                stats::count(stats::counter::macros_expanded);
                 auto invocation_end = tokens.begin() + index;
                 tokens.erase(invocation_start, invocation_end);
                 tokens.insert(invocation_start, exp->begin(), exp->end());
@@ -1080,6 +1381,7 @@ std::vector<token> p4m::process(bool in_arg) {
                 mac.being_replaced = true;
                 exp_end[mac.name] = index + exp->size();
             } else {
+                if (exp_end.empty()) expansion_span.reset();
                 out.push_back(*get(TAKE, TAKE));
             }
         }
@@ -1097,6 +1399,9 @@ std::optional<token> pp::convert_pp_token_to_token(token tok) {
         case token::integer_constant:
             assert(!"not a preprocessing token");
             return tok;
+        case token::end_of_input:
+            assert(!"the end of input is added by phase 7");
+            return tok;
         case token::placemarker:
         case token::header_name:
             assert(!"cannot convert internal preprocessing token");
@@ -1116,10 +1421,9 @@ std::optional<token> pp::convert_pp_token_to_token(token tok) {
                          tok.range.first);
                 return {};
             }
-            auto it = keyword_table.find(std::string(tok.spelling));
-            if (it != keyword_table.end()) {
+            if (auto kw = find_keyword(tok.spelling)) {
                 tok.kind = token::keyword;
-                tok.kw = it->second;
+                tok.kw = *kw;
             }
             return tok;
         }
@@ -1182,6 +1486,7 @@ std::string pp::to_string(string_literal_encoding enc) {
 
 std::vector<token> pp::perform_phase_six(std::vector<token> tokens,
                                          buffer_ptrs& extra) {
+    stats::phase_timer timer{stats::phase::six};
     std::vector<token> result;
     for (std::size_t i = 0; i < tokens.size(); ++i) {
         if (tokens[i].is(token::string_literal)) {
@@ -1242,10 +1547,16 @@ std::vector<token> pp::perform_phase_six(std::vector<token> tokens,
 }
 
 std::vector<token> pp::perform_phase_seven(const std::vector<token>& tokens) {
+    stats::phase_timer timer{stats::phase::seven};
     std::vector<token> result;
     for (const auto& tok : tokens) {
         auto converted = convert_pp_token_to_token(tok);
         if (converted) result.push_back(std::move(*converted));
     }
+    static const raw_buffer nothing{"<end of input>", ""};
+    auto end = result.empty() ? location{nothing, 0}
+                              : result.back().range.second;
+    result.emplace_back(token::end_of_input, std::string_view{},
+                        loc_range{end, end});
     return result;
 }
@@ -0,0 +1,467 @@
+#include "pp_condition.hh"
+#include "context.hh"
+#include "diagnostic.hh"
+
+#include <limits>
+#include <string_view>
+
+using diagnostic::diagnose;
+using value = pp::condition_value;
+
+namespace {
+    constexpr std::uintmax_t intmax_sign =
+        std::uintmax_t(1) << (std::numeric_limits<std::uintmax_t>::digits - 1);
+
+    bool is_negative(value v) {
+        return !v.is_unsigned && (v.bits & intmax_sign);
+    }
+
+    value make_bool(bool b) {
+        return { b ? 1u : 0u, false };
+    }
+
+    // 0 for the operators that are not binary in a #if
+    int binary_precedence(const token& tok) {
+        if (!tok.is(token::punctuator)) return 0;
+        switch (tok.punc) {
+            case punctuator::star:
+            case punctuator::slash_forward:
+            case punctuator::percent: return 10;
+            case punctuator::plus:
+            case punctuator::minus: return 9;
+            case punctuator::less_less:
+            case punctuator::greater_greater: return 8;
+            case punctuator::less:
+            case punctuator::greater:
+            case punctuator::less_equal:
+            case punctuator::greater_equal: return 7;
+            case punctuator::equal_equal:
+            case punctuator::bang_equal: return 6;
+            case punctuator::ampersand: return 5;
+            case punctuator::caret: return 4;
+            case punctuator::pipe: return 3;
+            case punctuator::ampersand_ampersand: return 2;
+            case punctuator::pipe_pipe: return 1;
+            default: return 0;
+        }
+    }
+
+    int digit_value(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return 16;
+    }
+
+    // Recursive descent over the token span. The tokens are only looked
+    // at, never copied, and a value is two words, so nothing here touches
+    // the heap. Operands that are not evaluated ([6.5.13]/4, [6.5.14]/4,
+    // [6.5.15]/4) are still parsed, but with live false, which keeps
+    // division by zero in them from being an error.
+    class evaluator {
+    public:
+        evaluator(std::span<const token> tokens, const token& directive) :
+        tokens(tokens), directive(directive) { }
+
+        std::optional<value> run() {
+            skip_space();
+            if (pos == tokens.size()) {
+                fail(directive, "no expression");
+                return {};
+            }
+            auto result = comma(true);
+            if (!failed && pos != tokens.size()) {
+                fail(tokens[pos], "missing binary operator");
+            }
+            if (failed) return {};
+            return result;
+        }
+    private:
+        void skip_space() {
+            while (pos < tokens.size() && tokens[pos].is(token::space)) ++pos;
+        }
+
+        const token* peek() {
+            skip_space();
+            return pos < tokens.size() ? &tokens[pos] : nullptr;
+        }
+
+        bool accept(punctuator punc) {
+            auto tok = peek();
+            if (!tok || !tok->is(punc)) return false;
+            ++pos;
+            return true;
+        }
+
+        // only the first error is diagnosed, the rest follow from it
+        value fail(const token& at, std::string_view why) {
+            if (!failed) {
+                diagnose(diagnostic::id::pp4_invalid_condition,
+                         at.range.first, directive.spelling, why);
+            }
+            failed = true;
+            pos = tokens.size();
+            return {};
+        }
+
+        /* [6.6]/3
+         Constant expressions shall not contain assignment, increment,
+         decrement, function-call, or comma operators, except when they
+         are contained within a subexpression that is not evaluated.
+        */
+        value comma(bool live) {
+            auto result = conditional(live);
+            while (auto tok = peek()) {
+                if (!tok->is(punctuator::comma)) break;
+                if (live) return fail(*tok, "comma operator");
+                ++pos;
+                result = conditional(live);
+            }
+            return result;
+        }
+
+        /* [6.5.15]/4-5 */
+        value conditional(bool live) {
+            auto cond = binary(1, live);
+            if (!accept(punctuator::question)) return cond;
+            bool which = cond.bits != 0;
+            auto if_true = comma(live && which);
+            if (!accept(punctuator::colon)) {
+                auto tok = peek();
+                return fail(tok ? *tok : directive, "expected ':'");
+            }
+            auto if_false = conditional(live && !which);
+            value result = which ? if_true : if_false;
+            result.is_unsigned = if_true.is_unsigned || if_false.is_unsigned;
+            return result;
+        }
+
+        value binary(int min_precedence, bool live) {
+            auto left = unary(live);
+            while (auto tok = peek()) {
+                int precedence = binary_precedence(*tok);
+                if (precedence < min_precedence) break;
+                const token& op = *tok;
+                ++pos;
+                if (op.is(punctuator::ampersand_ampersand)) {
+                    bool lhs = left.bits != 0;
+                    auto right = binary(precedence + 1, live && lhs);
+                    left = make_bool(lhs && right.bits != 0);
+                } else if (op.is(punctuator::pipe_pipe)) {
+                    bool lhs = left.bits != 0;
+                    auto right = binary(precedence + 1, live && !lhs);
+                    left = make_bool(lhs || right.bits != 0);
+                } else {
+                    auto right = binary(precedence + 1, live);
+                    left = apply(op, left, right, live);
+                }
+            }
+            return left;
+        }
+
+        value apply(const token& op, value left, value right, bool live) {
+            const bool is_unsigned = left.is_unsigned || right.is_unsigned;
+            const auto l = left.bits, r = right.bits;
+            // signed comparisons are unsigned ones with the sign flipped
+            const auto bias = is_unsigned ? 0 : intmax_sign;
+            switch (op.punc) {
+                case punctuator::star: return { l * r, is_unsigned };
+                case punctuator::plus: return { l + r, is_unsigned };
+                case punctuator::minus: return { l - r, is_unsigned };
+                case punctuator::slash_forward:
+                case punctuator::percent: {
+                    if (r == 0) {
+                        if (live) return fail(op, "division by zero");
+                        return { 0, is_unsigned };
+                    }
+                    bool divide = op.is(punctuator::slash_forward);
+                    if (is_unsigned) return { divide ? l / r : l % r, true };
+                    // INTMAX_MIN / -1 overflows; wrap it like the other
+                    // operators do
+                    if (l == intmax_sign && r == ~std::uintmax_t(0)) {
+                        return { divide ? l : 0, false };
+                    }
+                    auto sl = static_cast<std::intmax_t>(l);
+                    auto sr = static_cast<std::intmax_t>(r);
+                    auto q = divide ? sl / sr : sl % sr;
+                    return { static_cast<std::uintmax_t>(q), false };
+                }
+                case punctuator::less_less:
+                case punctuator::greater_greater:
+                    return shift(op.is(punctuator::less_less), left, right);
+                case punctuator::less:
+                    return make_bool((l ^ bias) < (r ^ bias));
+                case punctuator::greater:
+                    return make_bool((l ^ bias) > (r ^ bias));
+                case punctuator::less_equal:
+                    return make_bool((l ^ bias) <= (r ^ bias));
+                case punctuator::greater_equal:
+                    return make_bool((l ^ bias) >= (r ^ bias));
+                case punctuator::equal_equal: return make_bool(l == r);
+                case punctuator::bang_equal: return make_bool(l != r);
+                case punctuator::ampersand: return { l & r, is_unsigned };
+                case punctuator::caret: return { l ^ r, is_unsigned };
+                case punctuator::pipe: return { l | r, is_unsigned };
+                default: return fail(op, "unexpected operator");
+            }
+        }
+
+        /* [6.5.7]/3
+         The integer promotions are performed on each of the operands. The
+         type of the result is that of the promoted left operand.
+        */
+        // counts past the width give what shifting one bit at a time would
+        value shift(bool left_shift, value v, value count) {
+            const unsigned width = std::numeric_limits<std::uintmax_t>::digits;
+            if (is_negative(count)) {
+                left_shift = !left_shift;
+                count.bits = -count.bits;
+            }
+            const bool fill = !left_shift && is_negative(v);
+            if (count.bits >= width) return { fill ? ~std::uintmax_t(0) : 0,
+                                              v.is_unsigned };
+            if (left_shift) return { v.bits << count.bits, v.is_unsigned };
+            auto bits = v.bits >> count.bits;
+            if (fill && count.bits) bits |= ~std::uintmax_t(0)
+                                            << (width - count.bits);
+            return { bits, v.is_unsigned };
+        }
+
+        value unary(bool live) {
+            auto tok = peek();
+            if (!tok) return fail(directive, "expected an operand");
+            if (tok->is(token::punctuator)) {
+                switch (tok->punc) {
+                    case punctuator::plus:
+                        ++pos;
+                        return unary(live);
+                    case punctuator::minus: {
+                        ++pos;
+                        auto v = unary(live);
+                        return { -v.bits, v.is_unsigned };
+                    }
+                    case punctuator::tilde: {
+                        ++pos;
+                        auto v = unary(live);
+                        return { ~v.bits, v.is_unsigned };
+                    }
+                    case punctuator::bang:
+                        ++pos;
+                        return make_bool(unary(live).bits == 0);
+                    case punctuator::paren_left: {
+                        ++pos;
+                        auto v = comma(live);
+                        if (!accept(punctuator::paren_right)) {
+                            auto at = peek();
+                            return fail(at ? *at : directive,
+                                        "expected ')'");
+                        }
+                        return v;
+                    }
+                    default:
+                        return fail(*tok, "expected an operand");
+                }
+            }
+            ++pos;
+            switch (tok->kind) {
+                case token::pp_number: return integer(*tok);
+                case token::character_constant: return character(*tok);
+                /* [6.10.1]/4
+                 ... all remaining identifiers (including those lexically
+                 identical to keywords) are replaced with the pp-number 0
+                */
+                case token::identifier: return { 0, false };
+                default: return fail(*tok, "expected an operand");
+            }
+        }
+
+        /* [6.4.4.1] */
+        value integer(const token& tok) {
+            auto s = tok.spelling;
+            unsigned base = 10;
+            std::size_t i = 0;
+            if (s.size() > 1 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+                base = 16;
+                i = 2;
+            } else if (s[0] == '0') base = 8;
+            const std::size_t digits_start = i;
+            std::uintmax_t bits = 0;
+            bool overflow = false;
+            for (; i < s.size(); ++i) {
+                unsigned digit = digit_value(s[i]);
+                if (digit >= base) break;
+                if (bits > (std::numeric_limits<std::uintmax_t>::max() - digit)
+                           / base) {
+                    overflow = true;
+                }
+                bits = bits * base + digit;
+            }
+            if (i == digits_start && base == 16) {
+                return fail(tok, "invalid integer constant");
+            }
+            // 8 and 9 in an octal constant end up here too
+            auto suffix = s.substr(i);
+            bool is_unsigned = false, has_long = false;
+            while (!suffix.empty()) {
+                if ((suffix[0] == 'u' || suffix[0] == 'U') && !is_unsigned) {
+                    is_unsigned = true;
+                    suffix.remove_prefix(1);
+                } else if (suffix.starts_with("ll") ||
+                           suffix.starts_with("LL")) {
+                    if (has_long) break;
+                    has_long = true;
+                    suffix.remove_prefix(2);
+                } else if ((suffix[0] == 'l' || suffix[0] == 'L') &&
+                           !has_long) {
+                    has_long = true;
+                    suffix.remove_prefix(1);
+                } else break;
+            }
+            if (!suffix.empty()) {
+                auto exponent = base == 16 ? "pP" : "eE";
+                bool floating = s.find('.') != s.npos ||
+                                s.find_first_of(exponent) != s.npos;
+                return fail(tok, floating ? "floating constant"
+                                          : "invalid integer constant");
+            }
+            if (overflow) return fail(tok, "integer constant is too large");
+            /* [6.4.4.1]/5: octal and hexadecimal constants that do not fit
+             intmax_t are uintmax_t; decimal ones have no type, and are
+             taken as uintmax_t as well */
+            if (bits & intmax_sign) is_unsigned = true;
+            return { bits, is_unsigned };
+        }
+
+        /* [6.4.4.4] */
+        value character(const token& tok) {
+            auto s = tok.spelling;
+            bool wide = s[0] != '\'';
+            bool is_unsigned = s[0] == 'u' || s[0] == 'U';
+            s = s.substr(s.find('\'') + 1);
+            s.remove_suffix(1);
+            if (s.empty()) return fail(tok, "empty character constant");
+            const auto& options = current_context().options;
+            const unsigned byte_bits = options.sizes.bits_per_byte;
+            const std::uintmax_t byte_mask =
+                (std::uintmax_t(1) << byte_bits) - 1;
+            std::uintmax_t bits = 0;
+            std::size_t count = 0;
+            while (!s.empty()) {
+                std::uint32_t c = 0;
+                bool is_ucn = false;
+                if (s[0] != '\\') {
+                    c = static_cast<unsigned char>(s[0]);
+                    s.remove_prefix(1);
+                } else if (!escape(s, c, is_ucn)) {
+                    return fail(tok, "invalid escape sequence");
+                }
+                ++count;
+                if (wide) bits = c;
+                else if (is_ucn) {
+                    // the members of the execution character set are UTF-8
+                    // code units
+                    unsigned char units[4];
+                    std::size_t n = encode_utf8(c, units);
+                    for (std::size_t k = 0; k < n; ++k) {
+                        bits = (bits << byte_bits) | units[k];
+                    }
+                    count += n - 1;
+                } else bits = (bits << byte_bits) | (c & byte_mask);
+            }
+            /* [6.4.4.4]/10
+             If an integer character constant contains a single character or
+             escape sequence, its value is the one that results when an
+             object with type char whose value is that of the single
+             character or escape sequence is converted to type int.
+            */
+            if (!wide && count == 1 && options.is_char_signed &&
+                (bits & (std::uintmax_t(1) << (byte_bits - 1)))) {
+                bits |= ~byte_mask;
+            }
+            return { bits, is_unsigned };
+        }
+
+        static std::size_t encode_utf8(std::uint32_t c, unsigned char* out) {
+            if (c < 0x80) {
+                out[0] = c;
+                return 1;
+            } else if (c < 0x800) {
+                out[0] = 0xC0 | (c >> 6);
+                out[1] = 0x80 | (c & 0x3F);
+                return 2;
+            } else if (c < 0x10000) {
+                out[0] = 0xE0 | (c >> 12);
+                out[1] = 0x80 | ((c >> 6) & 0x3F);
+                out[2] = 0x80 | (c & 0x3F);
+                return 3;
+            }
+            out[0] = 0xF0 | (c >> 18);
+            out[1] = 0x80 | ((c >> 12) & 0x3F);
+            out[2] = 0x80 | ((c >> 6) & 0x3F);
+            out[3] = 0x80 | (c & 0x3F);
+            return 4;
+        }
+
+        /* [6.4.4.4]/1 escape-sequence, and [6.4.3] universal character
+         names, which phase 1 also makes of source multibyte characters */
+        static bool escape(std::string_view& s, std::uint32_t& c,
+                           bool& is_ucn) {
+            if (s.size() < 2) return false;
+            char kind = s[1];
+            s.remove_prefix(2);
+            switch (kind) {
+                case '\'': case '"': case '?': case '\\': c = kind; return true;
+                case 'a': c = '\a'; return true;
+                case 'b': c = '\b'; return true;
+                case 'f': c = '\f'; return true;
+                case 'n': c = '\n'; return true;
+                case 'r': c = '\r'; return true;
+                case 't': c = '\t'; return true;
+                case 'v': c = '\v'; return true;
+                case 'x': {
+                    std::size_t n = 0;
+                    c = 0;
+                    while (n < s.size() && digit_value(s[n]) < 16) {
+                        c = (c << 4) | digit_value(s[n]);
+                        ++n;
+                    }
+                    s.remove_prefix(n);
+                    return n > 0;
+                }
+                case 'u':
+                case 'U': {
+                    std::size_t length = kind == 'u' ? 4 : 8;
+                    if (s.size() < length) return false;
+                    c = 0;
+                    for (std::size_t n = 0; n < length; ++n) {
+                        if (digit_value(s[n]) >= 16) return false;
+                        c = (c << 4) | digit_value(s[n]);
+                    }
+                    s.remove_prefix(length);
+                    is_ucn = true;
+                    return true;
+                }
+                default: {
+                    if (kind < '0' || kind > '7') return false;
+                    c = kind - '0';
+                    for (int n = 0; n < 2 && !s.empty() &&
+                                    s[0] >= '0' && s[0] <= '7'; ++n) {
+                        c = (c << 3) | (s[0] - '0');
+                        s.remove_prefix(1);
+                    }
+                    return true;
+                }
+            }
+        }
+
+        std::span<const token> tokens;
+        const token& directive;
+        std::size_t pos = 0;
+        bool failed = false;
+    };
+}
+
+std::optional<value> pp::evaluate_condition(std::span<const token> tokens,
+                                            const token& directive) {
+    return evaluator{tokens, directive}.run();
+}
@@ -0,0 +1,264 @@
+#include "pp_output.hh"
+#include "diagnostic.hh"
+#include "platform.hh"
+#include "punctuator.hh"
+
+#include <algorithm>
+#include <optional>
+#include <unordered_map>
+
+namespace {
+    // line starts of a buffer, computed once
+    class line_table {
+    public:
+        explicit line_table(std::string_view data) {
+            starts.push_back(0);
+            for (std::size_t i = 0; i < data.size(); ++i) {
+                if (data[i] == '\n') starts.push_back(i + 1);
+            }
+        }
+
+        // 1-based
+        std::size_t line_of(std::size_t offset) const {
+            auto it = std::upper_bound(starts.begin(), starts.end(), offset);
+            return it - starts.begin();
+        }
+    private:
+        std::vector<std::size_t> starts;
+    };
+
+    bool is_identifier_char(char c) {
+        auto u = static_cast<unsigned char>(c);
+        return (u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z') ||
+               (u >= '0' && u <= '9') || u == '_' || u == '\\' || u >= 0x80;
+    }
+
+    // whether writing the two tokens next to each other would lex
+    // differently, in which case a space goes between them
+    bool would_merge(const token& left, const token& right) {
+        const char a = left.spelling.back();
+        const char b = right.spelling.front();
+        if (is_identifier_char(a) && is_identifier_char(b)) return true;
+        // 1e + 1 and 1 .2 each start a longer pp-number
+        if (left.is(token::pp_number) && (b == '.' || b == '+' || b == '-')) {
+            return true;
+        }
+        if (a == '.' && b >= '0' && b <= '9') return true;
+        // an encoding prefix followed by a literal
+        if (left.is(token::identifier) &&
+            (right.is(token::string_literal) ||
+             right.is(token::character_constant))) {
+            return true;
+        }
+        if (a == '/' && (b == '/' || b == '*')) return true;
+        if (left.is(token::punctuator) && right.is(token::punctuator)) {
+            std::string joined{left.spelling};
+            joined += right.spelling;
+            // two dots and %:% are prefixes of ... and %:%:
+            if (joined == ".." || joined == "%:%") return true;
+            std::string_view view = joined;
+            for (std::size_t n = 1; n <= right.spelling.size(); ++n) {
+                auto prefix = view.substr(0, left.spelling.size() + n);
+                if (find_punctuator(prefix)) return true;
+            }
+        }
+        return false;
+    }
+
+    // make treats spaces, # and $ specially
+    void append_make_escaped(std::string& out, std::string_view name) {
+        for (char c : name) {
+            if (c == ' ' || c == '#') out += '\\';
+            else if (c == '$') out += '$';
+            out += c;
+        }
+    }
+
+    class printer {
+    public:
+        printer(const buffer& main, pp::text_writer& out) :
+        main(main), out(out) { }
+
+        void print(const std::vector<token>& tokens) {
+            // the main file is the root of the include flags even when its
+            // first tokens come from a header
+            files.push_back(&main);
+            current = &main;
+            write_marker(1, "");
+            for (const auto& tok : tokens) {
+                if (tok.is(token::space)) {
+                    pending_space = !at_line_start;
+                } else if (tok.is(token::newline)) {
+                    end_line();
+                } else {
+                    if (at_line_start) start_line(tok);
+                    else if (pending_space || would_merge(*previous, tok)) {
+                        out.put(' ');
+                    }
+                    out.write(tok.spelling);
+                    previous = &tok;
+                    pending_space = false;
+                    at_line_start = false;
+                }
+            }
+            if (!at_line_start) end_line();
+        }
+    private:
+        void end_line() {
+            out.put('\n');
+            ++line;
+            at_line_start = true;
+            pending_space = false;
+            previous = nullptr;
+        }
+
+        // the file and line a token is written for: the outermost macro
+        // invocation it came from, if any
+        std::optional<std::pair<const buffer*, std::size_t>> position(
+            const token& tok) {
+            auto loc = tok.range.first;
+            while (auto site = loc.expanded_from()) loc = *site;
+            const auto file = &loc.buffer();
+            // tokens made up by phase 4, such as those of __LINE__
+            if (file != &main && !file->included_at()) return {};
+            return std::pair{ file, line_of(loc) };
+        }
+
+        // lines are counted in the file as written, before line splices
+        // were removed
+        std::size_t line_of(location loc) {
+            auto spelling = loc.find_spelling_loc();
+            auto& table = lines.try_emplace(&spelling.buffer(),
+                                            spelling.buffer().data())
+                              .first->second;
+            return table.line_of(spelling.offset());
+        }
+
+        void start_line(const token& tok) {
+            auto pos = position(tok);
+            if (!pos) return;
+            auto [file, target] = *pos;
+            if (file != current) {
+                change_file(file, target);
+            } else if (target > line && target - line <= 8) {
+                // a few empty lines are cheaper than a marker
+                while (line < target) end_line();
+            } else if (target > line) {
+                write_marker(target, "");
+            }
+        }
+
+        // 1 for entering an include, 2 for returning to a file; a file
+        // that is not nested in the current one is reached by returning
+        // to the file both are included from, as cpp does
+        void change_file(const buffer* file, std::size_t target) {
+            std::vector<const buffer*> chain;
+            for (auto f = file; f; ) {
+                chain.insert(chain.begin(), f);
+                auto at = f->included_at();
+                f = at ? &at->buffer() : nullptr;
+            }
+            auto [left, entered] = std::mismatch(files.begin(), files.end(),
+                                                 chain.begin(), chain.end());
+            const auto common = entered - chain.begin();
+            if (entered == chain.end()) {
+                current = file;
+                write_marker(target, " 2");
+            } else {
+                if (left != files.end() && common) {
+                    current = chain[common - 1];
+                    write_marker(line_of(*(*entered)->included_at()), " 2");
+                }
+                // a file included on the first line of another is entered
+                // along with it
+                for (; *entered != file; ++entered) {
+                    current = *entered;
+                    write_marker(1, " 1");
+                }
+                current = file;
+                write_marker(target, " 1");
+            }
+            files = std::move(chain);
+        }
+
+        void write_marker(std::size_t target, const char* flag) {
+            out.write("# ");
+            out.write(std::to_string(target));
+            out.write(" \"");
+            for (char c : current->name()) {
+                if (c == '"' || c == '\\') out.put('\\');
+                out.put(c);
+            }
+            out.put('"');
+            out.write(flag);
+            out.put('\n');
+            line = target;
+        }
+
+        const buffer& main;
+        pp::text_writer& out;
+        std::unordered_map<const buffer*, line_table> lines;
+        // the stack of files being included, innermost last
+        std::vector<const buffer*> files;
+        const buffer* current = nullptr;
+        std::size_t line = 1;
+        bool at_line_start = true;
+        bool pending_space = false;
+        const token* previous = nullptr;
+    };
+}
+
+pp::text_writer::text_writer(FILE* out) : out(out) {
+    pending.reserve(capacity);
+}
+
+pp::text_writer::~text_writer() {
+    flush();
+}
+
+void pp::text_writer::flush() {
+    std::fwrite(pending.data(), 1, pending.size(), out);
+    pending.clear();
+}
+
+void pp::write_preprocessed(const std::vector<token>& tokens,
+                            const buffer& main, text_writer& out) {
+    printer p{main, out};
+    p.print(tokens);
+}
+
+void pp::write_preprocessed(const std::vector<token>& tokens,
+                            const buffer& main, const std::string& path) {
+    using platform::stream::output;
+    FILE* file = path.empty() ? output() : std::fopen(path.c_str(), "wb");
+    if (!file) {
+        diagnostic::diagnose(diagnostic::id::cannot_open_file, {}, path);
+        return;
+    }
+    {
+        text_writer writer{file};
+        write_preprocessed(tokens, main, writer);
+    }
+    if (file != output()) std::fclose(file);
+}
+
+std::string pp::format_dependencies(
+    std::string_view target, const std::vector<std::string>& prerequisites) {
+    std::string result;
+    append_make_escaped(result, target);
+    result += ':';
+    std::size_t column = result.size();
+    for (const auto& name : prerequisites) {
+        std::string escaped;
+        append_make_escaped(escaped, name);
+        if (column + 1 + escaped.size() > 76) {
+            result += " \\\n";
+            column = 0;
+        }
+        result += ' ';
+        result += escaped;
+        column += 1 + escaped.size();
+    }
+    result += '\n';
+    return result;
+}
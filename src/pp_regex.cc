@@ -5,7 +5,7 @@
 #include <string>
 
 namespace pp { namespace regex {
-    std::map<std::string, std::string> table = {
+    const std::map<std::string, std::string> table = {
         { "header-name", R"(<.*?>|".*?")" },
         { "pp-number", R"(\.?[0-9]([0-9]|[epEP][\+-]|@id-nondigit@|\.)*)" },
         { "identifier", "@id-nondigit@(@id-nondigit@|[0-9])*" },
@@ -51,9 +51,10 @@ namespace pp { namespace regex {
         auto end = pattern.find('@', it + 1);
         assert(end != std::string::npos);
         auto prefix = pattern.substr(0, it);
-        auto repl = table[pattern.substr(it + 1, end - (it + 1))];
+        auto repl = table.find(pattern.substr(it + 1, end - (it + 1)));
+        assert(repl != table.end());
         auto suffix = pattern.substr(end + 1);
-        return resolve_references(prefix + "(?:" + repl + ")" + suffix);
+        return resolve_references(prefix + "(?:" + repl->second + ")" + suffix);
     }
 
     std::regex build(std::string name) {
@@ -1,66 +1,82 @@
 #include "punctuator.hh"
 
-std::map<std::string, punctuator> punctuator_table = {
-    { "[", punctuator::square_left },
-    { "]", punctuator::square_right },
-    { "(", punctuator::paren_left },
-    { ")", punctuator::paren_right },
-    { "{", punctuator::curly_left },
-    { "}", punctuator::curly_right },
-    { ".", punctuator::dot },
-    { "->", punctuator::arrow },
-    { "++", punctuator::plus_plus },
-    { "--", punctuator::minus_minus },
-    { "&", punctuator::ampersand },
-    { "*", punctuator::star },
-    { "+", punctuator::plus },
-    { "-", punctuator::minus },
-    { "~", punctuator::tilde },
-    { "!", punctuator::bang },
-    { "/", punctuator::slash_forward },
-    { "%", punctuator::percent },
-    { "<<", punctuator::less_less },
-    { ">>", punctuator::greater_greater },
-    { "<", punctuator::less },
-    { ">", punctuator::greater },
-    { "<=", punctuator::less_equal },
-    { ">=", punctuator::greater_equal },
-    { "==", punctuator::equal_equal },
-    { "!=", punctuator::bang_equal },
-    { "^", punctuator::caret },
-    { "|", punctuator::pipe },
-    { "&&", punctuator::ampersand_ampersand },
-    { "||", punctuator::pipe_pipe },
-    { "?", punctuator::question },
-    { ":", punctuator::colon },
-    { ";", punctuator::semicolon },
-    { "...", punctuator::ellipsis },
-    { "=", punctuator::equal },
-    { "*=", punctuator::star_equal },
-    { "/=", punctuator::slash_forward_equal },
-    { "%=", punctuator::percent_equal },
-    { "+=", punctuator::plus_equal },
-    { "-=", punctuator::minus_equal },
-    { "<<=", punctuator::less_less_equal },
-    { ">>=", punctuator::greater_greater_equal },
-    { "&=", punctuator::ampersand_equal },
-    { "^=", punctuator::caret_equal },
-    { "|=", punctuator::pipe_equal },
-    { ",", punctuator::comma },
-    { "#", punctuator::hash },
-    { "##", punctuator::hash_hash },
-    { "<:", punctuator::square_left },
-    { ":>", punctuator::square_right },
-    { "<%", punctuator::curly_left },
-    { "%>", punctuator::curly_right },
-    { "%:", punctuator::hash },
-    { "%:%:", punctuator::hash_hash },
-};
+#include <algorithm>
+#include <utility>
 
-/* [6.4.6]/3
- In all aspects of the language, the six tokens
- <:  :>  <%  %>  %:  %:%:
- behave, respectively, the same as the six tokens
- [ ] { } # ##
- except for their spelling.
-*/
\ No newline at end of file
+namespace {
+    using entry = std::pair<std::string_view, punctuator>;
+
+    // sorted by spelling so that lookups can use a binary search
+    constexpr entry punctuator_table[] = {
+        { "!", punctuator::bang },
+        { "!=", punctuator::bang_equal },
+        { "#", punctuator::hash },
+        { "##", punctuator::hash_hash },
+        { "%", punctuator::percent },
+        { "%:", punctuator::hash },
+        { "%:%:", punctuator::hash_hash },
+        { "%=", punctuator::percent_equal },
+        { "%>", punctuator::curly_right },
+        { "&", punctuator::ampersand },
+        { "&&", punctuator::ampersand_ampersand },
+        { "&=", punctuator::ampersand_equal },
+        { "(", punctuator::paren_left },
+        { ")", punctuator::paren_right },
+        { "*", punctuator::star },
+        { "*=", punctuator::star_equal },
+        { "+", punctuator::plus },
+        { "++", punctuator::plus_plus },
+        { "+=", punctuator::plus_equal },
+        { ",", punctuator::comma },
+        { "-", punctuator::minus },
+        { "--", punctuator::minus_minus },
+        { "-=", punctuator::minus_equal },
+        { "->", punctuator::arrow },
+        { ".", punctuator::dot },
+        { "...", punctuator::ellipsis },
+        { "/", punctuator::slash_forward },
+        { "/=", punctuator::slash_forward_equal },
+        { ":", punctuator::colon },
+        { ":>", punctuator::square_right },
+        { ";", punctuator::semicolon },
+        { "<", punctuator::less },
+        { "<%", punctuator::curly_left },
+        { "<:", punctuator::square_left },
+        { "<<", punctuator::less_less },
+        { "<<=", punctuator::less_less_equal },
+        { "<=", punctuator::less_equal },
+        { "=", punctuator::equal },
+        { "==", punctuator::equal_equal },
+        { ">", punctuator::greater },
+        { ">=", punctuator::greater_equal },
+        { ">>", punctuator::greater_greater },
+        { ">>=", punctuator::greater_greater_equal },
+        { "?", punctuator::question },
+        { "[", punctuator::square_left },
+        { "]", punctuator::square_right },
+        { "^", punctuator::caret },
+        { "^=", punctuator::caret_equal },
+        { "{", punctuator::curly_left },
+        { "|", punctuator::pipe },
+        { "|=", punctuator::pipe_equal },
+        { "||", punctuator::pipe_pipe },
+        { "}", punctuator::curly_right },
+        { "~", punctuator::tilde },
+    };
+
+    /* [6.4.6]/3
+     In all aspects of the language, the six tokens
+     <:  :>  <%  %>  %:  %:%:
+     behave, respectively, the same as the six tokens
+     [ ] { } # ##
+     except for their spelling.
+    */
+
+    static_assert(std::ranges::is_sorted(punctuator_table, {}, &entry::first));
+}
+
+std::optional<punctuator> find_punctuator(std::string_view spelling) {
+    auto it = std::ranges::lower_bound(punctuator_table, spelling, {}, &entry::first);
+    if (it == std::end(punctuator_table) || it->first != spelling) return {};
+    return it->second;
+}
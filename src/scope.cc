@@ -0,0 +1,39 @@
+#include "scope.hh"
+
+#include <cassert>
+
+namespace parse {
+    void scope_table::push_scope() {
+        marks.push_back(undo_log.size());
+    }
+
+    void scope_table::pop_scope() {
+        assert(!marks.empty());
+        // newest first, so that a name declared twice in the scope ends
+        // up with what it had before either
+        while (undo_log.size() > marks.back()) {
+            auto& entry = undo_log.back();
+            slots[entry.id] = entry.hidden;
+            undo_log.pop_back();
+        }
+        marks.pop_back();
+    }
+
+    void scope_table::declare(std::string_view name, symbol sym) {
+        auto [it, added] = ids.try_emplace(
+            name, static_cast<std::uint32_t>(slots.size())
+        );
+        if (added) slots.emplace_back();
+        auto& slot = slots[it->second];
+        if (marks.empty()) {
+            // file scope is never left, so has nothing to undo; a name
+            // declared there again is in scope from the first declaration
+            if (slot && slot->is_typedef == sym.is_typedef) {
+                sym.declared_at = slot->declared_at;
+            }
+        } else {
+            undo_log.push_back({ it->second, slot });
+        }
+        slot = sym;
+    }
+}
@@ -0,0 +1,196 @@
+#include "server.hh"
+#include "platform.hh"
+#include "diagnostic.hh"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+
+#if defined(PLATFORM_POSIX)
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using diagnostic::diagnose;
+
+namespace {
+#if defined(PLATFORM_POSIX)
+    // messages are sequences of 32-bit lengths or values and strings;
+    // both ends are on the same machine, so native byte order is fine
+    bool write_all(int fd, const void* data, std::size_t size) {
+        auto bytes = static_cast<const char*>(data);
+        while (size) {
+            auto n = ::write(fd, bytes, size);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            bytes += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    bool read_all(int fd, void* data, std::size_t size) {
+        auto bytes = static_cast<char*>(data);
+        while (size) {
+            auto n = ::read(fd, bytes, size);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            bytes += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    bool write_u32(int fd, std::uint32_t value) {
+        return write_all(fd, &value, sizeof(value));
+    }
+
+    bool read_u32(int fd, std::uint32_t& value) {
+        return read_all(fd, &value, sizeof(value));
+    }
+
+    bool write_string(int fd, const std::string& s) {
+        return write_u32(fd, s.size()) && write_all(fd, s.data(), s.size());
+    }
+
+    // a request is a command line, so a string or argument count past
+    // these is not one, and is refused before anything is allocated
+    constexpr std::uint32_t max_request_string = 1 << 20;
+    constexpr std::uint32_t max_request_args = 1 << 16;
+
+    bool read_string(int fd, std::string& s,
+                     std::uint32_t max_size = UINT32_MAX) {
+        std::uint32_t size;
+        if (!read_u32(fd, size) || size > max_size) return false;
+        s.resize(size);
+        return read_all(fd, s.data(), size);
+    }
+
+    std::optional<sockaddr_un> make_address(const std::string& path) {
+        sockaddr_un addr{};
+        if (path.size() >= sizeof(addr.sun_path)) return {};
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        return addr;
+    }
+
+    void serve_one(int fd, const server::handler& handle) {
+        std::uint32_t count;
+        std::string cwd;
+        if (!read_string(fd, cwd, max_request_string) ||
+            !read_u32(fd, count) || count > max_request_args) {
+            return;
+        }
+        std::vector<std::string> args(count);
+        for (auto& arg : args) {
+            if (!read_string(fd, arg, max_request_string)) return;
+        }
+        std::error_code ec;
+        std::filesystem::current_path(cwd, ec);
+        int exit_code;
+        std::string output;
+        std::string errors;
+        {
+            platform::stream::capture captured;
+            if (ec) {
+                diagnose(diagnostic::id::server_error, {},
+                         "cannot change to " + cwd, ec.message());
+                exit_code = 1;
+            } else {
+                exit_code = handle(args);
+            }
+            output = captured.str();
+            errors = captured.error_str();
+        }
+        if (write_u32(fd, exit_code) && write_string(fd, errors)) {
+            write_string(fd, output);
+        }
+    }
+#endif
+}
+
+bool server::serve(const std::string& socket_path, const handler& handle) {
+#if defined(PLATFORM_WIN32)
+    diagnose(diagnostic::id::not_yet_implemented, {}, "compile server");
+    return false;
+#elif defined(PLATFORM_POSIX)
+    auto addr = make_address(socket_path);
+    if (!addr) {
+        diagnose(diagnostic::id::server_error, {}, socket_path,
+                 "socket path too long");
+        return false;
+    }
+    int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ::unlink(socket_path.c_str());
+    if (listener < 0 ||
+        ::bind(listener, reinterpret_cast<sockaddr*>(&*addr),
+               sizeof(*addr)) < 0 ||
+        ::listen(listener, 16) < 0) {
+        diagnose(diagnostic::id::server_error, {}, socket_path,
+                 std::strerror(errno));
+        if (listener >= 0) ::close(listener);
+        return false;
+    }
+    // a client that goes away must not take the server with it
+    std::signal(SIGPIPE, SIG_IGN);
+    while (true) {
+        int fd = ::accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            diagnose(diagnostic::id::server_error, {}, socket_path,
+                     std::strerror(errno));
+            break;
+        }
+        serve_one(fd, handle);
+        ::close(fd);
+    }
+    ::close(listener);
+    ::unlink(socket_path.c_str());
+    return false;
+#endif
+}
+
+std::optional<int> server::request(const std::string& socket_path,
+                                   const std::vector<std::string>& args) {
+#if defined(PLATFORM_WIN32)
+    diagnose(diagnostic::id::not_yet_implemented, {}, "compile server");
+    return {};
+#elif defined(PLATFORM_POSIX)
+    auto addr = make_address(socket_path);
+    if (!addr) {
+        diagnose(diagnostic::id::server_error, {}, socket_path,
+                 "socket path too long");
+        return {};
+    }
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&*addr),
+                            sizeof(*addr)) < 0) {
+        diagnose(diagnostic::id::server_error, {}, socket_path,
+                 std::strerror(errno));
+        if (fd >= 0) ::close(fd);
+        return {};
+    }
+    std::error_code ec;
+    bool sent = write_string(fd, std::filesystem::current_path(ec).string());
+    sent = sent && write_u32(fd, args.size());
+    for (const auto& arg : args) sent = sent && write_string(fd, arg);
+    std::uint32_t exit_code;
+    std::string output;
+    std::string errors;
+    if (!sent || !read_u32(fd, exit_code) || !read_string(fd, errors) ||
+        !read_string(fd, output)) {
+        diagnose(diagnostic::id::server_error, {}, socket_path,
+                 "connection lost");
+        ::close(fd);
+        return {};
+    }
+    ::close(fd);
+    std::fwrite(errors.data(), 1, errors.size(), stderr);
+    std::fwrite(output.data(), 1, output.size(), stdout);
+    return static_cast<int>(exit_code);
+#endif
+}
@@ -0,0 +1,231 @@
+#include "stats.hh"
+#include "platform.hh"
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <print>
+
+namespace {
+    // set once per run, before any work starts
+    std::atomic<bool> collecting{false};
+    thread_local std::uint64_t allocations = 0;
+    thread_local stats::phase_timer* innermost = nullptr;
+
+    struct phase_totals {
+        std::uint64_t calls = 0;
+        std::chrono::nanoseconds wall{0};
+        std::chrono::nanoseconds cpu{0};
+        std::uint64_t allocs = 0;
+    };
+
+    // shared by all threads; timers add to it as they finish
+    struct atomic_phase_totals {
+        std::atomic<std::uint64_t> calls{0};
+        std::atomic<std::int64_t> wall_ns{0};
+        std::atomic<std::int64_t> cpu_ns{0};
+        std::atomic<std::uint64_t> allocs{0};
+
+        phase_totals load() const {
+            return {
+                calls.load(),
+                std::chrono::nanoseconds(wall_ns.load()),
+                std::chrono::nanoseconds(cpu_ns.load()),
+                allocs.load()
+            };
+        }
+    };
+
+    constexpr auto phase_count = static_cast<std::size_t>(stats::phase::count);
+    constexpr auto counter_count = static_cast<std::size_t>(stats::counter::count);
+
+    std::array<atomic_phase_totals, phase_count> totals;
+    std::array<std::atomic<std::uint64_t>, counter_count> counters;
+
+    const char* to_string(stats::phase p) {
+        switch (p) {
+            case stats::phase::one: return "phase 1";
+            case stats::phase::two: return "phase 2";
+            case stats::phase::three: return "phase 3";
+            case stats::phase::four: return "phase 4";
+            case stats::phase::six: return "phase 6";
+            case stats::phase::seven: return "phase 7";
+            case stats::phase::parse: return "parse";
+            case stats::phase::count: break;
+        }
+        return "???";
+    }
+
+    const char* to_string(stats::counter c) {
+        switch (c) {
+            case stats::counter::tokens_lexed: return "tokens lexed";
+            case stats::counter::macros_expanded: return "macros expanded";
+            case stats::counter::bytes_read: return "bytes read";
+            case stats::counter::includes_processed:
+                return "includes processed";
+            case stats::counter::header_cache_hits:
+                return "header cache hits";
+            case stats::counter::include_guard_skips:
+                return "include guard skips";
+            case stats::counter::include_lookups:
+                return "include lookups";
+            case stats::counter::include_lookups_cached:
+                return "include lookups cached";
+            case stats::counter::conditions_evaluated:
+                return "conditions evaluated";
+            case stats::counter::conditions_cached:
+                return "conditions cached";
+            case stats::counter::diagnostics_emitted:
+                return "diagnostics emitted";
+            case stats::counter::count: break;
+        }
+        return "???";
+    }
+
+    double to_ms(std::chrono::nanoseconds ns) {
+        return std::chrono::duration<double, std::milli>(ns).count();
+    }
+}
+
+// count every allocation so that phases can report how many they made
+void* operator new(std::size_t size) {
+    if (collecting.load(std::memory_order_relaxed)) ++allocations;
+    if (!size) size = 1;
+    if (void* p = std::malloc(size)) return p;
+    throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace stats {
+    phase_timer::phase_timer(phase p) :
+    which{p},
+    active{collecting.load(std::memory_order_relaxed)},
+    span{to_string(p)} {
+        if (!active) return;
+        outer = innermost;
+        if (outer) outer->pause();
+        innermost = this;
+        resume();
+    }
+
+    phase_timer::~phase_timer() {
+        if (!active) return;
+        pause();
+        auto& total = totals[static_cast<std::size_t>(which)];
+        total.calls.fetch_add(1, std::memory_order_relaxed);
+        total.wall_ns.fetch_add(wall.count(), std::memory_order_relaxed);
+        total.cpu_ns.fetch_add(cpu.count(), std::memory_order_relaxed);
+        total.allocs.fetch_add(allocs, std::memory_order_relaxed);
+        innermost = outer;
+        if (outer) outer->resume();
+    }
+
+    void phase_timer::pause() {
+        wall += std::chrono::steady_clock::now() - wall_start;
+        cpu += platform::thread_cpu_time() - cpu_start;
+        allocs += allocations - allocs_start;
+    }
+
+    void phase_timer::resume() {
+        wall_start = std::chrono::steady_clock::now();
+        cpu_start = platform::thread_cpu_time();
+        allocs_start = allocations;
+    }
+
+    void enable(bool on) {
+        collecting.store(on, std::memory_order_relaxed);
+    }
+
+    void count(counter c, std::uint64_t n) {
+        if (!collecting.load(std::memory_order_relaxed)) return;
+        counters[static_cast<std::size_t>(c)].fetch_add(
+            n, std::memory_order_relaxed
+        );
+    }
+
+    std::uint64_t allocation_count() {
+        return allocations;
+    }
+
+    static void report_table(FILE* f) {
+        std::println(f, "{:<20}{:>10}{:>14}{:>14}{:>14}",
+                     "phase", "calls", "wall (ms)", "cpu (ms)", "allocations");
+        phase_totals sum;
+        for (std::size_t i = 0; i < phase_count; ++i) {
+            const auto total = totals[i].load();
+            std::println(f, "{:<20}{:>10}{:>14.3f}{:>14.3f}{:>14}",
+                         to_string(static_cast<phase>(i)), total.calls,
+                         to_ms(total.wall), to_ms(total.cpu), total.allocs);
+            sum.calls += total.calls;
+            sum.wall += total.wall;
+            sum.cpu += total.cpu;
+            sum.allocs += total.allocs;
+        }
+        std::println(f, "{:<20}{:>10}{:>14.3f}{:>14.3f}{:>14}",
+                     "total", sum.calls, to_ms(sum.wall), to_ms(sum.cpu),
+                     sum.allocs);
+        std::println(f, "");
+        std::println(f, "{:<20}{:>10}", "counter", "value");
+        for (std::size_t i = 0; i < counter_count; ++i) {
+            std::println(f, "{:<20}{:>10}",
+                         to_string(static_cast<counter>(i)), counters[i].load());
+        }
+    }
+
+    static void report_json(FILE* f) {
+        std::println(f, "{{");
+        std::println(f, "  \"phases\": {{");
+        for (std::size_t i = 0; i < phase_count; ++i) {
+            const auto total = totals[i].load();
+            std::println(f, "    \"{}\": {{ \"calls\": {}, \"wall_ms\": {:.3f}, "
+                         "\"cpu_ms\": {:.3f}, \"allocations\": {} }}{}",
+                         to_string(static_cast<phase>(i)), total.calls,
+                         to_ms(total.wall), to_ms(total.cpu), total.allocs,
+                         i + 1 < phase_count ? "," : "");
+        }
+        std::println(f, "  }},");
+        std::println(f, "  \"counters\": {{");
+        for (std::size_t i = 0; i < counter_count; ++i) {
+            std::println(f, "    \"{}\": {}{}",
+                         to_string(static_cast<counter>(i)), counters[i].load(),
+                         i + 1 < counter_count ? "," : "");
+        }
+        std::println(f, "  }}");
+        std::println(f, "}}");
+    }
+
+    void report(FILE* f, bool json) {
+        if (json) report_json(f);
+        else report_table(f);
+    }
+
+    void reset() {
+        for (auto& total : totals) {
+            total.calls = 0;
+            total.wall_ns = 0;
+            total.cpu_ns = 0;
+            total.allocs = 0;
+        }
+        for (auto& c : counters) c = 0;
+    }
+}
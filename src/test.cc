@@ -1,16 +1,46 @@
 #include "test.hh"
 #include "buffer.hh"
+#include "context.hh"
+#include "diagnostic.hh"
+#include "options.hh"
 #include "utf8.hh"
 #include "pp.hh"
 #include "platform.hh"
+#include "thread_pool.hh"
+#include "header_cache.hh"
+#include "pch.hh"
+#include "pp_output.hh"
+#include "ast_visit.hh"
+#include "parse_expr.hh"
+#include "parse_decl.hh"
+#include "parse_parallel.hh"
+#include "declarator.hh"
+#include "type.hh"
 
 #include <iostream>
 #include <memory>
 #include <cstdio>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
 
 using namespace platform::stream;
 
 static void run_derived_buffer_tests();
+static void run_expansion_table_tests();
+static void run_diagnostic_control_tests();
+static void run_thread_pool_tests();
+static void run_include_guard_tests();
+static void run_conditional_tests();
+static void run_pch_tests();
+static void run_dependency_tests();
+static void run_preprocessed_output_tests();
+static void run_ruleset_tests();
+static void run_ast_tests();
+static void run_translation_unit_tests();
+static void run_type_tests();
 static void run_utf8_tests();
 static void run_pp_regex_tests();
 
@@ -39,6 +69,18 @@ static void run_test(bool passed, const char* expr,
 
 void test::run_tests() {
     run_derived_buffer_tests();
+    run_expansion_table_tests();
+    run_diagnostic_control_tests();
+    run_thread_pool_tests();
+    run_include_guard_tests();
+    run_conditional_tests();
+    run_pch_tests();
+    run_dependency_tests();
+    run_preprocessed_output_tests();
+    run_ruleset_tests();
+    run_ast_tests();
+    run_translation_unit_tests();
+    run_type_tests();
     run_utf8_tests();
     run_pp_regex_tests();
 }
@@ -65,6 +107,893 @@ void run_derived_buffer_tests() {
     TEST(db->offset_in_original(22) == 10);
 }
 
+// the tokens phase 3 makes of source, along with the buffer they
+// point into; name is where the source is taken to be, for includes
+struct phase_three_tokens {
+    explicit phase_three_tokens(std::string source,
+                                std::string name = "<test>") {
+        auto raw = std::make_unique<raw_buffer>(std::move(name),
+                                                std::move(source));
+        auto post_p1 = pp::perform_phase_one(std::move(raw));
+        buf = pp::perform_phase_two(std::move(post_p1));
+        tokens = pp::perform_phase_three(*buf);
+    }
+
+    // hands the tokens and their buffer to phase 4
+    pp::phase_four_manager phase_four() && {
+        return { std::move(buf), std::move(tokens) };
+    }
+
+    std::unique_ptr<buffer> buf;
+    std::vector<token> tokens;
+};
+
+// the tokens phase 7 makes of source, ready to parse, along with the
+// buffers their locations point into
+struct parser_input {
+    explicit parser_input(std::string source) {
+        p4m = std::make_unique<pp::phase_four_manager>(
+            phase_three_tokens{std::move(source)}.phase_four()
+        );
+        tokens = p4m->process();
+        pp::remove_whitespace(tokens);
+        tokens = pp::perform_phase_six(std::move(tokens), extra_buffers);
+        tokens = pp::perform_phase_seven(tokens);
+    }
+
+    std::unique_ptr<pp::phase_four_manager> p4m;
+    pp::buffer_ptrs extra_buffers;
+    std::vector<token> tokens;
+};
+
+void run_expansion_table_tests() {
+    std::println("running expansion table tests...");
+    expansion_table table;
+    raw_buffer buf{"<test>", "#define A B\n#define B 1\nA\n"};
+    location use_a{buf, 24}, def_a{buf, 8}, use_b{buf, 10}, def_b{buf, 20};
+    auto outer = table.record(use_a, def_a);
+    use_b.set_expansion(outer);
+    auto inner = table.record(use_b, def_b);
+    TEST(outer != inner);
+    TEST(table.size() == 2);
+    TEST(table.parent(inner) == outer);
+    TEST(table.parent(outer) == 0);
+    TEST(table[inner].definition.offset() == 20);
+    TEST(table[outer].site.offset() == 24);
+    {
+        // tokens of an argument lead back through the parameter they
+        // replaced to the expansion they were an argument of
+        auto p4m = phase_three_tokens{
+            "#define F(x) x\n#define A 1\nF(A)\n"
+        }.phase_four();
+        std::vector<std::size_t> sites;
+        for (const auto& tok : p4m.process()) {
+            if (tok.spelling != "1") continue;
+            for (std::optional loc = tok.range.first; loc;
+                 loc = loc->expanded_from()) {
+                sites.push_back(loc->offset());
+            }
+        }
+        TEST(sites == std::vector<std::size_t>({ 25, 29, 13, 27 }));
+    }
+}
+
+// the category diag comes out as under the given flags, if any
+static std::optional<diagnostic::category> mapped(
+    std::vector<std::string> flags, diagnostic::id diag,
+    std::optional<location> loc = {}
+) {
+    compilation_context context{options::parse(std::move(flags))};
+    return diagnostic::map_diagnostic(diag, diagnostic::find(diag), loc);
+}
+
+void run_diagnostic_control_tests() {
+    std::println("running diagnostic control tests...");
+    using diagnostic::category;
+    using diagnostic::id;
+    const auto warning = id::pp4_unknown_pragma;
+    const auto error = id::pp7_syntax_error;
+    TEST(mapped({}, warning) == category::warning);
+    TEST(mapped({}, error) == category::error);
+    // by name or by category, the last word for a diagnostic winning
+    TEST(!mapped({"-Wno-pp4-unknown-pragma"}, warning));
+    TEST(!mapped({"-Wno-warning"}, warning));
+    TEST(!mapped({"-w"}, warning));
+    TEST(mapped({"-Wno-warning", "-Wpp4-unknown-pragma"}, warning) ==
+         category::warning);
+    TEST(!mapped({"-Wno-warning"}, id::input_file_not_dot_c));
+    // promoted to errors, wholesale or one at a time
+    TEST(mapped({"-Werror"}, warning) == category::error);
+    TEST(mapped({"-Werror=pp4-unknown-pragma"}, warning) == category::error);
+    TEST(mapped({"-Werror=warning"}, warning) == category::error);
+    TEST(mapped({"-Werror", "-Wno-error=pp4-unknown-pragma"}, warning) ==
+         category::warning);
+    TEST(mapped({"-Werror", "-Wno-error"}, warning) == category::warning);
+    TEST(!mapped({"-Werror", "-Wno-pp4-unknown-pragma"}, warning));
+    // errors are not for the command line to turn off
+    TEST(mapped({"-Wno-warning", "-w"}, error) == category::error);
+    {
+        // notes go the way of what they are notes to
+        compilation_context context{
+            options::parse({ "-Wno-pp4-unknown-pragma" })
+        };
+        auto note = [] {
+            const auto& aux = diagnostic::find(id::aux_expanded_here);
+            return diagnostic::map_diagnostic(id::aux_expanded_here, aux, {});
+        };
+        auto map = [](id diag) {
+            return diagnostic::map_diagnostic(diag, diagnostic::find(diag),
+                                              {});
+        };
+        TEST(!map(warning));
+        TEST(!note());
+        TEST(map(id::pp4_non_directive_ignored) == category::warning);
+        TEST(note() == category::auxiliary);
+    }
+    {
+        // system headers are told apart by whole directories
+        raw_buffer in_system{"/usr/include/stdio.h", "\n"};
+        raw_buffer beside{"/usr/include2/stdio.h", "\n"};
+        raw_buffer deeper{"/usr/include/sys/types.h", "\n"};
+        const std::vector<std::string> flags = { "-isystem", "/usr/include" };
+        TEST(!mapped(flags, warning, location{in_system, 0}));
+        TEST(!mapped(flags, warning, location{deeper, 0}));
+        TEST(mapped(flags, warning, location{beside, 0}) ==
+             category::warning);
+        TEST(!mapped({ "-isystem", "/usr/include/" }, warning,
+                     location{in_system, 0}));
+        TEST(mapped(flags, error, location{in_system, 0}) ==
+             category::error);
+        TEST(!mapped({ "--system-header-prefix=/usr" }, warning,
+                     location{beside, 0}));
+        TEST(mapped({ "--system-header-prefix=/us" }, warning,
+                     location{beside, 0}) == category::warning);
+    }
+}
+
+void run_thread_pool_tests() {
+    std::println("running thread pool tests...");
+    std::atomic<int> done{0};
+    {
+        thread_pool pool{4};
+        for (int i = 0; i < 100; ++i) {
+            pool.submit([&] {
+                // tasks may spawn more tasks onto their own worker
+                pool.submit([&] { ++done; });
+                ++done;
+            });
+        }
+        pool.wait();
+        TEST(done == 200);
+    }
+    {
+        // tasks from outside the pool start in the order they came
+        thread_pool pool{1};
+        std::vector<int> order, expected;
+        for (int i = 0; i < 10; ++i) {
+            pool.submit([&order, i] { order.push_back(i); });
+            expected.push_back(i);
+        }
+        pool.wait();
+        TEST(order == expected);
+    }
+    {
+        // a worker waiting on tasks it submitted runs them itself rather
+        // than wait for a worker that will never come
+        thread_pool pool{1};
+        std::atomic<int> nested{0};
+        thread_pool* worker_pool = nullptr;
+        pool.submit([&] {
+            worker_pool = thread_pool::current();
+            for (int i = 0; i < 10; ++i) pool.submit([&] { ++nested; });
+            pool.wait_until([&] { return nested == 10; });
+        });
+        pool.wait();
+        TEST(worker_pool == &pool);
+        TEST(nested == 10);
+        TEST(!thread_pool::current());
+    }
+    {
+        capture captured;
+        std::print(output(), "captured");
+        TEST(captured.str() == "captured");
+    }
+    TEST(output() == stdout);
+}
+
+static std::optional<std::string> guard_of(std::string source) {
+    phase_three_tokens in{std::move(source)};
+    return pp::detect_include_guard(in.tokens);
+}
+
+void run_include_guard_tests() {
+    std::println("running include guard tests...");
+    TEST(guard_of("#ifndef A\n#define A\nint a;\n#endif\n") == "A");
+    TEST(guard_of("\n/* c */\n# ifndef B\n#if 1\n#endif\n#endif\n")
+         == "B");
+    TEST(!guard_of("#ifndef A\n#else\n#endif\n"));
+    TEST(!guard_of("#ifndef A\n#endif\nint a;\n"));
+    TEST(!guard_of("int a;\n#ifndef A\n#endif\n"));
+    TEST(!guard_of("#ifdef A\n#endif\n"));
+    TEST(!guard_of("#ifndef A\n#if 1\n#endif\n"));
+}
+
+// the spellings of the tokens phase 4 keeps, without white space
+static std::string kept_by_phase_four(std::string source) {
+    auto p4m = phase_three_tokens{std::move(source)}.phase_four();
+    std::string kept;
+    for (const auto& tok : p4m.process()) {
+        if (!tok.is(token::space) && !tok.is(token::newline)) {
+            kept += tok.spelling;
+        }
+    }
+    return kept;
+}
+
+static bool condition_holds(std::string expr) {
+    return kept_by_phase_four("#if " + expr + "\nyes\n#endif\n") == "yes";
+}
+
+// the distances map_conditionals finds, in source order
+static std::vector<std::size_t> conditional_distances(std::string source) {
+    phase_three_tokens in{std::move(source)};
+    auto map = pp::map_conditionals(in.tokens);
+    std::vector<std::size_t> distances;
+    for (const auto& tok : in.tokens) {
+        auto it = map.find(tok.spelling.data());
+        if (it != map.end()) distances.push_back(it->second);
+    }
+    return distances;
+}
+
+void run_conditional_tests() {
+    std::println("running conditional tests...");
+    TEST(condition_holds("1 + 2 * 3 == 7"));
+    TEST(condition_holds("-1 < 0 && !(-1 < 0u)"));
+    TEST(condition_holds("0x7fffffffffffffff > 0 && "
+                         "18446744073709551615 == -1"));
+    TEST(condition_holds("(-9223372036854775807 - 1) / -1 < 0"));
+    TEST(condition_holds("0 && 1 / 0 || 1 ? 2 : 1 % 0"));
+    TEST(condition_holds("'a' == 97 && '\\377' < 0 && L'\\x100' == 256"));
+    TEST(condition_holds("(-8 >> 1) == -4 && (1 << 63) < 0 && ~0u == -1"));
+    TEST(condition_holds("undefined_name == 0 && !defined undefined_name"));
+    TEST(condition_holds("defined __STDC__ && defined(__STDC__)"));
+    TEST(!condition_holds("0"));
+    TEST(kept_by_phase_four("#define N 2\n#define F(x) x * N\n"
+                            "#if F(N) != 4\na\n#elif defined N\nb\n"
+                            "#else\nc\n#endif\n") == "b");
+    TEST(kept_by_phase_four("#if 0\n#if 1\na\n#else\nb\n#endif\nc\n"
+                            "#elif 1\nd\n#elif 1\ne\n#endif\n") == "d");
+    TEST(kept_by_phase_four("#ifdef X\na\n#else\nb\n#endif\n") == "b");
+    TEST(conditional_distances("#if A\n#elif B\nb\n#else\n#endif\n")
+         == std::vector<std::size_t>({ 5, 7, 3 }));
+    TEST(conditional_distances("#if A\n#if B\n#endif\n#endif\n#endif\n")
+         == std::vector<std::size_t>({ 13, 5 }));
+    TEST(conditional_distances("a # if A\n#endif\n").empty());
+    // a remembered result is not reused once a macro it used changes
+    TEST(kept_by_phase_four("#define B 1\n#define A B\n#if A == 1\na\n#endif\n"
+                            "#undef B\n#define B 2\n#if A == 1\nb\n#endif\n"
+                            "#if X\nc\n#endif\n#define X 1\n#if X\nd\n#endif\n"
+                            "#if A == 1\ne\n#endif\n") == "ad");
+    // nor once a name made by ## while expanding it is defined
+    TEST(kept_by_phase_four("#define USE(f) USE_ ## f\n#if USE(X)\na\n"
+                            "#endif\n#define USE_X 1\n#if USE(X)\nb\n"
+                            "#endif\n") == "b");
+}
+
+void run_pch_tests() {
+    std::println("running precompiled header tests...");
+    auto path = std::filesystem::temp_directory_path() / "spcc-test.pch";
+    {
+        auto p4m = phase_three_tokens{
+            "#define SQ(x) ((x) * (x))\n#define A 1\n#undef A\n"
+        }.phase_four();
+        p4m.process();
+        TEST(p4m.write_pch(path.string()));
+    }
+    auto prefix = pp::pch::open(path.string());
+    TEST(prefix && prefix->macro_count() == 1);
+    if (prefix) {
+        auto sq = prefix->find_macro("SQ");
+        TEST(sq && sq->function_like && !sq->variadic);
+        TEST(sq && sq->param_names == std::vector<std::string_view>{"x"});
+        std::string body;
+        if (sq) for (const auto& tok : sq->body) body += tok.spelling;
+        TEST(body == " ((x) * (x))");
+        TEST(!prefix->find_macro("A"));
+        TEST(!prefix->find_macro("__STDC__"));
+    }
+    prefix.reset();
+    std::filesystem::remove(path);
+}
+
+void run_dependency_tests() {
+    std::println("running dependency tests...");
+    TEST(pp::format_dependencies("a.o", {"a.c", "a.h"}) == "a.o: a.c a.h\n");
+    TEST(pp::format_dependencies("a b.o", {"$x.h", "#.h"}) ==
+         "a\\ b.o: $$x.h \\#.h\n");
+    std::vector<std::string> long_names(3, std::string(30, 'h'));
+    auto rule = pp::format_dependencies("a.o", long_names);
+    TEST(rule.find(" \\\n") == 4 + 2 * 31);
+}
+
+// what -E writes for source, to path or to output() if it is empty
+static std::string preprocessed(std::string source,
+                                std::string name = "<test>",
+                                const std::string& path = {}) {
+    compilation_context context{options::parse({ "-E" })};
+    phase_three_tokens in{std::move(source), std::move(name)};
+    const auto& main = *in.buf;
+    auto p4m = std::move(in).phase_four();
+    auto tokens = p4m.process();
+    capture captured;
+    pp::write_preprocessed(tokens, main, path);
+    if (path.empty()) return captured.str();
+    std::ifstream file{path};
+    std::stringstream ss;
+    ss << file.rdbuf();
+    return ss.str();
+}
+
+void run_preprocessed_output_tests() {
+    std::println("running preprocessed output tests...");
+    // tokens that would lex as one are kept apart, and only those
+    TEST(preprocessed("#define E(x)x\nE(/)E(/) E(/)E(*) E(.)E(.)E(.) "
+                      "E(<)E(<=) E(-)E(>) E(%:)E(%:) E(+)E(+) E(+)E(=)\n") ==
+         "# 1 \"<test>\"\n\n/ / / * . . . < <= - > %: %: + + + =\n");
+    TEST(preprocessed("#define E(x)x\nE(1)E(.) E(.)E(1) E(1e)E(+) E(1)E(-) "
+                      "E(x)E(1) E(L)E('c') E(+)E(x) E(a.)E(b)\n") ==
+         "# 1 \"<test>\"\n\n1 . . 1 1e + 1 - x 1 L 'c' +x a.b\n");
+    // a few skipped lines are written out, but many make a marker
+    TEST(preprocessed("#if 0\n\n\n#endif\na\n") ==
+         "# 1 \"<test>\"\n\n\n\n\na\n");
+    TEST(preprocessed("#if 0\n\n\n\n\n\n\n\n\n\n\n#endif\na\n") ==
+         "# 1 \"<test>\"\n# 13 \"<test>\"\na\n");
+    // pragmas are left for the compiler, but #pragma once is done with
+    TEST(preprocessed("#define P 1\n#pragma pack(P)\nint a;\n#pragma once\n"
+                      "int b;\n") ==
+         "# 1 \"<test>\"\n\n#pragma pack(P)\nint a;\n\nint b;\n");
+    // a marker enters an include and one returns to the includer
+    namespace fs = std::filesystem;
+    const auto dir = fs::temp_directory_path() / "spcc-test-e";
+    fs::create_directories(dir);
+    std::ofstream{dir / "h.h"} << "int h;\n";
+    const auto main_name = (dir / "m.c").string();
+    const auto header_name = (dir / "h.h").string();
+    const auto with_include = "#include \"h.h\"\nint m;\n";
+    const auto expected = "# 1 \"" + main_name + "\"\n"
+                          "# 1 \"" + header_name + "\" 1\n"
+                          "int h;\n"
+                          "# 2 \"" + main_name + "\" 2\n"
+                          "int m;\n";
+    TEST(preprocessed(with_include, main_name) == expected);
+    // -o writes the same text to a file
+    const auto out = (dir / "m.i").string();
+    TEST(preprocessed(with_include, main_name, out) == expected);
+    // a header after another is entered from the includer, not from the
+    // first header
+    std::ofstream{dir / "g.h"} << "int g;\n";
+    const auto sibling_name = (dir / "g.h").string();
+    const auto siblings = "#include \"h.h\"\n#include \"g.h\"\nint m;\n";
+    TEST(preprocessed(siblings, main_name) ==
+         "# 1 \"" + main_name + "\"\n"
+         "# 1 \"" + header_name + "\" 1\n"
+         "int h;\n"
+         "# 2 \"" + main_name + "\" 2\n"
+         "# 1 \"" + sibling_name + "\" 1\n"
+         "int g;\n"
+         "# 3 \"" + main_name + "\" 2\n"
+         "int m;\n");
+    fs::remove_all(dir);
+}
+
+void run_ruleset_tests() {
+    std::println("running ruleset tests...");
+    // no token may start more than one rule
+    TEST(parse::expr_ruleset.prefix_rules.conflicts() == 0);
+    TEST(parse::expr_ruleset.infix_rules.conflicts() == 0);
+    TEST(parse::declarator_ruleset.prefix_rules.conflicts() == 0);
+    TEST(parse::declarator_ruleset.infix_rules.conflicts() == 0);
+    const token* star = nullptr;
+    const token* semicolon = nullptr;
+    for (const auto& tok : parse::token_shapes()) {
+        if (tok.is(punctuator::star)) star = &tok;
+        if (tok.is(punctuator::semicolon)) semicolon = &tok;
+    }
+    TEST(star && parse::expr_ruleset.prefix_rules.find(*star));
+    TEST(star && parse::expr_ruleset.infix_rules.find(*star));
+    TEST(semicolon && !parse::expr_ruleset.infix_rules.find(*semicolon));
+    std::set<std::size_t> slots;
+    for (const auto& tok : parse::token_shapes()) {
+        slots.insert(parse::dispatch_index(tok));
+    }
+    TEST(slots.size() == parse::token_shapes().size());
+}
+
+void run_ast_tests() {
+    std::println("running ast tests...");
+    using parse::node_kind;
+    {
+        parser_input in{"a + b * c\n"};
+        parse::parser p{in.tokens};
+        p.push_ruleset(false);
+        auto root = p.parse(0);
+        p.pop_ruleset();
+        // children are made before their parents
+        TEST(p.tree().size() == 5);
+        TEST(root == 4);
+        auto range = p.tree().range(root);
+        TEST(range.first.offset() == 0);
+        TEST(range.second.offset() == in.tokens[4].range.second.offset());
+        std::vector<node_kind> order;
+        std::vector<parse::node_id> finished;
+        auto kind_of = [&](parse::node_id id) {
+            order.push_back(p.tree()[id].kind());
+        };
+        auto finish = [&](parse::node_id id) { finished.push_back(id); };
+        parse::walk(p.tree(), root, kind_of, finish);
+        const std::vector<node_kind> preorder = {
+            node_kind::binary, node_kind::token, node_kind::binary,
+            node_kind::token, node_kind::token,
+        };
+        const std::vector<parse::node_id> postorder = { 0, 1, 2, 3, 4 };
+        TEST(order == preorder);
+        TEST(finished == postorder);
+    }
+    {
+        parser_input in{"f(x, y + 1)\n"};
+        parse::parser p{in.tokens};
+        p.push_ruleset(false);
+        auto root = p.parse(0);
+        p.pop_ruleset();
+        std::size_t children = 0;
+        parse::for_each_child(p.tree(), root, [&](parse::node_id) {
+            ++children;
+        });
+        TEST(children == 3);
+        auto is_call = [](const auto& n) {
+            return n.kind_tag == node_kind::call;
+        };
+        TEST(parse::visit(p.tree(), root, is_call));
+    }
+    {
+        // the cursor stops at the end instead of running off it
+        parser_input in{"\n"};
+        TEST(in.tokens.size() == 1);
+        TEST(in.tokens[0].is(token::end_of_input));
+        parse::parser p{in.tokens};
+        TEST(!p.has_next_token());
+        TEST(p.next().is(token::end_of_input));
+        TEST(p.peek().is(token::end_of_input));
+    }
+    {
+        // a syntax error leaves an error node where the operand should be
+        parser_input in{"(a + ) b;\n"};
+        parse::parser p{in.tokens};
+        p.push_ruleset(false);
+        auto root = p.parse(0);
+        p.pop_ruleset();
+        TEST(p.recovering());
+        std::size_t errors = 0;
+        auto count_errors = [&](parse::node_id id) {
+            if (p.tree()[id].kind() == node_kind::error) ++errors;
+        };
+        parse::walk(p.tree(), root, count_errors, [](parse::node_id) { });
+        TEST(errors == 1);
+        TEST(p.peek().is(punctuator::paren_right));
+        p.synchronize();
+        TEST(!p.recovering());
+        TEST(!p.has_next_token());
+    }
+    {
+        // a missing ) is left out of the range rather than replaced by
+        // whatever came instead
+        parser_input in{"(a + b c\n"};
+        parse::parser p{in.tokens};
+        p.push_ruleset(false);
+        auto root = p.parse(0);
+        p.pop_ruleset();
+        const auto& paren = static_cast<const parse::paren_node&>(
+            p.tree()[root]
+        );
+        TEST(paren.rparen() == parse::no_token);
+        TEST(p.tree().range(root).second.offset() ==
+             in.tokens[3].range.second.offset());
+    }
+    {
+        // enough nodes to fill several blocks
+        std::string sum = "1";
+        for (int i = 0; i < 10000; ++i) sum += " + 1";
+        parser_input in{sum + "\n"};
+        parse::parser p{in.tokens};
+        p.push_ruleset(false);
+        auto root = p.parse(0);
+        p.pop_ruleset();
+        TEST(p.tree().size() == 20001);
+        TEST(root == 20000);
+        TEST(p.tree().range(root).second.offset() ==
+             in.tokens[20000].range.second.offset());
+    }
+}
+
+void run_translation_unit_tests() {
+    std::println("running translation unit tests...");
+    using parse::node_kind;
+    auto count_kind = [](const parse::ast& tree, parse::node_id root,
+                         node_kind kind) {
+        std::size_t count = 0;
+        parse::walk(tree, root, [&](parse::node_id id) {
+            if (tree[id].kind() == kind) ++count;
+        }, [](parse::node_id) { });
+        return count;
+    };
+    {
+        // a typedef name makes a parenthesized name a cast
+        parser_input in{"typedef int T;\n"
+                        "int f(int a, int b) {\n"
+                        "    T x = (T)a * (b) - sizeof(T);\n"
+                        "    return x == a ? x : (x = b);\n"
+                        "}\n"};
+        parse::parser p{in.tokens};
+        auto root = parse::parse_translation_unit(p);
+        const auto& tree = p.tree();
+        TEST(!p.recovering());
+        TEST(!p.has_next_token());
+        TEST(tree[root].kind() == node_kind::translation_unit);
+        TEST(count_kind(tree, root, node_kind::function_definition) == 1);
+        TEST(count_kind(tree, root, node_kind::cast) == 1);
+        TEST(count_kind(tree, root, node_kind::paren) == 2);
+        TEST(count_kind(tree, root, node_kind::type_query) == 1);
+        TEST(count_kind(tree, root, node_kind::ternary) == 1);
+        TEST(count_kind(tree, root, node_kind::error) == 0);
+    }
+    {
+        // == compares and = assigns, right to left
+        parser_input in{"a = b = c == d\n"};
+        parse::parser p{in.tokens};
+        auto root = parse::parse_expression(p);
+        const auto& tree = p.tree();
+        const auto& assign = static_cast<const parse::binary_node&>(tree[root]);
+        TEST(tree.token_at(assign.token()).is(punctuator::equal));
+        const auto& rhs = static_cast<const parse::binary_node&>(
+            tree[assign.rhs()]
+        );
+        TEST(tree.token_at(rhs.token()).is(punctuator::equal));
+        TEST(tree[rhs.rhs()].kind() == node_kind::binary);
+    }
+    {
+        // a function definition, as opposed to a pointer to a function
+        parser_input in{"int (*f)(void);\n"
+                        "int *g(void) { return 0; }\n"};
+        parse::parser p{in.tokens};
+        auto root = parse::parse_translation_unit(p);
+        TEST(count_kind(p.tree(), root, node_kind::declaration) == 1);
+        TEST(count_kind(p.tree(), root, node_kind::function_definition) == 1);
+    }
+    {
+        // errors are recovered from at the next ; or }
+        parser_input in{"int a = ;\n"
+                        "void f(void) { g(; h(); }\n"
+                        "struct s { int x y; int z; } b;\n"};
+        parse::parser p{in.tokens};
+        auto root = parse::parse_translation_unit(p);
+        const auto& tree = p.tree();
+        TEST(!p.recovering());
+        auto& unit = static_cast<const parse::translation_unit_node&>(
+            tree[root]
+        );
+        TEST(unit.declarations().count == 3);
+        TEST(count_kind(tree, root, node_kind::compound_statement) == 1);
+        TEST(count_kind(tree, root, node_kind::record) == 1);
+        TEST(count_kind(tree, root, node_kind::error) == 2);
+    }
+    {
+        // a struct whose } is missing still has its members, and ends
+        // with the last of them
+        parser_input in{"struct s { int x;\n"};
+        parse::parser p{in.tokens};
+        auto root = parse::parse_translation_unit(p);
+        const auto& tree = p.tree();
+        const parse::record_node* record = nullptr;
+        parse::walk(tree, root, [&](parse::node_id id) {
+            if (tree[id].kind() != node_kind::record) return;
+            record = &static_cast<const parse::record_node&>(tree[id]);
+        }, [](parse::node_id) { });
+        TEST(record && record->has_members());
+        TEST(record && record->members().count == 1);
+        TEST(tree.range(root).second.offset() ==
+             in.tokens[5].range.second.offset());
+    }
+    {
+        // the declarations of an identifier list without a body
+        parser_input in{"int f(a) int a;\n"};
+        parse::parser p{in.tokens};
+        auto root = parse::parse_translation_unit(p);
+        TEST(count_kind(p.tree(), root, node_kind::function_definition) == 1);
+        TEST(count_kind(p.tree(), root, node_kind::compound_statement) == 0);
+        TEST(count_kind(p.tree(), root, node_kind::error) == 1);
+        TEST(p.tree().range(root).second.offset() ==
+             in.tokens[8].range.second.offset());
+    }
+    {
+        // a block recovers short of its own }, so the definitions after
+        // it are not taken for its statements
+        parser_input in{"void f(void) { g(1 + ) }\n"
+                        "int h(void) { return 0; }\n"
+                        "int k(void) { return 1; }\n"};
+        parse::parser p{in.tokens};
+        capture captured;
+        auto root = parse::parse_translation_unit(p);
+        const auto& tree = p.tree();
+        auto& unit = static_cast<const parse::translation_unit_node&>(
+            tree[root]
+        );
+        TEST(unit.declarations().count == 3);
+        TEST(count_kind(tree, root, node_kind::function_definition) == 3);
+        TEST(count_kind(tree, root, node_kind::error) == 1);
+        TEST(captured.str().find("expected") ==
+             captured.str().rfind("expected"));
+    }
+    {
+        // leaving a scope brings back what it hid, however often
+        parse::scope_table scopes;
+        scopes.declare("T", { true, nullptr });
+        scopes.push_scope();
+        scopes.declare("T", { false, nullptr });
+        scopes.declare("x", { false, nullptr });
+        TEST(!scopes.find("T")->is_typedef);
+        scopes.declare("T", { true, nullptr });
+        TEST(scopes.find("T")->is_typedef);
+        scopes.pop_scope();
+        TEST(scopes.depth() == 0);
+        TEST(scopes.find("T") && scopes.find("T")->is_typedef);
+        TEST(!scopes.find("x"));
+    }
+    {
+        // an inner declaration hides a typedef name until its scope ends
+        parser_input in{"typedef int T;\n"
+                        "void f(void) {\n"
+                        "    T a;\n"
+                        "    { int T; T * a; }\n"
+                        "    T * b;\n"
+                        "    for (int T = 0; T < 1; ) T * c;\n"
+                        "    T * d;\n"
+                        "}\n"
+                        "void g(int T) { T * e; }\n"
+                        "T h;\n"};
+        parse::parser p{in.tokens};
+        auto root = parse::parse_translation_unit(p);
+        const auto& tree = p.tree();
+        TEST(!p.recovering());
+        TEST(count_kind(tree, root, node_kind::expression_statement) == 3);
+        TEST(count_kind(tree, root, node_kind::declaration) == 7);
+    }
+    {
+        // a name is declared before its initializer, so the T in sizeof
+        // is the int being declared rather than the typedef name
+        parser_input in{"typedef int T;\n"
+                        "void f(void) { int T = sizeof(T); }\n"};
+        parse::parser p{in.tokens};
+        auto root = parse::parse_translation_unit(p);
+        TEST(!p.recovering());
+        TEST(count_kind(p.tree(), root, node_kind::type_query) == 0);
+        TEST(count_kind(p.tree(), root, node_kind::paren) == 1);
+    }
+    {
+        // only the braces of file scope pair up, and an unclosed { with
+        // nothing
+        parser_input in{"struct s { int a; } x = { 1 };\n"
+                        "void f(void) { { } }\n"
+                        "void g(void) {\n"};
+        auto braces = parse::skim_braces(in.tokens);
+        TEST(braces.size() == 3);
+        TEST(in.tokens[braces[2].open].is(punctuator::curly_left));
+        TEST(in.tokens[braces[2].close].is(punctuator::curly_right));
+        TEST(in.tokens[braces[2].open - 1].is(punctuator::paren_right));
+    }
+    {
+        // bodies parsed on threads see the typedef names declared before
+        // them, and end up with the nodes of a parse in order
+        std::string source = "typedef int T;\n";
+        for (int i = 0; i < 40; ++i) {
+            source += "int f" + std::to_string(i) +
+                      "(int a) { T * x; U * y; return a; }\n";
+            if (i == 19) source += "typedef int U;\n";
+        }
+        source += "int g(int T) { T * z; }\n";
+        parser_input in{source};
+        parse::parser p{in.tokens};
+        auto root = parse::parse_translation_unit(p);
+        auto unit = parse::parse_translation_unit_parallel(in.tokens, 4);
+        TEST(unit.bodies().size() == 41);
+        TEST(unit.node_count() == p.tree().size());
+        auto count_all = [&](node_kind kind) {
+            auto result = count_kind(unit.top->tree(), unit.root, kind);
+            for (const auto& body : unit.bodies()) {
+                result += count_kind(unit.tree_of(body), body.body, kind);
+            }
+            return result;
+        };
+        for (auto kind : { node_kind::declaration,
+                           node_kind::expression_statement,
+                           node_kind::return_statement }) {
+            TEST(count_all(kind) == count_kind(p.tree(), root, kind));
+        }
+        TEST(count_all(node_kind::declaration) == 62);
+        TEST(count_all(node_kind::expression_statement) == 21);
+        // and the types the bodies make are those of the unit
+        TEST(&unit.body_parsers.back()->tm == &unit.top->tm);
+    }
+    {
+        // bodies parsed on threads stop at the unit's error limit between
+        // them, rather than each going up to it
+        std::string source;
+        for (int i = 0; i < 40; ++i) {
+            source += "int f" + std::to_string(i) + "(void) { return +; }\n";
+        }
+        parser_input in{source};
+        auto config = current_context().options;
+        config.error_limit = 3;
+        compilation_context context{config};
+        capture captured;
+        bool stopped = false;
+        try {
+            parse::parse_translation_unit_parallel(in.tokens, 8);
+        } catch (const diagnostic::error_limit_reached&) {
+            stopped = true;
+        }
+        auto count = [](const std::string& text, std::string_view what) {
+            std::size_t result = 0;
+            for (auto at = text.find(what); at != std::string::npos;
+                 at = text.find(what, at + 1)) ++result;
+            return result;
+        };
+        auto text = captured.str() + captured.error_str();
+        TEST(stopped);
+        TEST(count(text, "expected expression") <= 3);
+        TEST(count(text, "too many errors") == 1);
+    }
+    {
+        // a lazy parse leaves bodies until they are asked for, but not
+        // one whose parentheses do not balance
+        parser_input in{"typedef int T;\n"
+                        "int f(int a) { T * b; return a; }\n"
+                        "void g(void) { h(; }\n"
+                        "int k(void) { return (0); }\n"};
+        parse::parser p{in.tokens};
+        parse::parse_translation_unit(p);
+        auto unit = parse::parse_translation_unit_lazy(in.tokens);
+        TEST(unit.bodies().size() == 2);
+        TEST(unit.node_count() < p.tree().size());
+        TEST(count_kind(unit.top->tree(), unit.root,
+                        node_kind::compound_statement) == 1);
+        auto body = unit.body(1);
+        TEST(unit.body(1) == body);
+        TEST(unit.body(0) != parse::no_node);
+        const auto& first = unit.bodies()[0];
+        TEST(count_kind(unit.tree_of(first), first.body,
+                        node_kind::declaration) == 1);
+        TEST(unit.node_count() == p.tree().size());
+    }
+}
+
+void run_type_tests() {
+    std::println("running type tests...");
+    using namespace sem;
+    type_manager tm;
+    auto i = tm.get_integer_type(ik_int, true);
+    auto c = tm.get_integer_type(ik_char, false);
+    TEST(i == tm.get_integer_type(ik_int, true));
+    TEST(i != tm.get_integer_type(ik_int, false));
+    TEST(tm.get_real_floating_type(fk_double)->to_string() == "double");
+    {
+        // the same derivation is the same type
+        auto ptr = tm.build_pointer_to(i);
+        TEST(ptr == tm.build_pointer_to(i));
+        TEST(ptr != tm.build_pointer_to(c));
+        TEST(ptr->pointee() == i);
+        auto arr = tm.build_array_of(ptr, 4);
+        TEST(arr == tm.build_array_of(tm.build_pointer_to(i), 4));
+        TEST(arr != tm.build_array_of(ptr, 5));
+        TEST(arr != tm.build_array_of(ptr, std::nullopt));
+        TEST(arr->is_complete_object_type());
+        TEST(!tm.build_array_of(ptr, std::nullopt)->array_size());
+        TEST(*arr->array_size() == 4);
+    }
+    {
+        // qualifiers are bits of the handle, but those of an array go to
+        // its elements
+        qual_type ci{i, q_const};
+        TEST(ci.get() == i);
+        TEST(ci != qual_type{i});
+        TEST(ci.unqualified() == qual_type{i});
+        auto cvi = ci.with_qualifiers(q_volatile);
+        TEST(cvi == tm.qualify(i, q_volatile | q_const));
+        TEST(cvi.qualifiers() == (q_const | q_volatile));
+        TEST(cvi.without_qualifiers(q_const).is_volatile());
+        TEST(!cvi.without_qualifiers(q_const).is_const());
+        TEST(tm.qualify(i, 0) == qual_type{i});
+        TEST(cvi.to_string() == "const volatile int");
+        auto before = tm.size();
+        tm.qualify(cvi, q_restrict | q_Atomic);
+        TEST(tm.size() == before);
+        auto arr = tm.qualify(tm.build_array_of(i, 2), q_const);
+        TEST(arr.qualifiers() == 0);
+        TEST(arr->element() == ci);
+        // a pointer to const is not a const pointer
+        auto pci = tm.build_pointer_to(ci);
+        TEST(pci != tm.build_pointer_to(i));
+        TEST(pci->pointee().is_const());
+        TEST(pci->to_string() == "const int*");
+    }
+    {
+        // parameters compare unqualified
+        const qual_type params[] = { i, { c, q_const } };
+        const qual_type plain[] = { i, c };
+        auto f = tm.build_function(i, params, false, true);
+        TEST(f == tm.build_function(i, plain, false, true));
+        TEST(f != tm.build_function(i, plain, true, true));
+        TEST(f != tm.build_function(i, {}, false, true));
+        TEST(tm.build_function(i, {}, false, false) !=
+             tm.build_function(i, {}, false, true));
+        TEST(f->parameters().size() == 2);
+        TEST(f->to_string() == "int(int, unsigned char)");
+        auto before = tm.size();
+        tm.build_function(i, plain, false, true);
+        TEST(tm.size() == before);
+        // array and function parameters are pointers
+        const qual_type array[] = { tm.build_array_of(i, 3) };
+        const qual_type pointer[] = { tm.build_pointer_to(i) };
+        TEST(tm.build_function(i, array, false, true) ==
+             tm.build_function(i, pointer, false, true));
+        const qual_type function[] = { f };
+        const qual_type function_pointer[] = { tm.build_pointer_to(f) };
+        TEST(tm.build_function(i, function, false, true) ==
+             tm.build_function(i, function_pointer, false, true));
+        // derived types are written with declarator syntax
+        auto to_array = tm.build_pointer_to(tm.build_array_of(i, 3));
+        TEST(to_array->to_string() == "int(*)[3]");
+        TEST(tm.build_pointer_to(f)->to_string() ==
+             "int(*)(int, unsigned char)");
+        TEST(tm.build_array_of(tm.build_pointer_to(f), 2)->to_string() ==
+             "int(*[2])(int, unsigned char)");
+        qual_type const_pointer{tm.build_pointer_to(i), q_const};
+        TEST(const_pointer.to_string() == "int* const");
+        TEST(tm.build_pointer_to(const_pointer)->to_string() ==
+             "int* const *");
+    }
+    {
+        // threads making the same type at once get the same type
+        std::vector<const type*> made(8);
+        {
+            thread_pool pool{4};
+            for (std::size_t t = 0; t < made.size(); ++t) {
+                pool.submit([&, t] {
+                    const type* ty = i;
+                    for (int depth = 0; depth < 100; ++depth) {
+                        ty = tm.build_pointer_to(tm.build_array_of(ty, 2));
+                    }
+                    made[t] = ty;
+                });
+            }
+            pool.wait();
+        }
+        TEST(std::set<const type*>(made.begin(), made.end()).size() == 1);
+    }
+    {
+        // each structure is a type of its own
+        auto s = tm.create_tagged(tk_structure, "s");
+        auto t = tm.create_tagged(tk_structure, "s");
+        TEST(s != t);
+        TEST(!s->is_complete_object_type());
+        member members[] = { { "x", i }, { "y", c } };
+        tm.complete_record(s, members);
+        TEST(s->is_complete_object_type());
+        TEST(s->members().size() == 2);
+        TEST(s->to_string() == "struct s");
+    }
+}
+
 void run_utf8_tests() {
     std::println("running UTF-8 tests...");
     TEST(utf8::is_ascii('a'));
@@ -0,0 +1,131 @@
+#include "thread_pool.hh"
+
+#include <cassert>
+
+namespace {
+    // the pool and queue the calling thread works for, if any
+    thread_local thread_pool* current_pool = nullptr;
+    thread_local unsigned current_queue = 0;
+}
+
+thread_pool::thread_pool(unsigned workers) {
+    assert(workers > 0);
+    for (unsigned i = 0; i < workers; ++i) {
+        queues.push_back(std::make_unique<worker_queue>());
+    }
+    for (unsigned i = 0; i < workers; ++i) {
+        threads.emplace_back([this, i] { run(i); });
+    }
+}
+
+thread_pool::~thread_pool() {
+    wait();
+    {
+        std::lock_guard lock{mutex};
+        stopping = true;
+    }
+    work_available.notify_all();
+    for (auto& thread : threads) thread.join();
+}
+
+void thread_pool::submit(task t) {
+    std::unique_lock lock{mutex};
+    ++queued;
+    ++unfinished;
+    if (current_pool != this) {
+        submitted.push_back(std::move(t));
+    } else {
+        lock.unlock();
+        auto& queue = *queues[current_queue];
+        std::lock_guard queue_lock{queue.mutex};
+        queue.tasks.push_back(std::move(t));
+    }
+    work_available.notify_one();
+}
+
+void thread_pool::wait() {
+    std::unique_lock lock{mutex};
+    task_finished.wait(lock, [this] { return unfinished == 0; });
+}
+
+void thread_pool::wait_until(const std::function<bool()>& done) {
+    if (current_pool != this) {
+        std::unique_lock lock{mutex};
+        task_finished.wait(lock, done);
+        return;
+    }
+    while (!done()) {
+        // not from the shared queue, whose tasks are the caller's peers
+        // and may take much longer than what it waits for
+        task t;
+        if (pop(current_queue, t) || steal(current_queue, t)) {
+            execute(t);
+            continue;
+        }
+        std::unique_lock lock{mutex};
+        task_finished.wait(lock, [&] {
+            return done() || queued > submitted.size();
+        });
+    }
+}
+
+thread_pool* thread_pool::current() {
+    return current_pool;
+}
+
+bool thread_pool::pop(unsigned self, task& t) {
+    auto& queue = *queues[self];
+    std::lock_guard lock{queue.mutex};
+    if (queue.tasks.empty()) return false;
+    t = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool thread_pool::pop_submitted(task& t) {
+    std::lock_guard lock{mutex};
+    if (submitted.empty()) return false;
+    t = std::move(submitted.front());
+    submitted.pop_front();
+    return true;
+}
+
+bool thread_pool::steal(unsigned self, task& t) {
+    for (std::size_t i = 1; i < queues.size(); ++i) {
+        auto& queue = *queues[(self + i) % queues.size()];
+        std::lock_guard lock{queue.mutex};
+        if (queue.tasks.empty()) continue;
+        t = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+void thread_pool::execute(task& t) {
+    {
+        std::lock_guard lock{mutex};
+        --queued;
+    }
+    t();
+    std::lock_guard lock{mutex};
+    --unfinished;
+    task_finished.notify_all();
+}
+
+void thread_pool::run(unsigned self) {
+    current_pool = this;
+    current_queue = self;
+    while (true) {
+        task t;
+        if (pop(self, t) || pop_submitted(t) || steal(self, t)) {
+            execute(t);
+            continue;
+        }
+        std::unique_lock lock{mutex};
+        // a task counted in queued may not have reached its deque yet,
+        // in which case the next pop or steal attempt will find it
+        work_available.wait(lock, [this] { return stopping || queued > 0; });
+        if (stopping && !queued) return;
+    }
+}
@@ -0,0 +1,104 @@
+#include "trace.hh"
+#include "context.hh"
+#include "diagnostic.hh"
+
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <print>
+#include <vector>
+
+using diagnostic::diagnose;
+
+namespace {
+    struct event {
+        std::string name;
+        std::string detail;
+        std::chrono::microseconds start;
+        std::chrono::microseconds duration;
+        unsigned thread;
+    };
+
+    const auto epoch = std::chrono::steady_clock::now();
+    std::mutex events_mutex;
+    std::vector<event> events;
+
+    unsigned current_thread_id() {
+        static std::atomic<unsigned> next_id{0};
+        thread_local unsigned id = next_id++;
+        return id;
+    }
+
+    std::string escape_json(std::string_view str) {
+        std::string result;
+        for (char c : str) {
+            if (c == '"') result += "\\\"";
+            else if (c == '\\') result += "\\\\";
+            else if (c == '\n') result += "\\n";
+            else if ((unsigned char)c < 0x20) result += ' ';
+            else result += c;
+        }
+        return result;
+    }
+}
+
+namespace trace {
+    bool enabled() {
+        return !current_context().options.time_trace_file.empty();
+    }
+
+    span::span(std::string_view name, std::string_view detail,
+               bool always_record) :
+    name{name}, detail{detail}, always_record{always_record},
+    active{enabled()} {
+        if (active) start = std::chrono::steady_clock::now();
+    }
+
+    span::~span() {
+        using std::chrono::duration_cast;
+        using std::chrono::microseconds;
+        if (!active) return;
+        auto end = std::chrono::steady_clock::now();
+        auto duration = duration_cast<microseconds>(end - start);
+        auto granularity = microseconds(
+            current_context().options.time_trace_granularity
+        );
+        if (!always_record && duration < granularity) return;
+        event ev{
+            std::string(name), std::string(detail),
+            duration_cast<microseconds>(start - epoch), duration,
+            current_thread_id()
+        };
+        std::lock_guard lock{events_mutex};
+        events.push_back(std::move(ev));
+    }
+
+    void write(const std::string& filename) {
+        FILE* f = std::fopen(filename.c_str(), "w");
+        if (!f) {
+            diagnose(diagnostic::id::cannot_open_file, {}, filename);
+            return;
+        }
+        std::lock_guard lock{events_mutex};
+        std::println(f, "{{\"traceEvents\": [");
+        for (std::size_t i = 0; i < events.size(); ++i) {
+            const auto& ev = events[i];
+            std::print(f, "{{\"name\": \"{}\", \"ph\": \"X\", \"pid\": 1, "
+                       "\"tid\": {}, \"ts\": {}, \"dur\": {}",
+                       escape_json(ev.name), ev.thread,
+                       ev.start.count(), ev.duration.count());
+            if (!ev.detail.empty()) {
+                std::print(f, ", \"args\": {{\"detail\": \"{}\"}}",
+                           escape_json(ev.detail));
+            }
+            std::println(f, "}}{}", i + 1 < events.size() ? "," : "");
+        }
+        std::println(f, "], \"displayTimeUnit\": \"ms\"}}");
+        std::fclose(f);
+    }
+
+    void reset() {
+        std::lock_guard lock{events_mutex};
+        events = {};
+    }
+}
@@ -1,8 +1,77 @@
 #include "type.hh"
 
+#include <algorithm>
 #include <cassert>
+#include <functional>
 #include <utility>
 
+namespace {
+    std::string floating_name(sem::floating_kind kind) {
+        switch (kind) {
+            case sem::fk_float: return "float";
+            case sem::fk_double: return "double";
+            case sem::fk_long_double: return "long double";
+        }
+        return "???";
+    }
+
+    // the qualifiers of ty as written before it, each followed by a space
+    std::string qualifier_words(sem::qual_type ty) {
+        std::string result;
+        if (ty.is_const()) result += "const ";
+        if (ty.is_volatile()) result += "volatile ";
+        if (ty.is_restrict()) result += "restrict ";
+        if (ty.is_atomic()) result += "_Atomic ";
+        return result;
+    }
+
+    // ty written as a declaration with inner as its declarator, so that
+    // a pointer to an array of int is int(*)[3] rather than int[3]*
+    std::string declare(sem::qual_type ty, std::string inner) {
+        switch (ty->type_kind()) {
+            case sem::tk_pointer: {
+                // the pointer's own qualifiers go after the *, as in
+                // int* const
+                auto quals = qualifier_words(ty);
+                if (!quals.empty()) {
+                    quals.pop_back();
+                    inner = " " + quals + (inner.empty() ? "" : " ") + inner;
+                }
+                inner = "*" + inner;
+                auto pointee = ty->pointee()->type_kind();
+                if (pointee == sem::tk_array || pointee == sem::tk_function) {
+                    inner = "(" + inner + ")";
+                }
+                return declare(ty->pointee(), std::move(inner));
+            }
+            case sem::tk_array:
+                inner += "[";
+                if (auto size = ty->array_size()) {
+                    inner += std::to_string(*size);
+                }
+                inner += "]";
+                return declare(ty->element(), std::move(inner));
+            case sem::tk_function: {
+                auto params = ty->parameters();
+                inner += "(";
+                for (std::size_t i = 0; i < params.size(); ++i) {
+                    if (i) inner += ", ";
+                    inner += params[i]->to_string();
+                }
+                if (ty->is_variadic()) {
+                    inner += params.empty() ? "..." : ", ...";
+                } else if (ty->has_prototype() && params.empty()) {
+                    inner += "void";
+                }
+                inner += ")";
+                return declare(ty->return_type(), std::move(inner));
+            }
+            default:
+                return qualifier_words(ty) + ty->to_string() + inner;
+        }
+    }
+}
+
 namespace sem {
     bool type::is_basic_type() const {
         switch (type_kind()) {
@@ -90,13 +159,27 @@ namespace sem {
             case tk_structure:
             case tk_union:
             case tk_enum:
+                return complete;
             case tk_array:
-                assert(false); // TODO
+                return array.has_size &&
+                       array.element->is_complete_object_type();
             default:
                 return true;
         }
     }
 
+    std::optional<std::uint64_t> type::array_size() const {
+        assert(type_kind() == tk_array);
+        if (!array.has_size) return {};
+        return array.count;
+    }
+
+    bool type::is_complete() const {
+        assert(type_kind() == tk_structure || type_kind() == tk_union ||
+               type_kind() == tk_enum);
+        return complete;
+    }
+
     bool type::is_incomplete_object_type() const {
         return is_object_type() && !is_complete_object_type();
     }
@@ -133,25 +216,23 @@ namespace sem {
                 break;
             }
             case tk_real_floating:
-                switch (float_kind) {
-                    case fk_float:
-                        result = "float";
-                        break;
-                    case fk_double:
-                        result = "double";
-                        break;
-                    case fk_long_double:
-                        result = "long double";
-                        break;
-                }
+                result = floating_name(float_kind);
+                break;
+            case tk_complex_floating:
+                result = floating_name(float_kind) + " _Complex";
+                break;
+            case tk_pointer:
+            case tk_function:
+            case tk_array:
+                result = declare(this, {});
+                break;
+            case tk_structure:
+            case tk_union:
+            case tk_enum:
+                result = kind == tk_structure ? "struct"
+                         : kind == tk_union ? "union" : "enum";
+                if (tag_length) result += " " + std::string(tag());
                 break;
-            case tk_pointer: {
-                if (pointee_type->type_kind() == tk_function) {
-                    assert(false); // TODO
-                } else {
-                    result = pointee_type->to_string() + "*";
-                }
-            }
             default:
                 result = "???";
                 break;
@@ -159,80 +240,168 @@ namespace sem {
         return result;
     }
 
+    std::string qual_type::to_string() const {
+        return declare(*this, {});
+    }
+
     using tm = type_manager;
 
-    type_manager::type_manager() {
-        // create standard types
-        void_type = std::make_unique<type>(tk_void);
-        initialize_integer_types();
-        initialize_floating_types();
+    bool tm::type_key::operator==(const type_key& other) const {
+        return kind == other.kind && base == other.base &&
+               extent == other.extent &&
+               std::equal(params.begin(), params.end(),
+                          other.params.begin(), other.params.end());
     }
 
-    const type* tm::build_pointer_to(const type* ty) {
-        auto it = pointer_types.find(ty);
-        if (it != pointer_types.end()) return it->second.get();
-        auto ptr_ty = std::make_unique<type>(tk_pointer);
-        ptr_ty->pointee_type = ty;
-        pointer_types[ty] = std::move(ptr_ty);
-        return pointer_types[ty].get();
+    std::size_t tm::key_hash::operator()(const type_key& key) const {
+        std::size_t result = std::hash<std::uintptr_t>{}(key.base);
+        auto mix = [&](std::size_t value) {
+            result ^= value + 0x9e3779b97f4a7c15 + (result << 6) +
+                      (result >> 2);
+        };
+        mix(key.kind);
+        mix(std::hash<std::uint64_t>{}(key.extent));
+        for (auto param : key.params) mix(std::hash<const type*>{}(param));
+        return result;
     }
 
-    void tm::initialize_integer_types() {
-        register_integer_type(integer_kind::ik_bool, false);
-        register_integer_type(integer_kind::ik_char, false);
-        register_integer_type(integer_kind::ik_int, false);
-        register_integer_type(integer_kind::ik_long, false);
-        register_integer_type(integer_kind::ik_long_long, false);
-        register_integer_type(integer_kind::ik_short, false);
-
-        register_integer_type(integer_kind::ik_char, true);
-        register_integer_type(integer_kind::ik_int, true);
-        register_integer_type(integer_kind::ik_long, true);
-        register_integer_type(integer_kind::ik_long_long, true);
-        register_integer_type(integer_kind::ik_short, true);
+    template<typename F>
+    const type* tm::intern(const type_key& key, F&& make) {
+        std::lock_guard lock{mutex};
+        auto it = interned.find(key);
+        if (it != interned.end()) return it->second;
+        auto& ty = derived.emplace_back(key.kind);
+        // the stored key must not point into the caller's parameters
+        auto stored = key;
+        stored.params = make(ty);
+        interned.emplace(stored, &ty);
+        return &ty;
     }
 
-    void tm::initialize_floating_types() {
-        register_floating_type(fk_float, true);
-        register_floating_type(fk_double, true);
-        register_floating_type(fk_long_double, true);
+    type_manager::type_manager() {
+        for (std::size_t i = 0; i < integer_kind_count; ++i) {
+            for (bool is_signed : { false, true }) {
+                auto& ty = (is_signed ? signed_integer_types
+                                      : unsigned_integer_types)[i];
+                ty = type{tk_integer};
+                ty.int_kind = static_cast<integer_kind>(i);
+                ty.is_signed = is_signed;
+            }
+        }
+        for (std::size_t i = 0; i < floating_kind_count; ++i) {
+            real_floating_types[i] = type{tk_real_floating};
+            real_floating_types[i].float_kind = static_cast<floating_kind>(i);
+            complex_floating_types[i] = type{tk_complex_floating};
+            complex_floating_types[i].float_kind =
+                static_cast<floating_kind>(i);
+        }
+    }
 
-        register_floating_type(fk_float, false);
-        register_floating_type(fk_double, false);
-        register_floating_type(fk_long_double, false);
+    const type* tm::build_pointer_to(qual_type ty) {
+        return intern({ tk_pointer, ty.opaque(), 0, {} }, [&](type& result) {
+            result.pointee_type = ty;
+            return std::span<const type* const>{};
+        });
     }
 
-    void tm::register_integer_type(integer_kind kind,
-                                   bool is_signed) {
-        auto& map = is_signed ? signed_integer_types : unsigned_integer_types;
-        map[kind] = std::make_unique<type>(kind, is_signed);
+    const type* tm::build_array_of(qual_type element,
+                                   std::optional<std::uint64_t> size) {
+        // no array has as many elements as the largest size
+        const auto extent = size.value_or(~std::uint64_t(0));
+        type_key key{ tk_array, element.opaque(), extent, {} };
+        return intern(key, [&](type& result) {
+            result.array = { element, size.value_or(0), size.has_value() };
+            return std::span<const type* const>{};
+        });
     }
 
-    void tm::register_floating_type(floating_kind kind,
-                                    bool is_real) {
-        auto& map = is_real ? real_floating_types : complex_floating_types;
-        auto type_kind = is_real ? tk_real_floating : tk_complex_floating;
-        auto ty = std::make_unique<type>(type_kind);
-        ty->float_kind = kind;
-        map[kind] = std::move(ty);
+    const type* tm::build_function(const type* result,
+                                   std::span<const qual_type> params,
+                                   bool is_variadic, bool has_prototype) {
+        /* [6.7.6.3]/15
+         ... (In the determination of type compatibility and of a composite
+         type, each parameter declared with function or array type is taken
+         as having the adjusted type and each parameter declared with
+         qualified type is taken as having the unqualified version of its
+         declared type.)
+        */
+        std::vector<const type*> unqualified;
+        unqualified.reserve(params.size());
+        for (auto param : params) {
+            /* [6.7.6.3]/7
+             A declaration of a parameter as "array of type" shall be
+             adjusted to "qualified pointer to type", ...
+            */
+            /* [6.7.6.3]/8
+             A declaration of a parameter as "function returning type"
+             shall be adjusted to "pointer to function returning type", ...
+            */
+            const type* adjusted = param.get();
+            if (adjusted->type_kind() == tk_array) {
+                adjusted = build_pointer_to(adjusted->element());
+            } else if (adjusted->type_kind() == tk_function) {
+                adjusted = build_pointer_to(adjusted);
+            }
+            unqualified.push_back(adjusted);
+        }
+        const std::uint64_t flags = is_variadic | (has_prototype << 1);
+        type_key key{
+            tk_function, reinterpret_cast<std::uintptr_t>(result), flags,
+            unqualified
+        };
+        return intern(key, [&](type& ty) {
+            auto list = std::make_unique<const type*[]>(unqualified.size());
+            std::copy(unqualified.begin(), unqualified.end(), list.get());
+            ty.result_type = result;
+            ty.param_types = list.get();
+            ty.param_count = static_cast<std::uint32_t>(unqualified.size());
+            ty.variadic = is_variadic;
+            ty.prototype = has_prototype;
+            parameter_lists.push_back(std::move(list));
+            return std::span<const type* const>{ ty.param_types,
+                                                 ty.param_count };
+        });
     }
 
-    const type* tm::get_integer_type(integer_kind kind,
-                                     bool is_signed) const {
-        assert(!(kind == ik_bool && is_signed));
-        auto& map = is_signed ? signed_integer_types : unsigned_integer_types;
-        return map.find(kind)->second.get();
+    qual_type tm::qualify(qual_type ty, unsigned quals) {
+        /* [6.7.3]/9
+         If the specification of an array type includes any type
+         qualifiers, the element type is so-qualified, not the array type.
+        */
+        if (ty->type_kind() == tk_array && quals) {
+            return build_array_of(qualify(ty->element(), quals),
+                                  ty->array_size());
+        }
+        return ty.with_qualifiers(quals);
     }
 
-    const type* tm::get_real_floating_type(floating_kind kind) const {
-        return real_floating_types.find(kind)->second.get();
+    type* tm::create_tagged(enum type_kind kind, std::string_view tag) {
+        assert(kind == tk_structure || kind == tk_union || kind == tk_enum);
+        std::lock_guard lock{mutex};
+        auto& ty = tagged.emplace_back(kind);
+        ty.tag_chars = tag.data();
+        ty.tag_length = static_cast<std::uint32_t>(tag.size());
+        ty.member_list = nullptr;
+        ty.member_count = 0;
+        ty.complete = false;
+        return &ty;
     }
 
-    const type* tm::get_complex_floating_type(floating_kind kind) const {
-        return complex_floating_types.find(kind)->second.get();
+    void tm::complete_record(type* record, std::span<const member> members) {
+        assert(record->type_kind() == tk_structure ||
+               record->type_kind() == tk_union);
+        assert(!record->complete);
+        auto list = std::make_unique<member[]>(members.size());
+        std::copy(members.begin(), members.end(), list.get());
+        record->member_list = list.get();
+        record->member_count = static_cast<std::uint32_t>(members.size());
+        record->complete = true;
+        std::lock_guard lock{mutex};
+        member_lists.push_back(std::move(list));
     }
 
-    const type* tm::get_void_type() const {
-        return void_type.get();
+    void tm::complete_enum(type* enumeration) {
+        assert(enumeration->type_kind() == tk_enum);
+        enumeration->complete = true;
     }
 }
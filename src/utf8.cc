@@ -7,7 +7,7 @@
 
 static_assert(CHAR_BIT == 8, "UTF-8 encoding expects 8-bit chars");
 
-static std::size_t active_high_bits[256] = {
+constexpr std::size_t active_high_bits[256] = {
     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,